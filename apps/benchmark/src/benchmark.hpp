@@ -0,0 +1,32 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#pragma once
+
+#include "cs/cs.hpp"
+
+#include <chrono>
+
+// Each benchmark prints its own table, main only picks which ones run
+void run_queue_benchmark();
+void run_shared_ptr_benchmark();
+void run_broadphase_benchmark();
+void run_support_benchmark();
+
+class Benchmark_Timer
+{
+public:
+    Benchmark_Timer()
+        : _start(std::chrono::high_resolution_clock::now())
+    {
+    }
+
+    double get_elapsed_ms() const
+    {
+        const auto now = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double, std::milli>(now - _start).count();
+    }
+
+private:
+    std::chrono::high_resolution_clock::time_point _start;
+};
@@ -0,0 +1,336 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Spatial_Hash_Grid pair generation against body density.
+// The same body count is packed into smaller and smaller worlds, so bodies per cell
+// and overlapping pairs go up while the grid stays the same. "build" inserts everything
+// into an empty grid, "step" moves a tenth of the bodies like a physics step would.
+// "linear dedup" is the old find_first deduplication run over the final pairs only,
+// a lower bound for what it used to cost, skipped once it gets too slow to wait for.
+// The mixed scene puts debris on a large floor between a few buildings, and runs it
+// through every broadphase.
+// The threaded run steps a large uniform grid through update_all and find_pairs with
+// a Thread_Pool of growing size, the pairs have to come out the same every time.
+// Before the tables the sweep and prune pair events are checked on a small scripted scene.
+//
+
+#include "benchmark.hpp"
+
+#include "cs/containers/spatial_hash_grid.hpp"
+#include "cs/containers/hierarchical_hash_grid.hpp"
+#include "cs/containers/dynamic_aabb_tree.hpp"
+#include "cs/containers/sweep_and_prune.hpp"
+#include "cs/engine/thread_pool.hpp"
+#include "cs/engine/profiling/profiler.hpp"
+
+#include <random>
+#include <initializer_list>
+
+namespace
+{
+    constexpr float cell_size = 1.5f;
+    constexpr int32 step_count = 20;
+    constexpr int64 max_linear_dedup_pairs = 20000;
+
+    double linear_dedup(const Dynamic_Array<Pair<uint32, uint32>>& pairs)
+    {
+        Dynamic_Array<Pair<uint32, uint32>> unique_pairs;
+
+        Benchmark_Timer timer;
+        for (const Pair<uint32, uint32>& pair : pairs)
+        {
+            Pair<uint32, uint32> inverse_pair { pair.b, pair.a };
+            if (unique_pairs.find_first(pair) == -1 && unique_pairs.find_first(inverse_pair) == -1)
+            {
+                unique_pairs.push_back(pair);
+            }
+        }
+        return timer.get_elapsed_ms();
+    }
+
+    void report(int32 body_count, float world_size)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-world_size * 0.5f, world_size * 0.5f);
+        std::uniform_real_distribution<float> extent(0.25f, 0.75f);
+        std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+
+        Dynamic_Array<AABB> bounds;
+        bounds.reserve(body_count);
+        for (int32 i = 0; i < body_count; ++i)
+        {
+            const vec3 center(position(random), position(random), position(random));
+            const vec3 half_extents(extent(random), extent(random), extent(random));
+            bounds.push_back(AABB(center - half_extents, center + half_extents));
+        }
+
+        Spatial_Hash_Grid grid(cell_size);
+        Dynamic_Array<Pair<uint32, uint32>> pairs;
+
+        Benchmark_Timer build_timer;
+        for (int32 i = 0; i < body_count; ++i)
+        {
+            grid.update(static_cast<uint32>(i), bounds[i]);
+        }
+        grid.sweep_and_prune_cells(pairs);
+        const double build_ms = build_timer.get_elapsed_ms();
+
+        double step_ms = 0.0;
+        for (int32 step = 0; step < step_count; ++step)
+        {
+            for (int32 i = step % 10; i < body_count; i += 10)
+            {
+                const vec3 delta(offset(random), offset(random), offset(random));
+                bounds[i] = AABB(bounds[i].min + delta, bounds[i].max + delta);
+            }
+
+            Benchmark_Timer step_timer;
+            for (int32 i = 0; i < body_count; ++i)
+            {
+                grid.update(static_cast<uint32>(i), bounds[i]);
+            }
+            grid.sweep_and_prune_cells(pairs);
+            step_ms += step_timer.get_elapsed_ms();
+        }
+        step_ms /= step_count;
+
+        const double bodies_per_unit = body_count / (world_size * world_size * world_size);
+        printf("%7d %10.4f %9lld %12.2f ms %10.3f ms", body_count, bodies_per_unit,
+            static_cast<long long>(pairs.size()), build_ms, step_ms);
+
+        if (pairs.size() <= max_linear_dedup_pairs)
+        {
+            printf(" %12.2f ms\n", linear_dedup(pairs));
+        }
+        else
+        {
+            printf(" %15s\n", "-");
+        }
+    }
+
+    void report_mixed(Broadphase& broadphase, const char* name, int32 debris_count)
+    {
+        constexpr float floor_size = 400.0f;
+        constexpr int32 building_count = 16;
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-floor_size * 0.5f, floor_size * 0.5f);
+        std::uniform_real_distribution<float> extent(0.1f, 0.5f);
+        std::uniform_real_distribution<float> height(0.0f, 10.0f);
+        std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+
+        Dynamic_Array<AABB> bounds;
+        bounds.reserve(debris_count + building_count + 1);
+        bounds.push_back(AABB(vec3(-floor_size * 0.5f, -1.0f, -floor_size * 0.5f), vec3(floor_size * 0.5f, 0.0f, floor_size * 0.5f)));
+        for (int32 i = 0; i < building_count; ++i)
+        {
+            const vec3 corner(position(random), 0.0f, position(random));
+            bounds.push_back(AABB(corner, corner + vec3(20.0f, 40.0f, 20.0f)));
+        }
+        for (int32 i = 0; i < debris_count; ++i)
+        {
+            const vec3 center(position(random), height(random), position(random));
+            const vec3 half_extents(extent(random), extent(random), extent(random));
+            bounds.push_back(AABB(center - half_extents, center + half_extents));
+        }
+
+        Dynamic_Array<Pair<uint32, uint32>> pairs;
+
+        Benchmark_Timer build_timer;
+        for (int64 i = 0; i < bounds.size(); ++i)
+        {
+            broadphase.update(static_cast<uint32>(i), bounds[i]);
+        }
+        broadphase.find_pairs(pairs);
+        const double build_ms = build_timer.get_elapsed_ms();
+
+        // Only the debris moves, the floor and buildings are static
+        double step_ms = 0.0;
+        for (int32 step = 0; step < step_count; ++step)
+        {
+            for (int64 i = building_count + 1 + step % 10; i < bounds.size(); i += 10)
+            {
+                const vec3 delta(offset(random), offset(random), offset(random));
+                bounds[i] = AABB(bounds[i].min + delta, bounds[i].max + delta);
+            }
+
+            Benchmark_Timer step_timer;
+            for (int64 i = 0; i < bounds.size(); ++i)
+            {
+                broadphase.update(static_cast<uint32>(i), bounds[i]);
+            }
+            broadphase.find_pairs(pairs);
+            step_ms += step_timer.get_elapsed_ms();
+        }
+        step_ms /= step_count;
+
+        printf("%-13s %7d %9lld %12.2f ms %10.3f ms\n", name, debris_count,
+            static_cast<long long>(pairs.size()), build_ms, step_ms);
+    }
+
+    bool same_events(const Sweep_And_Prune& sweep_and_prune, std::initializer_list<Sweep_And_Prune::Pair_Event> expected)
+    {
+        const Dynamic_Array<Sweep_And_Prune::Pair_Event>& events = sweep_and_prune.get_pair_events();
+        if (events.size() != static_cast<int64>(expected.size()))
+        {
+            return false;
+        }
+
+        int64 index = 0;
+        for (const Sweep_And_Prune::Pair_Event& event : expected)
+        {
+            const Sweep_And_Prune::Pair_Event& actual = events[index++];
+            if (actual.pair.a != event.pair.a || actual.pair.b != event.pair.b || actual.added != event.added)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Add, move apart and back, then remove and re-add under the same id in one step
+    bool check_pair_events()
+    {
+        const AABB box(vec3(0.0f), vec3(1.0f));
+        const AABB overlapping_box(vec3(0.5f), vec3(1.5f));
+        const AABB far_box(vec3(10.0f), vec3(11.0f));
+
+        Sweep_And_Prune sweep_and_prune;
+        Dynamic_Array<Pair<uint32, uint32>> pairs;
+        bool ok = true;
+
+        sweep_and_prune.update(0, box);
+        sweep_and_prune.update(1, overlapping_box);
+        sweep_and_prune.find_pairs(pairs);
+        ok &= same_events(sweep_and_prune, { { { 0, 1 }, true } });
+
+        sweep_and_prune.update(1, far_box);
+        sweep_and_prune.find_pairs(pairs);
+        ok &= same_events(sweep_and_prune, { { { 0, 1 }, false } });
+
+        sweep_and_prune.update(1, overlapping_box);
+        sweep_and_prune.find_pairs(pairs);
+        ok &= same_events(sweep_and_prune, { { { 0, 1 }, true } });
+
+        // The last find_pairs' events stay readable until the next one
+        sweep_and_prune.remove(1);
+        ok &= same_events(sweep_and_prune, { { { 0, 1 }, true } });
+
+        sweep_and_prune.update(1, overlapping_box);
+        sweep_and_prune.find_pairs(pairs);
+        ok &= same_events(sweep_and_prune, { { { 0, 1 }, false }, { { 0, 1 }, true } });
+        ok &= pairs.size() == 1;
+
+        sweep_and_prune.find_pairs(pairs);
+        ok &= same_events(sweep_and_prune, {});
+
+        return ok;
+    }
+
+    void report_threaded(uint32 thread_count, int32 body_count, float world_size, Dynamic_Array<Pair<uint32, uint32>>& out_pairs)
+    {
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-world_size * 0.5f, world_size * 0.5f);
+        std::uniform_real_distribution<float> extent(0.25f, 0.75f);
+        std::uniform_real_distribution<float> offset(-0.1f, 0.1f);
+
+        Dynamic_Array<AABB> bounds;
+        bounds.reserve(body_count);
+        for (int32 i = 0; i < body_count; ++i)
+        {
+            const vec3 center(position(random), position(random), position(random));
+            const vec3 half_extents(extent(random), extent(random), extent(random));
+            bounds.push_back(AABB(center - half_extents, center + half_extents));
+        }
+
+        Thread_Pool thread_pool(thread_count);
+        Spatial_Hash_Grid grid(cell_size);
+        grid.set_thread_pool(&thread_pool);
+
+        Benchmark_Timer build_timer;
+        grid.update_all(bounds.begin(), bounds.size());
+        grid.find_pairs(out_pairs);
+        const double build_ms = build_timer.get_elapsed_ms();
+
+        double step_ms = 0.0;
+        for (int32 step = 0; step < step_count; ++step)
+        {
+            for (int32 i = step % 10; i < body_count; i += 10)
+            {
+                const vec3 delta(offset(random), offset(random), offset(random));
+                bounds[i] = AABB(bounds[i].min + delta, bounds[i].max + delta);
+            }
+
+            Benchmark_Timer step_timer;
+            grid.update_all(bounds.begin(), bounds.size());
+            grid.find_pairs(out_pairs);
+            step_ms += step_timer.get_elapsed_ms();
+        }
+        step_ms /= step_count;
+
+        printf("%7u %9lld %12.2f ms %10.3f ms", thread_pool.get_num_threads(),
+            static_cast<long long>(out_pairs.size()), build_ms, step_ms);
+    }
+}
+
+void run_broadphase_benchmark()
+{
+    printf("sap pair events %s\n\n", check_pair_events() ? "ok" : "wrong");
+
+    printf("%7s %10s %9s %15s %13s %15s\n", "bodies", "density", "pairs", "build", "step", "linear dedup");
+
+    for (int32 body_count : { 1000, 10000 })
+    {
+        for (float bodies_per_unit : { 0.01f, 0.05f, 0.2f, 0.5f, 1.0f })
+        {
+            report(body_count, std::cbrt(body_count / bodies_per_unit));
+        }
+    }
+
+    printf("\n%-13s %7s %9s %15s %13s\n", "mixed", "debris", "pairs", "build", "step");
+    for (int32 debris_count : { 1000, 10000 })
+    {
+        Spatial_Hash_Grid uniform_grid(cell_size);
+        report_mixed(uniform_grid, "uniform", debris_count);
+
+        Hierarchical_Hash_Grid hierarchical_grid(cell_size);
+        report_mixed(hierarchical_grid, "hierarchical", debris_count);
+
+        Dynamic_AABB_Tree tree;
+        report_mixed(tree, "aabb tree", debris_count);
+
+        Sweep_And_Prune sweep_and_prune;
+        report_mixed(sweep_and_prune, "sap", debris_count);
+    }
+
+    // The pool's workers report to the profiler
+    Profiler profiler;
+
+    constexpr int32 threaded_body_count = 100000;
+    const float threaded_world_size = std::cbrt(threaded_body_count / 0.2f);
+
+    printf("\n%7s %9s %15s %13s\n", "threads", "pairs", "build", "step");
+    Dynamic_Array<Pair<uint32, uint32>> single_thread_pairs;
+    Dynamic_Array<Pair<uint32, uint32>> pairs;
+    for (uint32 thread_count : { 0u, 1u, 2u, 4u, 8u, 16u })
+    {
+        if (thread_count > std::thread::hardware_concurrency())
+        {
+            break;
+        }
+
+        report_threaded(thread_count, threaded_body_count, threaded_world_size, thread_count == 0 ? single_thread_pairs : pairs);
+        if (thread_count == 0)
+        {
+            printf("\n");
+            continue;
+        }
+
+        bool same_pairs = pairs.size() == single_thread_pairs.size();
+        for (int64 i = 0; same_pairs && i < pairs.size(); ++i)
+        {
+            same_pairs = pairs[i].a == single_thread_pairs[i].a && pairs[i].b == single_thread_pairs[i].b;
+        }
+        printf(same_pairs ? "\n" : " pairs differ\n");
+    }
+}
@@ -0,0 +1,51 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Usage: cs_benchmark [name]
+// Without a name every benchmark runs.
+//
+
+#include "benchmark.hpp"
+
+#include <cstring>
+
+struct Benchmark_Entry
+{
+    const char* name;
+    void (*function)();
+};
+
+static const Benchmark_Entry benchmarks[] =
+{
+    { "queue", run_queue_benchmark },
+    { "shared_ptr", run_shared_ptr_benchmark },
+    { "broadphase", run_broadphase_benchmark },
+    { "support", run_support_benchmark },
+};
+
+int main(int argc, char** argv)
+{
+    const char* filter = argc > 1 ? argv[1] : nullptr;
+
+    bool found = false;
+    for (const Benchmark_Entry& benchmark : benchmarks)
+    {
+        if (filter && strcmp(filter, benchmark.name) != 0)
+        {
+            continue;
+        }
+
+        printf("== %s\n", benchmark.name);
+        benchmark.function();
+        printf("\n");
+        found = true;
+    }
+
+    if (!found)
+    {
+        printf("Unknown benchmark '%s'\n", filter);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Producer/consumer throughput of the task queues under contention.
+// Mutex + std::deque is what Thread_Pool used before, mutex + Ring_Buffer is
+// what it uses now, the lock free queues are the candidates to replace it.
+//
+
+#include "benchmark.hpp"
+
+#include "cs/containers/ring_buffer.hpp"
+#include "cs/containers/spsc_queue.hpp"
+#include "cs/containers/mpmc_queue.hpp"
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+
+namespace
+{
+    constexpr int64 item_count = 1 << 21;
+    constexpr int64 queue_size = 1 << 12;
+
+    class Mutex_Deque_Queue
+    {
+    public:
+        bool try_push(int64 value)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queue.push_back(value);
+            return true;
+        }
+
+        bool try_pop(int64& out_value)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_queue.empty())
+            {
+                return false;
+            }
+
+            out_value = _queue.front();
+            _queue.pop_front();
+            return true;
+        }
+
+    private:
+        std::mutex _mutex;
+        std::deque<int64> _queue;
+    };
+
+    class Mutex_Ring_Buffer_Queue
+    {
+    public:
+        bool try_push(int64 value)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _queue.push_back(value);
+            return true;
+        }
+
+        bool try_pop(int64& out_value)
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (_queue.empty())
+            {
+                return false;
+            }
+
+            out_value = _queue.pop_front();
+            return true;
+        }
+
+    private:
+        std::mutex _mutex;
+        Ring_Buffer<int64> _queue { queue_size };
+    };
+
+    // Returns milliseconds, asserts every pushed value was popped exactly once (by sum)
+    template<typename Queue>
+    double run(Queue& queue, int32 producer_count, int32 consumer_count)
+    {
+        const int64 items_per_producer = item_count / producer_count;
+        const int64 total_items = items_per_producer * producer_count;
+
+        std::atomic<int64> popped { 0 };
+        std::atomic<int64> sum { 0 };
+        std::atomic<bool> start { false };
+
+        std::vector<std::thread> threads;
+        for (int32 p = 0; p < producer_count; ++p)
+        {
+            threads.emplace_back([&, p]
+            {
+                while (!start.load(std::memory_order_acquire)) {}
+
+                for (int64 i = 0; i < items_per_producer; ++i)
+                {
+                    const int64 value = p * items_per_producer + i;
+                    while (!queue.try_push(value))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        for (int32 c = 0; c < consumer_count; ++c)
+        {
+            threads.emplace_back([&]
+            {
+                while (!start.load(std::memory_order_acquire)) {}
+
+                int64 local_sum = 0;
+                int64 value;
+                while (popped.load(std::memory_order_relaxed) < total_items)
+                {
+                    if (queue.try_pop(value))
+                    {
+                        local_sum += value;
+                        popped.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    else
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+                sum.fetch_add(local_sum);
+            });
+        }
+
+        Benchmark_Timer timer;
+        start.store(true, std::memory_order_release);
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        const double elapsed = timer.get_elapsed_ms();
+
+        assert(sum.load() == total_items * (total_items - 1) / 2);
+        return elapsed;
+    }
+
+    template<typename Queue>
+    void report(const char* name, int32 producer_count, int32 consumer_count)
+    {
+        // The lock free queues have large inline buffers
+        std::unique_ptr<Queue> queue = std::make_unique<Queue>();
+        const double elapsed = run(*queue, producer_count, consumer_count);
+        printf("%-20s %3d/%-3d %10.2f ms %10.2f Mops/s\n", name, producer_count, consumer_count,
+            elapsed, static_cast<double>(item_count) / elapsed / 1000.0);
+    }
+}
+
+void run_queue_benchmark()
+{
+    const int32 max_threads = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() : 2;
+
+    printf("%-20s %7s %13s %17s\n", "queue", "P/C", "time", "throughput");
+
+    report<SPSC_Queue<int64, queue_size>>("spsc", 1, 1);
+    for (int32 producers = 1; producers * 2 <= max_threads; producers *= 2)
+    {
+        report<Mutex_Deque_Queue>("mutex + std::deque", producers, producers);
+        report<Mutex_Ring_Buffer_Queue>("mutex + ring buffer", producers, producers);
+        report<MPMC_Queue<int64, queue_size>>("mpmc", producers, producers);
+    }
+}
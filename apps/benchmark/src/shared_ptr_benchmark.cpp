@@ -0,0 +1,108 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Copy and Weak_Ptr::lock throughput of the two ref count policies.
+// Single threaded numbers are the raw cost of the atomics, the contended ones
+// are every thread hammering the same control block, the worst case for Shared_Ptr.
+// Local_Shared_Ptr only shows up single threaded, it can't be shared.
+//
+
+#include "benchmark.hpp"
+
+#include "cs/memory/shared_ptr.hpp"
+#include "cs/memory/weak_ptr.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr int64 iteration_count = 1 << 22;
+
+    struct Payload
+    {
+        int64 value { 1 };
+    };
+
+    // Copies and drops, sums through the copy so the loop can't be thrown away
+    template<typename Pointer>
+    int64 copy_loop(const Pointer& source)
+    {
+        int64 sum = 0;
+        for (int64 i = 0; i < iteration_count; ++i)
+        {
+            Pointer copy = source;
+            sum += copy->value;
+        }
+        return sum;
+    }
+
+    template<typename Weak_Pointer>
+    int64 lock_loop(const Weak_Pointer& source)
+    {
+        int64 sum = 0;
+        for (int64 i = 0; i < iteration_count; ++i)
+        {
+            auto locked = source.lock();
+            sum += locked->value;
+        }
+        return sum;
+    }
+
+    template<typename Function>
+    double run(int32 thread_count, const Function& function)
+    {
+        std::atomic<bool> start { false };
+        std::atomic<int64> sum { 0 };
+
+        std::vector<std::thread> threads;
+        for (int32 t = 0; t < thread_count; ++t)
+        {
+            threads.emplace_back([&]
+            {
+                while (!start.load(std::memory_order_acquire)) {}
+                sum.fetch_add(function());
+            });
+        }
+
+        Benchmark_Timer timer;
+        start.store(true, std::memory_order_release);
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+        const double elapsed = timer.get_elapsed_ms();
+
+        assert(sum.load() == iteration_count * thread_count);
+        return elapsed;
+    }
+
+    template<typename Function>
+    void report(const char* name, int32 thread_count, const Function& function)
+    {
+        const double elapsed = run(thread_count, function);
+        printf("%-24s %7d %10.2f ms %10.2f Mops/s\n", name, thread_count,
+            elapsed, static_cast<double>(iteration_count * thread_count) / elapsed / 1000.0);
+    }
+}
+
+void run_shared_ptr_benchmark()
+{
+    const int32 max_threads = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() : 2;
+
+    printf("%-24s %7s %13s %17s\n", "operation", "threads", "time", "throughput");
+
+    Local_Shared_Ptr<Payload> local = Local_Shared_Ptr<Payload>::create();
+    Local_Weak_Ptr<Payload> local_weak = local;
+    report("local copy", 1, [&] { return copy_loop(local); });
+    report("local lock", 1, [&] { return lock_loop(local_weak); });
+
+    Shared_Ptr<Payload> shared = Shared_Ptr<Payload>::create();
+    Weak_Ptr<Payload> shared_weak = shared;
+    for (int32 thread_count = 1; thread_count <= max_threads; thread_count *= 2)
+    {
+        report("atomic copy", thread_count, [&] { return copy_loop(shared); });
+        report("atomic lock", thread_count, [&] { return lock_loop(shared_weak); });
+    }
+}
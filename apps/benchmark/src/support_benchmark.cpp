@@ -0,0 +1,148 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Convex hull support queries against hull size.
+// "linear" is the old per vertex scan with the direction rotated by a quaternion every query,
+// "sse2" is the same scan four vertices at a time. "climb" walks the vertex adjacency from
+// vertex 0 every time, "seeded" starts from the previous answer like GJK does between
+// iterations. Random directions jump all over the hull, coherent ones turn a little per query.
+// Every method has to find the same distance, otherwise the row says so.
+//
+
+#include "benchmark.hpp"
+
+#include "cs/engine/resource/physics_resources.hpp"
+
+#include <random>
+
+namespace
+{
+    constexpr int32 query_count = 200000;
+
+    int32 linear_support(const Convex_Hull_Resource& hull, const quat& orientation, const vec3& direction)
+    {
+        const vec3 transformed_direction = orientation.mul(direction);
+
+        int32 best_index = 0;
+        float best_distance = -FLT_MAX;
+        for (int32 v = 0; v < hull.vertices.size(); ++v)
+        {
+            const float distance = hull.vertices[v].dot(transformed_direction);
+            if (distance > best_distance)
+            {
+                best_distance = distance;
+                best_index = v;
+            }
+        }
+        return best_index;
+    }
+
+    // Evenly spread over a sphere, every point ends up on the hull
+    void make_sphere_points(int32 count, Dynamic_Array<vec3>& out_points)
+    {
+        const float golden_angle = 3.14159265f * (3.0f - sqrtf(5.0f));
+        out_points.clear();
+        for (int32 i = 0; i < count; ++i)
+        {
+            const float y = 1.0f - 2.0f * (i + 0.5f) / count;
+            const float radius = sqrtf(1.0f - y * y);
+            const float angle = golden_angle * i;
+            out_points.push_back(vec3(cosf(angle) * radius, y, sinf(angle) * radius));
+        }
+    }
+
+    template<typename Query>
+    double time_queries(const Dynamic_Array<vec3>& directions, Dynamic_Array<int32>& out_vertices, Query query)
+    {
+        Benchmark_Timer timer;
+        for (int64 i = 0; i < directions.size(); ++i)
+        {
+            out_vertices[i] = query(directions[i], i > 0 ? out_vertices[i - 1] : 0);
+        }
+        return timer.get_elapsed_ms() * 1e6 / directions.size();
+    }
+
+    bool same_distances(const Convex_Hull_Resource& hull, const Dynamic_Array<vec3>& directions,
+        const Dynamic_Array<int32>& expected, const Dynamic_Array<int32>& found)
+    {
+        for (int64 i = 0; i < directions.size(); ++i)
+        {
+            const float expected_distance = hull.vertices[expected[i]].dot(directions[i]);
+            const float found_distance = hull.vertices[found[i]].dot(directions[i]);
+            if (fabs(expected_distance - found_distance) > 1e-5f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void report(const Convex_Hull_Resource& hull, const char* name, const Dynamic_Array<vec3>& directions)
+    {
+        Dynamic_Array<int32> linear_vertices, sse2_vertices, climb_vertices, seeded_vertices;
+        linear_vertices.resize(directions.size(), 0);
+        sse2_vertices.resize(directions.size(), 0);
+        climb_vertices.resize(directions.size(), 0);
+        seeded_vertices.resize(directions.size(), 0);
+
+        // Identity, so the answers stay comparable, the rotation still costs what it did
+        const quat orientation = quat::zero_quat;
+
+        const double linear_ns = time_queries(directions, linear_vertices, [&](const vec3& direction, int32) {
+            return linear_support(hull, orientation, direction);
+        });
+        const double sse2_ns = time_queries(directions, sse2_vertices, [&](const vec3& direction, int32) {
+            return hull.find_support_vertex_linear(direction);
+        });
+        const double climb_ns = time_queries(directions, climb_vertices, [&](const vec3& direction, int32) {
+            return hull.find_support_vertex_climbing(direction, 0);
+        });
+        const double seeded_ns = time_queries(directions, seeded_vertices, [&](const vec3& direction, int32 previous) {
+            return hull.find_support_vertex_climbing(direction, previous);
+        });
+
+        const bool same = same_distances(hull, directions, linear_vertices, sse2_vertices)
+            && same_distances(hull, directions, linear_vertices, climb_vertices)
+            && same_distances(hull, directions, linear_vertices, seeded_vertices);
+
+        printf("%8lld %-9s %9.1f ns %9.1f ns %9.1f ns %9.1f ns%s\n", static_cast<long long>(hull.vertices.size()), name,
+            linear_ns, sse2_ns, climb_ns, seeded_ns, same ? "" : "  results differ");
+    }
+}
+
+void run_support_benchmark()
+{
+    std::mt19937 random(1234);
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+
+    Dynamic_Array<vec3> random_directions;
+    Dynamic_Array<vec3> coherent_directions;
+    random_directions.reserve(query_count);
+    coherent_directions.reserve(query_count);
+
+    vec3 direction(1.0f, 0.0f, 0.0f);
+    for (int32 i = 0; i < query_count; ++i)
+    {
+        random_directions.push_back(vec3(normal(random), normal(random), normal(random)).normalized());
+
+        direction = (direction + vec3(normal(random), normal(random), normal(random)) * 0.05f).normalized();
+        coherent_directions.push_back(direction);
+    }
+
+    printf("%8s %-9s %12s %12s %12s %12s\n", "vertices", "direction", "linear", "sse2", "climb", "seeded");
+
+    Dynamic_Array<vec3> points;
+    for (int32 vertex_count : { 8, 16, 32, 64, 128, 512, 2048 })
+    {
+        make_sphere_points(vertex_count, points);
+
+        Convex_Hull_Resource hull;
+        if (!hull.initialize_from_points(points.begin(), vertex_count))
+        {
+            continue;
+        }
+
+        report(hull, "random", random_directions);
+        report(hull, "coherent", coherent_directions);
+    }
+}
@@ -4,7 +4,7 @@
 
 struct Transform_Component : Component
 {
-	static constexpr Name_Id id = Name_Id("Transform_Component");
+	CS_NAME_ID(id, "Transform_Component")
 	virtual constexpr Name_Id get_id() const { return id; }
 
 	vec3 local_position { vec3::zero_vector };
@@ -20,7 +20,7 @@ struct Transform_Component : Component
 
 struct Render_Component : Component
 {
-	static constexpr Name_Id id = Name_Id("Render_Component");
+	CS_NAME_ID(id, "Render_Component")
 	virtual constexpr Name_Id get_id() const { return id; }
 
 	Shared_Ptr<Mesh> mesh;
@@ -144,8 +144,8 @@ struct My_Game
 	}
 
 	Dynamic_Array<Name_Id> renderer_meshes_used;
-	Hash_Map<Name_Id, Shared_Ptr<Mesh>> renderer_mesh_map;
-	Hash_Map<Name_Id, Dynamic_Array<Instance_Data>> renderer_instance_map;
+	Flat_Hash_Map<Name_Id, Shared_Ptr<Mesh>> renderer_mesh_map;
+	Flat_Hash_Map<Name_Id, Dynamic_Array<Instance_Data>> renderer_instance_map;
 
 	void render()
 	{
@@ -8,7 +8,7 @@
 
 struct Base_Class
 {
-    static constexpr Name_Id static_class_name = Name_Id("Base_Class");
+    CS_NAME_ID(static_class_name, "Base_Class")
     virtual constexpr Name_Id class_name() const { return static_class_name; }
     template<Derived<Base_Class> A>
     static constexpr bool is_a()
@@ -31,7 +31,7 @@ Class_Registry& get_class_registry();
 #define DERIVED_CLASS_BODY(Derived_Type, Base_Type) \
 public: \
     using Base = Base_Type; \
-    static constexpr Name_Id static_class_name = Name_Id(#Derived_Type); \
+    CS_NAME_ID(static_class_name, #Derived_Type) \
     virtual constexpr Name_Id class_name() const override { return static_class_name; } \
     template<Derived<Base_Class> A> \
     static constexpr bool is_a() \
@@ -0,0 +1,163 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Lock striped hash map, safe to use from Thread_Pool workers.
+// Keys are spread over Shard_Count independent Flat_Hash_Maps, each guarded by
+// its own reader/writer lock, so readers never block each other and writers only
+// block the shard they touch. Values are returned by copy or visited under the
+// shard lock, as a pointer into a shard would outlive the lock.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/containers/flat_hash_map.hpp"
+
+#include <bit>
+#include <mutex>
+#include <shared_mutex>
+#include <functional>
+
+template<typename Key, typename Value, typename Hash_Function = std::hash<Key>, int64 Shard_Count = 16>
+class Concurrent_Hash_Map
+{
+    static_assert(Shard_Count > 0 && (Shard_Count & (Shard_Count - 1)) == 0, "Shard count has to be a power of two");
+
+public:
+    Concurrent_Hash_Map(int64 initial_capacity = 32)
+    {
+        reserve(initial_capacity);
+    }
+
+    void reserve(int64 capacity)
+    {
+        for (Shard& shard : _shards)
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.map.reserve(capacity / Shard_Count + 1);
+        }
+    }
+
+    void clear()
+    {
+        for (Shard& shard : _shards)
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.map.clear();
+        }
+    }
+
+    // Returns true if the key was newly added, false if an existing value was replaced
+    bool insert(const Key& key, const Value& value)
+    {
+        Shard& shard = _get_shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.insert(key, value) != nullptr;
+    }
+
+    bool find(const Key& key, Value& out_value) const
+    {
+        const Shard& shard = _get_shard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        if (const Value* value = shard.map.find(key))
+        {
+            out_value = *value;
+            return true;
+        }
+
+        return false;
+    }
+
+    bool contains(const Key& key) const
+    {
+        const Shard& shard = _get_shard(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.find(key) != nullptr;
+    }
+
+    // Calls function(Value&) under the shard's write lock, adding a default value if missing
+    template<typename Function>
+    void find_or_add(const Key& key, Function&& function)
+    {
+        Shard& shard = _get_shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        function(shard.map.find_or_add(key));
+    }
+
+    // Calls function(Value&) under the shard's write lock if the key exists
+    template<typename Function>
+    bool visit(const Key& key, Function&& function)
+    {
+        Shard& shard = _get_shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        if (Value* value = shard.map.find(key))
+        {
+            function(*value);
+            return true;
+        }
+
+        return false;
+    }
+
+    bool erase(const Key& key)
+    {
+        Shard& shard = _get_shard(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.erase(key);
+    }
+
+    // Calls function(const Key&, const Value&) for every entry, one shard read lock at a time
+    template<typename Function>
+    void for_each(Function&& function) const
+    {
+        for (const Shard& shard : _shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const Pair<Key, Value>& pair : shard.map)
+            {
+                function(pair.a, pair.b);
+            }
+        }
+    }
+
+    // Only a snapshot, other threads can change it right after
+    int64 get_size() const
+    {
+        int64 size = 0;
+        for (const Shard& shard : _shards)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            size += shard.map.get_size();
+        }
+        return size;
+    }
+
+private:
+    // Each shard on its own cache line so writers on different shards don't false share
+    struct alignas(CS_CACHE_LINE_SIZE) Shard
+    {
+        mutable std::shared_mutex mutex;
+        Flat_Hash_Map<Key, Value, Hash_Function> map { 0 };
+    };
+
+    Shard _shards[Shard_Count];
+    Hash_Function _hash_function;
+
+private:
+    int64 _get_shard_index(const Key& key) const
+    {
+        if constexpr (Shard_Count == 1)
+        {
+            return 0;
+        }
+        else
+        {
+            // Fibonacci hashing, the top bits pick the shard while the shard map uses the rest
+            const uint64 hash = static_cast<uint64>(_hash_function(key)) * 0x9E3779B97F4A7C15ull;
+            return static_cast<int64>(hash >> (64 - std::countr_zero(static_cast<uint64>(Shard_Count))));
+        }
+    }
+
+    Shard& _get_shard(const Key& key) { return _shards[_get_shard_index(key)]; }
+    const Shard& _get_shard(const Key& key) const { return _shards[_get_shard_index(key)]; }
+};
@@ -0,0 +1,557 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/containers/dynamic_aabb_tree.hpp"
+#include "cs/containers/small_array.hpp"
+#include "cs/engine/profiling/profiler.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    AABB union_of(const AABB& a, const AABB& b)
+    {
+        return AABB(
+            vec3(std::min(a.min.x, b.min.x), std::min(a.min.y, b.min.y), std::min(a.min.z, b.min.z)),
+            vec3(std::max(a.max.x, b.max.x), std::max(a.max.y, b.max.y), std::max(a.max.z, b.max.z)));
+    }
+
+    float surface_area(const AABB& bounds)
+    {
+        const vec3 size = bounds.max - bounds.min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    bool encloses(const AABB& outer, const AABB& inner)
+    {
+        return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+            outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+    }
+
+    // Inclusive, same as the grids, so bodies resting on each other still pair up
+    bool overlaps(const AABB& a, const AABB& b)
+    {
+        return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+            a.min.y <= b.max.y && a.max.y >= b.min.y &&
+            a.min.z <= b.max.z && a.max.z >= b.min.z;
+    }
+
+    bool ray_hits(const AABB& bounds, const vec3& origin, const vec3& inverse_direction, float max_distance)
+    {
+        float t_min = 0.0f;
+        float t_max = max_distance;
+        for (int32 axis = 0; axis < 3; ++axis)
+        {
+            float t0 = (bounds.min[axis] - origin[axis]) * inverse_direction[axis];
+            float t1 = (bounds.max[axis] - origin[axis]) * inverse_direction[axis];
+            if (t0 > t1)
+            {
+                std::swap(t0, t1);
+            }
+
+            // Written so a NaN from 0 * inf (ray in the slab plane) keeps the old value
+            t_min = t0 > t_min ? t0 : t_min;
+            t_max = t1 < t_max ? t1 : t_max;
+            if (t_min > t_max)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+Dynamic_AABB_Tree::Dynamic_AABB_Tree(float fat_margin, float displacement_multiplier)
+    :_fat_margin(fat_margin), _displacement_multiplier(displacement_multiplier)
+{
+    assert(_fat_margin >= 0.0f);
+}
+
+void Dynamic_AABB_Tree::update(uint32 in_id, const AABB& in_bounds)
+{
+    PROFILE_FUNCTION()
+
+    _ensure_id(in_id);
+
+    int32 leaf = _id_leaves[in_id];
+    if (leaf == null_node)
+    {
+        leaf = _allocate_node();
+        _nodes[leaf].bounds = _make_fat_bounds(in_bounds, vec3::zero_vector);
+        _nodes[leaf].id = in_id;
+        _nodes[leaf].height = 0;
+        _insert_leaf(leaf);
+
+        _id_leaves[in_id] = leaf;
+        _bounds[in_id] = in_bounds;
+        _leaf_count++;
+        _mark_moved(in_id);
+        return;
+    }
+
+    const vec3 displacement = in_bounds.get_center() - _bounds[in_id].get_center();
+    _bounds[in_id] = in_bounds;
+
+    // Still inside the fat box, the tree and the cached pairs don't change
+    if (encloses(_nodes[leaf].bounds, in_bounds))
+    {
+        return;
+    }
+
+    _remove_leaf(leaf);
+    _nodes[leaf].bounds = _make_fat_bounds(in_bounds, displacement);
+    _insert_leaf(leaf);
+    _mark_moved(in_id);
+}
+
+void Dynamic_AABB_Tree::remove(uint32 in_id)
+{
+    PROFILE_FUNCTION()
+
+    if (!contains(in_id))
+    {
+        return;
+    }
+
+    const int32 leaf = _id_leaves[in_id];
+    _remove_leaf(leaf);
+    _free_node(leaf);
+
+    _id_leaves[in_id] = null_node;
+    _leaf_count--;
+    // Its pairs are dropped on the next find_pairs
+    _mark_moved(in_id);
+}
+
+void Dynamic_AABB_Tree::clear()
+{
+    _nodes.clear();
+    _root = null_node;
+    _free_list = null_node;
+    _leaf_count = 0;
+
+    _id_leaves.clear();
+    _bounds.clear();
+    _is_moved.clear();
+    _moved_ids.clear();
+    _pair_keys.clear();
+}
+
+int32 Dynamic_AABB_Tree::get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const
+{
+    PROFILE_FUNCTION()
+
+    const int64 previous_size = out_potential_colliders.size();
+
+    _query(in_bounds, [&](uint32 id){
+        if (id != in_id && overlaps(_bounds[id], in_bounds))
+        {
+            out_potential_colliders.push_back(id);
+        }
+    });
+
+    std::sort(out_potential_colliders.begin() + previous_size, out_potential_colliders.end());
+    return static_cast<int32>(out_potential_colliders.size() - previous_size);
+}
+
+int32 Dynamic_AABB_Tree::raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_hits) const
+{
+    PROFILE_FUNCTION()
+
+    const int64 previous_size = out_hits.size();
+    if (_root == null_node)
+    {
+        return 0;
+    }
+
+    const vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    Small_Array<int32, 64> stack;
+    stack.push_back(_root);
+    while (stack.size() > 0)
+    {
+        const Node& node = _nodes[stack[stack.size() - 1]];
+        stack.pop_back();
+
+        if (!ray_hits(node.bounds, origin, inverse_direction, max_distance))
+        {
+            continue;
+        }
+
+        if (node.is_leaf())
+        {
+            if (ray_hits(_bounds[node.id], origin, inverse_direction, max_distance))
+            {
+                out_hits.push_back(node.id);
+            }
+        }
+        else
+        {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+
+    return static_cast<int32>(out_hits.size() - previous_size);
+}
+
+void Dynamic_AABB_Tree::find_pairs(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs)
+{
+    PROFILE_FUNCTION()
+
+    if (_moved_ids.size() > 0)
+    {
+        // Drop every cached pair of a moved or removed object, the rest still holds
+        int64 kept_count = 0;
+        for (uint64 pair_key : _pair_keys)
+        {
+            const Pair<uint32, uint32> pair = get_unordered_pair(pair_key);
+            if (!_is_moved[pair.a] && !_is_moved[pair.b])
+            {
+                _pair_keys[kept_count++] = pair_key;
+            }
+        }
+        _pair_keys.resize(kept_count);
+
+        for (uint32 moved_id : _moved_ids)
+        {
+            if (!contains(moved_id))
+            {
+                continue;
+            }
+
+            _query(_nodes[_id_leaves[moved_id]].bounds, [&](uint32 id){
+                // Two moved objects find each other twice, keep the one from the smaller id
+                if (id != moved_id && !(_is_moved[id] && id < moved_id))
+                {
+                    _pair_keys.push_back(make_unordered_pair_key(moved_id, id));
+                }
+            });
+        }
+
+        std::sort(_pair_keys.begin() + kept_count, _pair_keys.end());
+        std::inplace_merge(_pair_keys.begin(), _pair_keys.begin() + kept_count, _pair_keys.end());
+
+        for (uint32 moved_id : _moved_ids)
+        {
+            _is_moved[moved_id] = 0;
+        }
+        _moved_ids.clear();
+    }
+
+    // Fat boxes overlapping doesn't mean the objects do
+    out_potential_collision_pairs.clear();
+    for (uint64 pair_key : _pair_keys)
+    {
+        const Pair<uint32, uint32> pair = get_unordered_pair(pair_key);
+        if (overlaps(_bounds[pair.a], _bounds[pair.b]))
+        {
+            out_potential_collision_pairs.push_back(pair);
+        }
+    }
+}
+
+void Dynamic_AABB_Tree::_ensure_id(uint32 in_id)
+{
+    if (in_id < _id_leaves.size())
+    {
+        return;
+    }
+
+    const int64 size = static_cast<int64>(in_id) + 1;
+    if (size > _id_leaves.capacity())
+    {
+        const int64 capacity = size > _id_leaves.capacity() * 2 ? size : _id_leaves.capacity() * 2;
+        _id_leaves.reserve(capacity);
+        _bounds.reserve(capacity);
+        _is_moved.reserve(capacity);
+    }
+
+    _id_leaves.resize(size, null_node);
+    _bounds.resize(size);
+    _is_moved.resize(size, 0);
+}
+
+void Dynamic_AABB_Tree::_mark_moved(uint32 in_id)
+{
+    if (!_is_moved[in_id])
+    {
+        _is_moved[in_id] = 1;
+        _moved_ids.push_back(in_id);
+    }
+}
+
+AABB Dynamic_AABB_Tree::_make_fat_bounds(const AABB& in_bounds, const vec3& displacement) const
+{
+    const vec3 margin(_fat_margin, _fat_margin, _fat_margin);
+    AABB fat_bounds(in_bounds.min - margin, in_bounds.max + margin);
+
+    // Reach ahead where the object is heading, so steady movement doesn't reinsert every step
+    const vec3 reach = displacement * _displacement_multiplier;
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+        if (reach[axis] < 0.0f)
+        {
+            fat_bounds.min[axis] += reach[axis];
+        }
+        else
+        {
+            fat_bounds.max[axis] += reach[axis];
+        }
+    }
+
+    return fat_bounds;
+}
+
+int32 Dynamic_AABB_Tree::_allocate_node()
+{
+    if (_free_list == null_node)
+    {
+        _nodes.push_back(Node());
+        return static_cast<int32>(_nodes.size() - 1);
+    }
+
+    const int32 node = _free_list;
+    _free_list = _nodes[node].parent;
+    _nodes[node] = Node();
+    return node;
+}
+
+void Dynamic_AABB_Tree::_free_node(int32 node)
+{
+    _nodes[node].parent = _free_list;
+    _nodes[node].height = -1;
+    _free_list = node;
+}
+
+void Dynamic_AABB_Tree::_insert_leaf(int32 leaf)
+{
+    if (_root == null_node)
+    {
+        _root = leaf;
+        _nodes[leaf].parent = null_node;
+        return;
+    }
+
+    // Walk down to the sibling that grows the total surface area the least. Going into a child
+    // also grows every node above it, that's the inherited cost
+    const AABB leaf_bounds = _nodes[leaf].bounds;
+    int32 index = _root;
+    while (!_nodes[index].is_leaf())
+    {
+        const Node& node = _nodes[index];
+        const float area = surface_area(node.bounds);
+        const float combined_area = surface_area(union_of(node.bounds, leaf_bounds));
+
+        // Pairing with this node directly
+        const float cost = 2.0f * combined_area;
+        const float inherited_cost = 2.0f * (combined_area - area);
+
+        const auto child_cost = [&](int32 child_index){
+            const Node& child = _nodes[child_index];
+            const float new_area = surface_area(union_of(child.bounds, leaf_bounds));
+            return (child.is_leaf() ? new_area : new_area - surface_area(child.bounds)) + inherited_cost;
+        };
+
+        const float left_cost = child_cost(node.left);
+        const float right_cost = child_cost(node.right);
+
+        if (cost < left_cost && cost < right_cost)
+        {
+            break;
+        }
+
+        index = left_cost < right_cost ? node.left : node.right;
+    }
+
+    const int32 sibling = index;
+    const int32 old_parent = _nodes[sibling].parent;
+
+    // Can reallocate the nodes, no references across this
+    const int32 new_parent = _allocate_node();
+    _nodes[new_parent].parent = old_parent;
+    _nodes[new_parent].bounds = union_of(leaf_bounds, _nodes[sibling].bounds);
+    _nodes[new_parent].height = _nodes[sibling].height + 1;
+    _nodes[new_parent].left = sibling;
+    _nodes[new_parent].right = leaf;
+    _nodes[sibling].parent = new_parent;
+    _nodes[leaf].parent = new_parent;
+
+    if (old_parent == null_node)
+    {
+        _root = new_parent;
+    }
+    else if (_nodes[old_parent].left == sibling)
+    {
+        _nodes[old_parent].left = new_parent;
+    }
+    else
+    {
+        _nodes[old_parent].right = new_parent;
+    }
+
+    _refit_to_root(_nodes[leaf].parent);
+}
+
+void Dynamic_AABB_Tree::_remove_leaf(int32 leaf)
+{
+    if (leaf == _root)
+    {
+        _root = null_node;
+        return;
+    }
+
+    // The parent goes away, the sibling takes its place
+    const int32 parent = _nodes[leaf].parent;
+    const int32 grand_parent = _nodes[parent].parent;
+    const int32 sibling = _nodes[parent].left == leaf ? _nodes[parent].right : _nodes[parent].left;
+
+    if (grand_parent == null_node)
+    {
+        _root = sibling;
+        _nodes[sibling].parent = null_node;
+        _free_node(parent);
+        return;
+    }
+
+    if (_nodes[grand_parent].left == parent)
+    {
+        _nodes[grand_parent].left = sibling;
+    }
+    else
+    {
+        _nodes[grand_parent].right = sibling;
+    }
+    _nodes[sibling].parent = grand_parent;
+    _free_node(parent);
+
+    _refit_to_root(grand_parent);
+}
+
+void Dynamic_AABB_Tree::_refit_to_root(int32 node)
+{
+    while (node != null_node)
+    {
+        node = _balance(node);
+
+        Node& current = _nodes[node];
+        const Node& left = _nodes[current.left];
+        const Node& right = _nodes[current.right];
+        current.height = 1 + std::max(left.height, right.height);
+        current.bounds = union_of(left.bounds, right.bounds);
+
+        node = current.parent;
+    }
+}
+
+int32 Dynamic_AABB_Tree::_balance(int32 a_index)
+{
+    Node& a = _nodes[a_index];
+    if (a.is_leaf() || a.height < 2)
+    {
+        return a_index;
+    }
+
+    const int32 b_index = a.left;
+    const int32 c_index = a.right;
+    Node& b = _nodes[b_index];
+    Node& c = _nodes[c_index];
+
+    const int32 balance = c.height - b.height;
+
+    // Rotates the taller child up into a's place, a takes the child's shorter subtree
+    const auto rotate_up = [&](int32 up_index, Node& up, Node& other, bool up_was_right){
+        const int32 f_index = up.left;
+        const int32 g_index = up.right;
+        Node& f = _nodes[f_index];
+        Node& g = _nodes[g_index];
+
+        up.left = a_index;
+        up.parent = a.parent;
+        a.parent = up_index;
+
+        if (up.parent == null_node)
+        {
+            _root = up_index;
+        }
+        else if (_nodes[up.parent].left == a_index)
+        {
+            _nodes[up.parent].left = up_index;
+        }
+        else
+        {
+            _nodes[up.parent].right = up_index;
+        }
+
+        // The taller grandchild stays with up, the other one replaces up under a
+        const bool keep_f = f.height > g.height;
+        const int32 kept_index = keep_f ? f_index : g_index;
+        const int32 moved_index = keep_f ? g_index : f_index;
+        Node& kept = _nodes[kept_index];
+        Node& moved = _nodes[moved_index];
+
+        up.right = kept_index;
+        if (up_was_right)
+        {
+            a.right = moved_index;
+        }
+        else
+        {
+            a.left = moved_index;
+        }
+        moved.parent = a_index;
+
+        a.bounds = union_of(other.bounds, moved.bounds);
+        a.height = 1 + std::max(other.height, moved.height);
+        up.bounds = union_of(a.bounds, kept.bounds);
+        up.height = 1 + std::max(a.height, kept.height);
+
+        return up_index;
+    };
+
+    if (balance > 1)
+    {
+        return rotate_up(c_index, c, b, true);
+    }
+
+    if (balance < -1)
+    {
+        return rotate_up(b_index, b, c, false);
+    }
+
+    return a_index;
+}
+
+template<typename Function>
+void Dynamic_AABB_Tree::_query(const AABB& in_bounds, Function function) const
+{
+    if (_root == null_node)
+    {
+        return;
+    }
+
+    Small_Array<int32, 64> stack;
+    stack.push_back(_root);
+    while (stack.size() > 0)
+    {
+        const int32 index = stack[stack.size() - 1];
+        stack.pop_back();
+
+        const Node& node = _nodes[index];
+        if (!overlaps(node.bounds, in_bounds))
+        {
+            continue;
+        }
+
+        if (node.is_leaf())
+        {
+            function(node.id);
+        }
+        else
+        {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+}
@@ -0,0 +1,115 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Bounding volume hierarchy over fattened leaf bounds, for the broadphase and scene queries.
+// Leaves store the object's bounds grown by a margin and by its last displacement, so an
+// object only leaves and reenters the tree once it moves out of that fat box. Inserts pick
+// the sibling with the cheapest surface area increase, and every node on the way back up
+// gets an AVL style rotation, so the tree stays balanced without full rebuilds.
+// Nodes live in one flat array with a free list, links are indices.
+// Overlapping fat boxes are kept as a sorted pair list between steps, only pairs of moved
+// objects are searched again. Pairs come out filtered by the objects' real bounds.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/math/math.hpp"
+#include "cs/containers/pair.hpp"
+#include "cs/containers/dynamic_array.hpp"
+#include "cs/engine/physics/broadphase.hpp"
+
+class Dynamic_AABB_Tree : public Broadphase
+{
+public:
+    static constexpr int32 null_node = -1;
+
+public:
+    // fat_margin is added on every side of the leaves, displacement_multiplier scales how far
+    // ahead along the last movement the fat box reaches
+    Dynamic_AABB_Tree(float fat_margin = 0.1f, float displacement_multiplier = 2.0f);
+
+    Broadphase_Type::Type get_type() const override { return Broadphase_Type::AABB_Tree; }
+
+    void update(uint32 in_id, const AABB& in_bounds) override;
+    void remove(uint32 in_id) override;
+    void clear() override;
+
+    bool contains(uint32 in_id) const { return in_id < _id_leaves.size() && _id_leaves[in_id] != null_node; }
+    int64 size() const { return _leaf_count; }
+    // 0 when empty, 1 for a single leaf
+    int32 get_height() const { return _root == null_node ? 0 : _nodes[_root].height + 1; }
+
+    AABB get_bounds(uint32 in_id) const
+    {
+        assert(contains(in_id));
+        return _bounds[in_id];
+    }
+
+    AABB get_fat_bounds(uint32 in_id) const
+    {
+        assert(contains(in_id));
+        return _nodes[_id_leaves[in_id]].bounds;
+    }
+
+    // Appends every id overlapping in_bounds once, sorted, returns how many were added
+    int32 get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const override;
+
+    // Appends every id whose bounds the ray hits within max_distance, returns how many were added.
+    // direction doesn't have to be normalized, distance is measured in its lengths
+    int32 raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_hits) const override;
+
+    // Each overlapping pair once, smaller id first, sorted
+    void find_pairs(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs) override;
+
+private:
+    struct Node
+    {
+        // Fat for leaves, union of the children otherwise
+        AABB bounds;
+        // Next free node while on the free list
+        int32 parent { null_node };
+        int32 left { null_node };
+        int32 right { null_node };
+        // Leaves are 0, free nodes -1
+        int32 height { -1 };
+        uint32 id { 0 };
+
+        bool is_leaf() const { return left == null_node; }
+    };
+
+    float _fat_margin;
+    float _displacement_multiplier;
+
+    Dynamic_Array<Node> _nodes;
+    int32 _root { null_node };
+    int32 _free_list { null_node };
+    int64 _leaf_count { 0 };
+
+    // Indexed by id
+    Dynamic_Array<int32> _id_leaves;
+    Dynamic_Array<AABB> _bounds;
+    Dynamic_Array<uint8> _is_moved;
+
+    // Ids whose fat box changed (or that were removed) since the last find_pairs
+    Dynamic_Array<uint32> _moved_ids;
+    // make_unordered_pair_key of every pair of overlapping fat boxes, sorted
+    Dynamic_Array<uint64> _pair_keys;
+
+private:
+    void _ensure_id(uint32 in_id);
+    void _mark_moved(uint32 in_id);
+    AABB _make_fat_bounds(const AABB& in_bounds, const vec3& displacement) const;
+
+    int32 _allocate_node();
+    void _free_node(int32 node);
+    void _insert_leaf(int32 leaf);
+    void _remove_leaf(int32 leaf);
+    // Refits and rebalances every node from node up to the root
+    void _refit_to_root(int32 node);
+    int32 _balance(int32 node);
+
+    // Calls function(id) for every leaf whose fat box overlaps in_bounds
+    template<typename Function>
+    void _query(const AABB& in_bounds, Function function) const;
+};
@@ -1,50 +1,217 @@
 #pragma once
 
 #include <memory>
+#include <cstring>
+#include <utility>
+#include <initializer_list>
 
 #include "cs/cs.hpp"
+#include "cs/memory/memory_stats.hpp"
 
-template<typename Type>
+// Element moves shared by the array containers, memcpy for trivially relocatable types
+namespace Array_Helpers
+{
+    // Moves count elements into uninitialized memory at to, leaving from uninitialized
+    template<typename Type>
+    void relocate(Type* from, Type* to, int64 count)
+    {
+        if (count <= 0) return;
+
+        if constexpr (Is_Trivially_Relocatable<Type>::value)
+        {
+            memcpy(static_cast<void*>(to), static_cast<const void*>(from), count * sizeof(Type));
+        }
+        else
+        {
+            for (int64 i = 0; i < count; ++i)
+            {
+                new (to + i) Type(std::move(from[i]));
+                from[i].~Type();
+            }
+        }
+    }
+
+    template<typename Type>
+    void copy_construct(const Type* from, Type* to, int64 count)
+    {
+        if (count <= 0) return;
+
+        if constexpr (std::is_trivially_copyable_v<Type>)
+        {
+            memcpy(static_cast<void*>(to), static_cast<const void*>(from), count * sizeof(Type));
+        }
+        else
+        {
+            for (int64 i = 0; i < count; ++i)
+            {
+                new (to + i) Type(from[i]);
+            }
+        }
+    }
+
+    template<typename Type>
+    void destroy(Type* data, int64 count)
+    {
+        if constexpr (!std::is_trivially_destructible_v<Type>)
+        {
+            for (int64 i = 0; i < count; ++i)
+            {
+                data[i].~Type();
+            }
+        }
+    }
+
+    // Removes data[index], shifting the tail left. data[size - 1] is uninitialized afterwards
+    template<typename Type>
+    void erase_shift(Type* data, int64 size, int64 index)
+    {
+        if constexpr (Is_Trivially_Relocatable<Type>::value)
+        {
+            data[index].~Type();
+            memmove(static_cast<void*>(data + index), static_cast<const void*>(data + index + 1), (size - index - 1) * sizeof(Type));
+        }
+        else
+        {
+            for (int64 i = index; i < size - 1; ++i)
+            {
+                data[i] = std::move(data[i + 1]);
+            }
+            data[size - 1].~Type();
+        }
+    }
+
+    // Opens a gap at data[index], shifting the tail right. Needs room for size + 1 elements,
+    // data[index] is uninitialized afterwards
+    template<typename Type>
+    void insert_shift(Type* data, int64 size, int64 index)
+    {
+        if (index == size) return;
+
+        if constexpr (Is_Trivially_Relocatable<Type>::value)
+        {
+            memmove(static_cast<void*>(data + index + 1), static_cast<const void*>(data + index), (size - index) * sizeof(Type));
+        }
+        else
+        {
+            new (data + size) Type(std::move(data[size - 1]));
+            for (int64 i = size - 1; i > index; --i)
+            {
+                data[i] = std::move(data[i - 1]);
+            }
+            data[index].~Type();
+        }
+    }
+
+    // Stable, single pass. Returns the new size, elements past it are already destroyed
+    template<typename Type, typename Predicate>
+    int64 erase_all_if(Type* data, int64 size, Predicate& predicate)
+    {
+        int64 write = 0;
+        for (int64 read = 0; read < size; ++read)
+        {
+            if (predicate(data[read]))
+            {
+                continue;
+            }
+
+            if (write != read)
+            {
+                data[write] = std::move(data[read]);
+            }
+            ++write;
+        }
+
+        destroy(data + write, size - write);
+        return write;
+    }
+}
+
+// Allocator can be stateful (see Resource_Allocator), copies and moves follow its allocator_traits
+template<typename Type, typename Allocator = std::allocator<Type>>
 class Dynamic_Array
 {
+    using Allocator_Traits = std::allocator_traits<Allocator>;
+
 public:
     Dynamic_Array() = default;
 
-    Dynamic_Array(std::initializer_list<Type> list)
+    explicit Dynamic_Array(const Allocator& allocator)
+        : _allocator(allocator)
+    {
+    }
+
+    Dynamic_Array(std::initializer_list<Type> list, const Allocator& allocator = Allocator())
+        : _allocator(allocator)
     {
         _increase_capacity(list.size());
-        uint64 count = 0;
-        for (const Type& value : list)
-        {
-            _data[count++] = value;
-        }
-        _size = count;
+        Array_Helpers::copy_construct(list.begin(), _data, list.size());
+        _size = list.size();
     }
 
     Dynamic_Array(const Dynamic_Array& other)
+        : _allocator(Allocator_Traits::select_on_container_copy_construction(other._allocator))
+    {
+        _copy_from(other);
+    }
+
+    Dynamic_Array(Dynamic_Array&& other) noexcept
+        : _allocator(std::move(other._allocator))
+    {
+        _steal_from(other);
+    }
+
+    Dynamic_Array& operator=(const Dynamic_Array& other)
     {
-        _increase_capacity(other.capacity());
-        for (int64 i = 0; i < other.size(); i++)
+        if (this != &other)
         {
-            _data[i] = other[i];
+            clear();
+            if constexpr (Allocator_Traits::propagate_on_container_copy_assignment::value)
+            {
+                if (_allocator != other._allocator)
+                {
+                    _deallocate();
+                }
+                _allocator = other._allocator;
+            }
+            _copy_from(other);
         }
-        _size = other.size();
+
+        return *this;
     }
 
-    Dynamic_Array& operator=(const Dynamic_Array& other)
+    Dynamic_Array& operator=(Dynamic_Array&& other) noexcept(Allocator_Traits::propagate_on_container_move_assignment::value || Allocator_Traits::is_always_equal::value)
     {
-        _increase_capacity(other.capacity());
-        for (int64 i = 0; i < other.size(); i++)
+        if (this != &other)
         {
-            _data[i] = other[i];
+            clear();
+            if constexpr (Allocator_Traits::propagate_on_container_move_assignment::value)
+            {
+                _deallocate();
+                _allocator = std::move(other._allocator);
+                _steal_from(other);
+            }
+            else if (_allocator == other._allocator)
+            {
+                _deallocate();
+                _steal_from(other);
+            }
+            else
+            {
+                // Can't take memory owned by another allocator, move the elements over
+                _increase_capacity(other._size);
+                Array_Helpers::relocate(other._data, _data, other._size);
+                _size = other._size;
+                other._size = 0;
+            }
         }
-        _size = other.size();
+
         return *this;
     }
 
     ~Dynamic_Array()
     {
-        _allocator.deallocate(_data, _capacity);
+        clear();
+        _deallocate();
     }
 
     void reserve(int64 new_size)
@@ -52,52 +219,92 @@ public:
         _increase_capacity(new_size);
     }
 
-    void push_back(const Type& value)
+    // Default constructs new elements
+    void resize(int64 new_size)
     {
-        if (_size == _capacity)
-        {
-            _increase_capacity(_capacity == 0 ? 1 : _capacity * 2);
-        }
+        _resize(new_size, [](Type* at) { new (at) Type(); });
+    }
 
-        new (_data + _size++) Type(value);
+    void resize(int64 new_size, const Type& value)
+    {
+        // value could live inside this array
+        const Type copy(value);
+        _resize(new_size, [&copy](Type* at) { new (at) Type(copy); });
+    }
+
+    void push_back(const Type& value)
+    {
+        emplace_back(value);
     }
 
     void push_back(Type&& value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template<typename... Args>
+    Type& emplace_back(Args&&... args)
     {
         if (_size == _capacity)
         {
-            _increase_capacity(_capacity == 0 ? 1 : _capacity * 2);
+            // Construct into the new storage first, args could reference elements of the old one
+            const int64 new_capacity = _capacity == 0 ? 1 : _capacity * 2;
+            Type* new_data = Container_Memory::allocate(_allocator, new_capacity, Container_Family::Dynamic_Array);
+            new (new_data + _size) Type(std::forward<Args>(args)...);
+            Array_Helpers::relocate(_data, new_data, _size);
+
+            _deallocate();
+            _data = new_data;
+            _capacity = new_capacity;
+        }
+        else
+        {
+            new (_data + _size) Type(std::forward<Args>(args)...);
         }
 
-        new (_data + _size++) Type(std::move(value));
+        return _data[_size++];
     }
 
-    void clear() 
+    void insert(int64 index, const Type& value)
     {
-        for (int64 i = 0; i < _size; ++i)
-        {
-            _data[i].~Type();
-        }
+        _insert(index, Type(value));
+    }
+
+    void insert(int64 index, Type&& value)
+    {
+        _insert(index, Type(std::move(value)));
+    }
+
+    void clear()
+    {
+        Array_Helpers::destroy(_data, _size);
         _size = 0;
     }
 
-    void pop_back() 
+    void pop_back()
     {
         if (_size == 0) return;
         _data[_size - 1].~Type();
         --_size;
     }
 
-    void erase(size_t index) 
+    // Keeps order, O(n)
+    void erase(int64 index)
     {
-        _data[index].~Type();  // Destroy the element at the index
+        assert(index >= 0 && index < _size);
+        Array_Helpers::erase_shift(_data, _size, index);
+        --_size;
+    }
 
-        // Shift elements to the left
-        for (int64 i = index; i < _size - 1; ++i)
+    // Moves the last element into index, O(1) but doesn't keep order
+    void swap_remove(int64 index)
+    {
+        assert(index >= 0 && index < _size);
+        if (index != _size - 1)
         {
-            new (_data + i) Type(std::move(_data[i + 1]));  // Move next element
+            _data[index] = std::move(_data[_size - 1]);
         }
-        --_size;
+        pop_back();
     }
 
     void enqueue(const Type& value)
@@ -107,13 +314,13 @@ public:
 
     void enqueue(Type&& value)
     {
-        push_back(value);
+        push_back(std::move(value));
     }
 
-    Type& dequeue()
+    Type dequeue()
     {
         assert(_size > 0);
-        Type ret = _data[0];
+        Type ret = std::move(_data[0]);
         erase(0);
         return ret;
     }
@@ -172,30 +379,20 @@ public:
         return false;
     }
 
+    // Keeps order of the remaining elements, single pass
     template<typename Predicate>
     int64 erase_all_if(Predicate predicate)
     {
-        int64 count = 0;
-
-        for (int64 i = 0; i < _size;)
-        {
-            if (predicate(_data[i]))
-            {
-                erase(i);
-                ++count;
-            }
-            else
-            {
-                ++i;
-            }
-        }
-
+        const int64 new_size = Array_Helpers::erase_all_if(_data, _size, predicate);
+        const int64 count = _size - new_size;
+        _size = new_size;
         return count;
     }
 
     int64 size() const { return _size; }
     int64 size_in_bytes() const { return _size * sizeof(Type); }
     int64 capacity() const { return _capacity; }
+    const Allocator& get_allocator() const { return _allocator; }
 
     Type& front() { assert(_size > 0); return _data[0]; }
     Type& front() const { assert(_size > 0); return _data[0]; }
@@ -215,20 +412,20 @@ public:
 
     std::reverse_iterator<Type*> rbegin() { return std::reverse_iterator<Type*>(end()); }
     std::reverse_iterator<Type*> rend() { return std::reverse_iterator<Type*>(begin()); }
-    
+
     std::reverse_iterator<const Type*> rbegin() const { return std::reverse_iterator<const Type*>(end()); }
     std::reverse_iterator<const Type*> rend() const { return std::reverse_iterator<const Type*>(begin()); }
-    
+
     std::reverse_iterator<const Type*> crbegin() const { return std::reverse_iterator<const Type*>(cend()); }
     std::reverse_iterator<const Type*> crend() const { return std::reverse_iterator<const Type*>(cbegin()); }
 private:
     Type* _data { nullptr };
     int64 _capacity { 0 }, _size { 0 };
 
-    using Allocator = std::allocator<Type>;
     Allocator _allocator;
 
 private:
+    // Only allocates, slots past _size stay uninitialized
     void _increase_capacity(int64 new_capacity)
     {
         // No need to resize
@@ -237,22 +434,74 @@ private:
             return;
         }
 
-        using traits_t2 = std::allocator_traits<decltype(_allocator)>;
-        Type* new_data = traits_t2::allocate(_allocator, new_capacity);
+        Type* new_data = Container_Memory::allocate(_allocator, new_capacity, Container_Family::Dynamic_Array);
+        Array_Helpers::relocate(_data, new_data, _size);
 
-        for (int64 i = 0; i < _size; ++i)
+        _deallocate();
+        _data = new_data;
+        _capacity = new_capacity;
+    }
+
+    void _deallocate()
+    {
+        if (_data)
         {
-            new (new_data + i) Type(std::move(_data[i]));
-            _data[i].~Type();
+            Container_Memory::deallocate(_allocator, _data, _capacity, Container_Family::Dynamic_Array);
+            _data = nullptr;
+            _capacity = 0;
         }
+    }
 
-        for (int64 i = _size; i < new_capacity; ++i)
+    template<typename Construct>
+    void _resize(int64 new_size, Construct&& construct)
+    {
+        assert(new_size >= 0);
+
+        if (new_size < _size)
         {
-            traits_t2::construct(_allocator, new_data + i);
+            Array_Helpers::destroy(_data + new_size, _size - new_size);
+            _size = new_size;
+            return;
         }
 
-        _allocator.deallocate(_data, _capacity);
-        _data = new_data;
-        _capacity = new_capacity;
+        _increase_capacity(new_size);
+        for (; _size < new_size; ++_size)
+        {
+            construct(_data + _size);
+        }
+    }
+
+    void _insert(int64 index, Type&& value)
+    {
+        assert(index >= 0 && index <= _size);
+
+        if (_size == _capacity)
+        {
+            _increase_capacity(_capacity == 0 ? 1 : _capacity * 2);
+        }
+
+        Array_Helpers::insert_shift(_data, _size, index);
+        new (_data + index) Type(std::move(value));
+        ++_size;
+    }
+
+    // Expects this array to be empty
+    void _copy_from(const Dynamic_Array& other)
+    {
+        _increase_capacity(other.size());
+        Array_Helpers::copy_construct(other._data, _data, other._size);
+        _size = other._size;
+    }
+
+    // Expects this array to be empty and deallocated
+    void _steal_from(Dynamic_Array& other)
+    {
+        _data = other._data;
+        _capacity = other._capacity;
+        _size = other._size;
+
+        other._data = nullptr;
+        other._capacity = 0;
+        other._size = 0;
     }
 };
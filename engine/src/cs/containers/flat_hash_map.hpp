@@ -0,0 +1,710 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Open addressing hash map with a separate 1-byte control array (SwissTable layout).
+// Control bytes are probed 16 at a time, so a lookup only touches the slot array
+// once the 7-bit hash fragment matches.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/containers/pair.hpp"
+#include "cs/memory/memory_stats.hpp"
+
+#include <bit>
+#include <memory>
+#include <cstring>
+#include <functional>
+
+#if defined(CS_SSE2)
+    #include <emmintrin.h>
+#elif defined(CS_NEON)
+    #include <arm_neon.h>
+#endif
+
+namespace Flat_Hash_Map_Control
+{
+// Full slots store the low 7 bits of the hash (0..127), everything else has the sign bit set
+enum Type : int8
+{
+    Empty   = -128,
+    Deleted = -2
+};
+
+constexpr int64 group_width = 16;
+}
+
+// Bitmasks over one group of control bytes, bit i set when control[i] matches
+struct Flat_Hash_Map_Group
+{
+#if defined(CS_SSE2)
+    __m128i control;
+
+    explicit Flat_Hash_Map_Group(const int8* in_control)
+        : control(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in_control)))
+    {
+    }
+
+    uint32 match(int8 h2) const
+    {
+        return static_cast<uint32>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), control)));
+    }
+
+    uint32 match_empty() const
+    {
+        return match(Flat_Hash_Map_Control::Empty);
+    }
+
+    uint32 match_empty_or_deleted() const
+    {
+        return static_cast<uint32>(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), control)));
+    }
+
+    uint32 match_full() const
+    {
+        return ~static_cast<uint32>(_mm_movemask_epi8(control)) & 0xFFFF;
+    }
+#elif defined(CS_NEON)
+    int8x16_t control;
+
+    explicit Flat_Hash_Map_Group(const int8* in_control)
+        : control(vld1q_s8(in_control))
+    {
+    }
+
+    uint32 match(int8 h2) const
+    {
+        return _movemask(vceqq_s8(vdupq_n_s8(h2), control));
+    }
+
+    uint32 match_empty() const
+    {
+        return match(Flat_Hash_Map_Control::Empty);
+    }
+
+    uint32 match_empty_or_deleted() const
+    {
+        return _movemask(vcltq_s8(control, vdupq_n_s8(-1)));
+    }
+
+    uint32 match_full() const
+    {
+        return _movemask(vcgeq_s8(control, vdupq_n_s8(0)));
+    }
+
+private:
+    static uint32 _movemask(uint8x16_t input)
+    {
+        static const uint8 bits[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+        const uint8x16_t masked = vandq_u8(input, vld1q_u8(bits));
+        return static_cast<uint32>(vaddv_u8(vget_low_u8(masked))) |
+            (static_cast<uint32>(vaddv_u8(vget_high_u8(masked))) << 8);
+    }
+#else
+    const int8* control;
+
+    explicit Flat_Hash_Map_Group(const int8* in_control)
+        : control(in_control)
+    {
+    }
+
+    uint32 match(int8 h2) const
+    {
+        uint32 mask = 0;
+        for (int32 i = 0; i < Flat_Hash_Map_Control::group_width; ++i)
+        {
+            mask |= static_cast<uint32>(control[i] == h2) << i;
+        }
+        return mask;
+    }
+
+    uint32 match_empty() const
+    {
+        return match(Flat_Hash_Map_Control::Empty);
+    }
+
+    uint32 match_empty_or_deleted() const
+    {
+        uint32 mask = 0;
+        for (int32 i = 0; i < Flat_Hash_Map_Control::group_width; ++i)
+        {
+            mask |= static_cast<uint32>(control[i] < -1) << i;
+        }
+        return mask;
+    }
+
+    uint32 match_full() const
+    {
+        uint32 mask = 0;
+        for (int32 i = 0; i < Flat_Hash_Map_Control::group_width; ++i)
+        {
+            mask |= static_cast<uint32>(control[i] >= 0) << i;
+        }
+        return mask;
+    }
+#endif
+};
+
+template<typename Key, typename Value>
+class Flat_Hash_Map_Iterator
+{
+public:
+    using Type = Pair<Key, Value>;
+
+    Flat_Hash_Map_Iterator(const int8* control, Type* slots, int64 index, int64 capacity)
+        :_control(control), _slots(slots), _index(index), _capacity(capacity)
+    {
+        _skip_invalid_slots();
+    }
+
+    Type& operator*() { return _slots[_index]; }
+    Type* operator->() { return &_slots[_index]; }
+
+    Flat_Hash_Map_Iterator<Key, Value>& operator++()
+    {
+        ++_index;
+        _skip_invalid_slots();
+        return *this;
+    }
+
+    bool operator==(const Flat_Hash_Map_Iterator& other) const
+    {
+        return _index == other._index;
+    }
+
+    bool operator!=(const Flat_Hash_Map_Iterator& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    const int8* _control;
+    Type* _slots;
+    int64 _index, _capacity;
+
+    // Skips whole groups of control bytes instead of visiting every slot
+    void _skip_invalid_slots()
+    {
+        constexpr int64 group_width = Flat_Hash_Map_Control::group_width;
+
+        while (_index < _capacity)
+        {
+            const int64 group_start = _index & ~(group_width - 1);
+            const uint32 full = Flat_Hash_Map_Group(_control + group_start).match_full() >> (_index - group_start);
+            if (full != 0)
+            {
+                _index += std::countr_zero(full);
+                return;
+            }
+
+            _index = group_start + group_width;
+        }
+
+        _index = _capacity;
+    }
+};
+
+// Allocator is rebound for both the slots and the control bytes, copies and moves follow its allocator_traits
+template<typename Key, typename Value, typename Hash_Function = std::hash<Key>, typename Allocator = std::allocator<Pair<Key, Value>>>
+class Flat_Hash_Map
+{
+public:
+    using Slot = Pair<Key, Value>;
+    using Iterator = Flat_Hash_Map_Iterator<Key, Value>;
+
+private:
+    using Slot_Allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+    using Control_Allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<int8>;
+    using Allocator_Traits = std::allocator_traits<Slot_Allocator>;
+
+public:
+    Flat_Hash_Map(int64 initial_capacity = 32, const Allocator& allocator = Allocator())
+        : _allocator(allocator)
+    {
+        reserve(initial_capacity);
+    }
+
+    ~Flat_Hash_Map()
+    {
+        _destroy_slots();
+        _deallocate(_control, _slots, _capacity);
+    }
+
+    Flat_Hash_Map(const Flat_Hash_Map& other)
+        : _allocator(Allocator_Traits::select_on_container_copy_construction(other._allocator))
+    {
+        _copy_from(other);
+    }
+
+    Flat_Hash_Map(Flat_Hash_Map&& other) noexcept
+        : _allocator(std::move(other._allocator))
+    {
+        _steal_from(other);
+    }
+
+    Flat_Hash_Map& operator=(const Flat_Hash_Map& other)
+    {
+        if (this != &other)
+        {
+            _destroy_slots();
+            _deallocate(_control, _slots, _capacity);
+            _reset_empty();
+            if constexpr (Allocator_Traits::propagate_on_container_copy_assignment::value)
+            {
+                _allocator = other._allocator;
+            }
+            _copy_from(other);
+        }
+
+        return *this;
+    }
+
+    Flat_Hash_Map& operator=(Flat_Hash_Map&& other) noexcept(Allocator_Traits::propagate_on_container_move_assignment::value || Allocator_Traits::is_always_equal::value)
+    {
+        if (this != &other)
+        {
+            _destroy_slots();
+            _deallocate(_control, _slots, _capacity);
+            _reset_empty();
+
+            if constexpr (Allocator_Traits::propagate_on_container_move_assignment::value)
+            {
+                _allocator = std::move(other._allocator);
+                _steal_from(other);
+            }
+            else if (_allocator == other._allocator)
+            {
+                _steal_from(other);
+            }
+            else
+            {
+                // Can't take memory owned by another allocator, move the elements over
+                _move_elements_from(other);
+            }
+        }
+
+        return *this;
+    }
+
+    void reserve(int64 capacity)
+    {
+        // Keep the table under the max load factor after `capacity` inserts
+        const int64 needed = _normalize_capacity(capacity + capacity / 7);
+        if (needed > _capacity)
+        {
+            _resize(needed);
+        }
+    }
+
+    void clear()
+    {
+        _destroy_slots();
+        if (_capacity > 0)
+        {
+            memset(_control, Flat_Hash_Map_Control::Empty, _capacity);
+        }
+        _size = 0;
+        _growth_left = _max_load(_capacity);
+    }
+
+    Value* insert(const Key& key, const Value& value)
+    {
+        const uint64 hash = _hash(key);
+        const int64 found = _find_index(key, hash);
+        // replace the value
+        if (found >= 0)
+        {
+            _slots[found].b = value;
+            return nullptr;
+        }
+
+        const int64 index = _prepare_insert(hash);
+        new (_slots + index) Slot{ key, value };
+        return &_slots[index].b;
+    }
+
+    Value* find(const Key& key)
+    {
+        const int64 index = _find_index(key, _hash(key));
+        return index >= 0 ? &_slots[index].b : nullptr;
+    }
+
+    const Value* find(const Key& key) const
+    {
+        const int64 index = _find_index(key, _hash(key));
+        return index >= 0 ? &_slots[index].b : nullptr;
+    }
+
+    Value& find_or_add(const Key& key)
+    {
+        const uint64 hash = _hash(key);
+        const int64 found = _find_index(key, hash);
+        if (found >= 0)
+        {
+            return _slots[found].b;
+        }
+
+        const int64 index = _prepare_insert(hash);
+        new (_slots + index) Slot{ key, Value{} };
+        return _slots[index].b;
+    }
+
+    bool erase(const Key& key)
+    {
+        constexpr int64 group_width = Flat_Hash_Map_Control::group_width;
+
+        const int64 index = _find_index(key, _hash(key));
+        if (index < 0)
+        {
+            return false;
+        }
+
+        _slots[index].~Slot();
+        --_size;
+
+        // If the group already has an empty slot, every probe through it stops here,
+        // so the slot can become empty again instead of a tombstone.
+        if (Flat_Hash_Map_Group(_control + (index & ~(group_width - 1))).match_empty() != 0)
+        {
+            _control[index] = Flat_Hash_Map_Control::Empty;
+            ++_growth_left;
+        }
+        else
+        {
+            _control[index] = Flat_Hash_Map_Control::Deleted;
+        }
+
+        return true;
+    }
+
+    int64 get_size() const { return _size; }
+    int64 get_capacity() const { return _capacity; }
+    Allocator get_allocator() const { return Allocator(_allocator); }
+
+    Iterator begin() { return Iterator(_control, _slots, 0, _capacity); }
+    Iterator begin() const { return Iterator(_control, _slots, 0, _capacity); }
+    Iterator end() { return Iterator(_control, _slots, _capacity, _capacity); }
+    Iterator end() const { return Iterator(_control, _slots, _capacity, _capacity); }
+
+private:
+    int8* _control { nullptr };
+    Slot* _slots { nullptr };
+    // Always a power of two and a multiple of the group width
+    int64 _capacity { 0 };
+    int64 _size { 0 };
+    int64 _growth_left { 0 };
+    Hash_Function _hash_function;
+    Slot_Allocator _allocator;
+
+private:
+    uint64 _hash(const Key& key) const
+    {
+        // Finalizer from MurmurHash3, spreads identity hashes (ints, Name_Id) across both fragments
+        uint64 hash = static_cast<uint64>(_hash_function(key));
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    static int64 _h1(uint64 hash) { return static_cast<int64>(hash >> 7); }
+    static int8 _h2(uint64 hash) { return static_cast<int8>(hash & 0x7F); }
+
+    static int64 _max_load(int64 capacity) { return capacity - capacity / 8; }
+
+    static int64 _normalize_capacity(int64 capacity)
+    {
+        constexpr int64 group_width = Flat_Hash_Map_Control::group_width;
+        return capacity <= group_width ? group_width : static_cast<int64>(std::bit_ceil(static_cast<uint64>(capacity)));
+    }
+
+    int64 _group_mask() const { return _capacity / Flat_Hash_Map_Control::group_width - 1; }
+
+    int64 _find_index(const Key& key, uint64 hash) const
+    {
+        constexpr int64 group_width = Flat_Hash_Map_Control::group_width;
+
+        if (_capacity == 0)
+        {
+            return -1;
+        }
+
+        const int8 h2 = _h2(hash);
+        const int64 group_mask = _group_mask();
+        int64 group = _h1(hash) & group_mask;
+
+        // Triangular probing over a power of two group count visits every group once
+        for (int64 step = 1; step <= group_mask + 1; ++step)
+        {
+            const int64 group_start = group * group_width;
+            const Flat_Hash_Map_Group control(_control + group_start);
+
+            for (uint32 mask = control.match(h2); mask != 0; mask &= mask - 1)
+            {
+                const int64 index = group_start + std::countr_zero(mask);
+                if (_slots[index].a == key)
+                {
+                    return index;
+                }
+            }
+
+            if (control.match_empty() != 0)
+            {
+                return -1;
+            }
+
+            group = (group + step) & group_mask;
+        }
+
+        return -1; // sentinel value for not found
+    }
+
+    int64 _find_insert_index(uint64 hash) const
+    {
+        constexpr int64 group_width = Flat_Hash_Map_Control::group_width;
+
+        const int64 group_mask = _group_mask();
+        int64 group = _h1(hash) & group_mask;
+
+        for (int64 step = 1; step <= group_mask + 1; ++step)
+        {
+            const int64 group_start = group * group_width;
+            const uint32 mask = Flat_Hash_Map_Group(_control + group_start).match_empty_or_deleted();
+            if (mask != 0)
+            {
+                return group_start + std::countr_zero(mask);
+            }
+
+            group = (group + step) & group_mask;
+        }
+
+        assert(false);
+        return -1;
+    }
+
+    // Claims a control byte for a key that is known not to be in the map
+    int64 _prepare_insert(uint64 hash)
+    {
+        if (_capacity == 0)
+        {
+            _resize(Flat_Hash_Map_Control::group_width * 2);
+        }
+
+        int64 index = _find_insert_index(hash);
+        if (_growth_left == 0 && _control[index] != Flat_Hash_Map_Control::Deleted)
+        {
+            _rehash_and_grow_if_necessary();
+            index = _find_insert_index(hash);
+        }
+
+        if (_control[index] == Flat_Hash_Map_Control::Empty)
+        {
+            --_growth_left;
+        }
+
+        _control[index] = _h2(hash);
+        ++_size;
+
+        return index;
+    }
+
+    void _rehash_and_grow_if_necessary()
+    {
+        // Mostly tombstones - clean them up without growing the table
+        if (_capacity > Flat_Hash_Map_Control::group_width && _size * 32 <= _capacity * 25)
+        {
+            _drop_deleted_without_resize();
+        }
+        else
+        {
+            _resize(_capacity * 2);
+        }
+    }
+
+    void _drop_deleted_without_resize()
+    {
+        constexpr int64 group_width = Flat_Hash_Map_Control::group_width;
+
+        // Tombstones become empty, full slots are marked deleted until they are placed again
+        for (int64 i = 0; i < _capacity; ++i)
+        {
+            _control[i] = _control[i] >= 0 ? Flat_Hash_Map_Control::Deleted : Flat_Hash_Map_Control::Empty;
+        }
+
+        for (int64 i = 0; i < _capacity; ++i)
+        {
+            if (_control[i] != Flat_Hash_Map_Control::Deleted)
+            {
+                continue;
+            }
+
+            const uint64 hash = _hash(_slots[i].a);
+            const int64 target = _find_insert_index(hash);
+
+            // Already sits in the first group its probe would pick
+            if (target / group_width == i / group_width)
+            {
+                _control[i] = _h2(hash);
+                continue;
+            }
+
+            if (_control[target] == Flat_Hash_Map_Control::Empty)
+            {
+                new (_slots + target) Slot(std::move(_slots[i]));
+                _slots[i].~Slot();
+                _control[target] = _h2(hash);
+                _control[i] = Flat_Hash_Map_Control::Empty;
+            }
+            else
+            {
+                // Target holds another element that wasn't placed yet, swap and process slot i again
+                Slot temp(std::move(_slots[i]));
+                _slots[i] = std::move(_slots[target]);
+                _slots[target] = std::move(temp);
+                _control[target] = _h2(hash);
+                --i;
+            }
+        }
+
+        _growth_left = _max_load(_capacity) - _size;
+    }
+
+    void _resize(int64 new_capacity)
+    {
+        int8* old_control = _control;
+        Slot* old_slots = _slots;
+        const int64 old_capacity = _capacity;
+
+        _allocate(new_capacity);
+
+        for (int64 i = 0; i < old_capacity; ++i)
+        {
+            if (old_control[i] < 0)
+            {
+                continue;
+            }
+
+            const uint64 hash = _hash(old_slots[i].a);
+            const int64 index = _find_insert_index(hash);
+            _control[index] = _h2(hash);
+            new (_slots + index) Slot(std::move(old_slots[i]));
+            old_slots[i].~Slot();
+        }
+
+        _growth_left -= _size;
+        _deallocate(old_control, old_slots, old_capacity);
+    }
+
+    void _allocate(int64 capacity)
+    {
+        Control_Allocator control_allocator(_allocator);
+
+        _control = Container_Memory::allocate(control_allocator, capacity, Container_Family::Flat_Hash_Map);
+        _slots = Container_Memory::allocate(_allocator, capacity, Container_Family::Flat_Hash_Map);
+        _capacity = capacity;
+        _growth_left = _max_load(capacity);
+        memset(_control, Flat_Hash_Map_Control::Empty, capacity);
+    }
+
+    void _deallocate(int8* control, Slot* slots, int64 capacity)
+    {
+        if (capacity == 0)
+        {
+            return;
+        }
+
+        Control_Allocator control_allocator(_allocator);
+
+        Container_Memory::deallocate(control_allocator, control, capacity, Container_Family::Flat_Hash_Map);
+        Container_Memory::deallocate(_allocator, slots, capacity, Container_Family::Flat_Hash_Map);
+    }
+
+    void _destroy_slots()
+    {
+        if constexpr (!std::is_trivially_destructible_v<Slot>)
+        {
+            for (int64 i = 0; i < _capacity; ++i)
+            {
+                if (_control[i] >= 0)
+                {
+                    _slots[i].~Slot();
+                }
+            }
+        }
+    }
+
+    void _reset_empty()
+    {
+        _control = nullptr;
+        _slots = nullptr;
+        _capacity = 0;
+        _size = 0;
+        _growth_left = 0;
+    }
+
+    void _copy_from(const Flat_Hash_Map& other)
+    {
+        if (other._capacity == 0)
+        {
+            return;
+        }
+
+        _allocate(other._capacity);
+
+        // Same capacity and hash, so every element lands where it was (minus tombstones)
+        for (int64 i = 0; i < other._capacity; ++i)
+        {
+            if (other._control[i] < 0)
+            {
+                continue;
+            }
+
+            const uint64 hash = _hash(other._slots[i].a);
+            const int64 index = _find_insert_index(hash);
+            _control[index] = _h2(hash);
+            new (_slots + index) Slot(other._slots[i]);
+        }
+
+        _size = other._size;
+        _growth_left -= _size;
+    }
+
+    // Expects this map to be empty and deallocated, leaves other empty but allocated
+    void _move_elements_from(Flat_Hash_Map& other)
+    {
+        if (other._capacity == 0)
+        {
+            return;
+        }
+
+        _allocate(other._capacity);
+
+        for (int64 i = 0; i < other._capacity; ++i)
+        {
+            if (other._control[i] < 0)
+            {
+                continue;
+            }
+
+            const uint64 hash = _hash(other._slots[i].a);
+            const int64 index = _find_insert_index(hash);
+            _control[index] = _h2(hash);
+            new (_slots + index) Slot(std::move(other._slots[i]));
+        }
+
+        _size = other._size;
+        _growth_left -= _size;
+        other.clear();
+    }
+
+    void _steal_from(Flat_Hash_Map& other)
+    {
+        _control = other._control;
+        _slots = other._slots;
+        _capacity = other._capacity;
+        _size = other._size;
+        _growth_left = other._growth_left;
+        other._reset_empty();
+    }
+};
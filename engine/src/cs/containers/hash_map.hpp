@@ -2,7 +2,9 @@
 
 #include "cs/cs.hpp"
 #include "cs/containers/pair.hpp"
+#include "cs/memory/memory_stats.hpp"
 
+#include <memory>
 #include <functional>
 
 template<typename Key, typename Value>
@@ -77,48 +79,82 @@ private:
     }
 };
 
-template<typename Key, typename Value, typename Hash_Function = std::hash<Key>>
+// Allocator is rebound to the entry type, copies and moves follow its allocator_traits
+template<typename Key, typename Value, typename Hash_Function = std::hash<Key>, typename Allocator = std::allocator<Pair<Key, Value>>>
 class Hash_Map
 {
 public:
     using Entry = Hash_Map_Entry<Key, Value>;
     using Iterator = Hash_Map_Iterator<Key, Value>;
 
-    Hash_Map(int64 initial_capacity = 32)
-        : _capacity(initial_capacity), _size(0)
+private:
+    using Entry_Allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Entry>;
+    using Allocator_Traits = std::allocator_traits<Entry_Allocator>;
+
+public:
+    Hash_Map(int64 initial_capacity = 32, const Allocator& allocator = Allocator())
+        : _allocator(allocator)
     {
-        _entries = new Entry[_capacity];
+        _entries = _allocate_entries(initial_capacity);
+        _capacity = initial_capacity;
     }
 
     ~Hash_Map()
     { 
-        delete[] _entries;
+        _deallocate_entries(_entries, _capacity);
     }
 
     Hash_Map(const Hash_Map& other)
+        : _allocator(Allocator_Traits::select_on_container_copy_construction(other._allocator))
     {
-        _resize(other._capacity);
-        _size = 0;
+        _copy_from(other);
+    }
+
+    Hash_Map(Hash_Map&& other) noexcept
+        : _allocator(std::move(other._allocator))
+    {
+        _steal_from(other);
+    }
 
-        for (int64 i = 0; i < _capacity; ++i)
+    Hash_Map& operator=(const Hash_Map& other)
+    {
+        if (this != &other)
         {
-            if (other._entries[i].is_valid())
+            _deallocate_entries(_entries, _capacity);
+            _entries = nullptr;
+            _capacity = 0;
+            if constexpr (Allocator_Traits::propagate_on_container_copy_assignment::value)
             {
-                insert(other._entries[i].pair.a, other._entries[i].pair.b);
+                _allocator = other._allocator;
             }
+            _copy_from(other);
         }
+
+        return *this;
     }
 
-    Hash_Map& operator=(const Hash_Map& other)
+    Hash_Map& operator=(Hash_Map&& other) noexcept(Allocator_Traits::propagate_on_container_move_assignment::value || Allocator_Traits::is_always_equal::value)
     {
-        _resize(other._capacity);
-        _size = 0;
-
-        for (int64 i = 0; i < _capacity; ++i)
+        if (this != &other)
         {
-            if (other._entries[i].is_valid())
+            _deallocate_entries(_entries, _capacity);
+            _entries = nullptr;
+            _capacity = 0;
+
+            if constexpr (Allocator_Traits::propagate_on_container_move_assignment::value)
             {
-                insert(other._entries[i].pair.a, other._entries[i].pair.b);
+                _allocator = std::move(other._allocator);
+                _steal_from(other);
+            }
+            else if (_allocator == other._allocator)
+            {
+                _steal_from(other);
+            }
+            else
+            {
+                // Can't take memory owned by another allocator, copy the entries over
+                _copy_from(other);
+                other.clear();
             }
         }
 
@@ -144,7 +180,11 @@ public:
 
     Value* insert(const Key& key, const Value& value)
     {
-        if ((_size + 1.0) / _capacity > _max_load_factor) 
+        if (_capacity == 0)
+        {
+            _resize(32);
+        }
+        else if ((_size + 1.0) / _capacity > _max_load_factor) 
         {
             _resize(_capacity * 2);
         }
@@ -219,6 +259,7 @@ public:
 
     int64 get_size() const { return _size; }
     int64 get_capacity() const { return _capacity; }
+    Allocator get_allocator() const { return Allocator(_allocator); }
 
     Iterator begin() { return Iterator(_entries, 0, _capacity); }
     Iterator begin() const { return Iterator(_entries, 0, _capacity); }
@@ -226,10 +267,11 @@ public:
     Iterator end() const { return Iterator(_entries, _capacity, _capacity); }
 
 private:
-    Entry* _entries;
-    int64 _capacity, _size;
+    Entry* _entries { nullptr };
+    int64 _capacity { 0 }, _size { 0 };
     float _max_load_factor = 0.7f;
     Hash_Function _hash_function;
+    Entry_Allocator _allocator;
 
     int64 _probe_insert(const Key& key)
     {
@@ -247,6 +289,12 @@ private:
 
     int64 _probe_search(const Key& key) const
     {
+        // Moved from
+        if (_capacity == 0)
+        {
+            return -1;
+        }
+
         int64 idx = _hash_function(key) % _capacity;
         int64 start = idx;
 
@@ -269,7 +317,7 @@ private:
         Entry* old_entries = _entries;
         int64 old_capacity = _capacity;
 
-        _entries = new Entry[new_cap];
+        _entries = _allocate_entries(new_cap);
         _capacity = new_cap;
         _size = 0;
 
@@ -281,6 +329,58 @@ private:
             }
         }
 
-        delete[] old_entries;
+        _deallocate_entries(old_entries, old_capacity);
+    }
+
+    Entry* _allocate_entries(int64 count)
+    {
+        Entry* entries = Container_Memory::allocate(_allocator, count, Container_Family::Hash_Map);
+        for (int64 i = 0; i < count; ++i)
+        {
+            new (entries + i) Entry();
+        }
+        return entries;
+    }
+
+    void _deallocate_entries(Entry* entries, int64 count)
+    {
+        if (entries == nullptr)
+        {
+            return;
+        }
+
+        for (int64 i = 0; i < count; ++i)
+        {
+            entries[i].~Entry();
+        }
+        Container_Memory::deallocate(_allocator, entries, count, Container_Family::Hash_Map);
+    }
+
+    // Expects this map to be deallocated
+    void _copy_from(const Hash_Map& other)
+    {
+        _entries = _allocate_entries(other._capacity);
+        _capacity = other._capacity;
+        _size = 0;
+
+        for (int64 i = 0; i < other._capacity; ++i)
+        {
+            if (other._entries[i].is_valid())
+            {
+                insert(other._entries[i].pair.a, other._entries[i].pair.b);
+            }
+        }
+    }
+
+    // Expects this map to be deallocated
+    void _steal_from(Hash_Map& other)
+    {
+        _entries = other._entries;
+        _capacity = other._capacity;
+        _size = other._size;
+
+        other._entries = nullptr;
+        other._capacity = 0;
+        other._size = 0;
     }
 };
@@ -0,0 +1,188 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/containers/hierarchical_hash_grid.hpp"
+#include "cs/engine/profiling/profiler.hpp"
+
+#include <algorithm>
+
+Hierarchical_Hash_Grid::Hierarchical_Hash_Grid(float min_cell_size, int32 level_count, float level_ratio)
+    :_level_count(level_count)
+{
+    assert(level_count > 0 && level_count <= MAX_LEVELS);
+    assert(level_ratio > 1.0f);
+
+    float cell_size = min_cell_size;
+    for (int32 level = 0; level < _level_count; ++level)
+    {
+        _levels[level] = Spatial_Hash_Grid(cell_size);
+        cell_size *= level_ratio;
+    }
+}
+
+void Hierarchical_Hash_Grid::set_thread_pool(Thread_Pool* in_thread_pool)
+{
+    Broadphase::set_thread_pool(in_thread_pool);
+    for (int32 level = 0; level < MAX_LEVELS; ++level)
+    {
+        _levels[level].set_thread_pool(in_thread_pool);
+    }
+}
+
+void Hierarchical_Hash_Grid::update(uint32 in_id, const AABB& in_bounds)
+{
+    PROFILE_FUNCTION()
+
+    if (in_id >= _id_levels.size())
+    {
+        const int64 size = static_cast<int64>(in_id) + 1;
+        if (size > _id_levels.capacity())
+        {
+            _id_levels.reserve(size > _id_levels.capacity() * 2 ? size : _id_levels.capacity() * 2);
+        }
+        _id_levels.resize(size, invalid_level);
+    }
+
+    const int32 level = _pick_level(in_bounds);
+    const uint8 old_level = _id_levels[in_id];
+    if (old_level != invalid_level && old_level != level)
+    {
+        _levels[old_level].remove(in_id);
+    }
+
+    _id_levels[in_id] = static_cast<uint8>(level);
+    _levels[level].update(in_id, in_bounds);
+}
+
+void Hierarchical_Hash_Grid::remove(uint32 in_id)
+{
+    PROFILE_FUNCTION()
+
+    if (!contains(in_id))
+    {
+        return;
+    }
+
+    _levels[_id_levels[in_id]].remove(in_id);
+    _id_levels[in_id] = invalid_level;
+}
+
+void Hierarchical_Hash_Grid::clear()
+{
+    for (int32 level = 0; level < _level_count; ++level)
+    {
+        _levels[level].clear();
+    }
+    _id_levels.clear();
+}
+
+int32 Hierarchical_Hash_Grid::get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const
+{
+    PROFILE_FUNCTION()
+
+    const int64 previous_size = out_potential_colliders.size();
+
+    // Every id is in one level only, so the levels can't report the same id twice
+    for (int32 level = _level_count - 1; level >= 0; --level)
+    {
+        if (_levels[level].size() > 0)
+        {
+            _levels[level].get_potential_collisions(in_id, in_bounds, out_potential_colliders);
+        }
+    }
+
+    std::sort(out_potential_colliders.begin() + previous_size, out_potential_colliders.end());
+    return static_cast<int32>(out_potential_colliders.size() - previous_size);
+}
+
+int32 Hierarchical_Hash_Grid::raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_ids) const
+{
+    PROFILE_FUNCTION()
+
+    const int64 previous_size = out_ids.size();
+
+    for (int32 level = _level_count - 1; level >= 0; --level)
+    {
+        if (_levels[level].size() > 0)
+        {
+            _levels[level].raycast(origin, direction, max_distance, out_ids);
+        }
+    }
+
+    std::sort(out_ids.begin() + previous_size, out_ids.end());
+    return static_cast<int32>(out_ids.size() - previous_size);
+}
+
+void Hierarchical_Hash_Grid::find_pairs(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs)
+{
+    PROFILE_FUNCTION()
+
+    _pair_keys.clear();
+
+    for (int32 level = _level_count - 1; level >= 0; --level)
+    {
+        Spatial_Hash_Grid& grid = _levels[level];
+        if (grid.size() == 0)
+        {
+            continue;
+        }
+
+        // Pairs with both objects in this level, still cached per cell by the grid
+        grid.sweep_and_prune_cells(_level_pairs);
+        for (const Pair<uint32, uint32>& pair : _level_pairs)
+        {
+            _pair_keys.push_back(make_unordered_pair_key(pair.a, pair.b));
+        }
+
+        if (level == 0)
+        {
+            continue;
+        }
+
+        // Pairs with one object in a finer level. The finer object touches only a few of
+        // this level's cells, so it's the one doing the query
+        for (int64 id = 0; id < _id_levels.size(); ++id)
+        {
+            const uint8 id_level = _id_levels[id];
+            if (id_level == invalid_level || id_level >= level)
+            {
+                continue;
+            }
+
+            const uint32 finer_id = static_cast<uint32>(id);
+            _query_ids.clear();
+            grid.get_potential_collisions(finer_id, _levels[id_level].get_bounds(finer_id), _query_ids);
+            for (uint32 coarser_id : _query_ids)
+            {
+                _pair_keys.push_back(make_unordered_pair_key(finer_id, coarser_id));
+            }
+        }
+    }
+
+    // Every pair is found exactly once, sorting only makes the order match the uniform grid
+    std::sort(_pair_keys.begin(), _pair_keys.end());
+
+    out_potential_collision_pairs.clear();
+    out_potential_collision_pairs.reserve(_pair_keys.size());
+    for (uint64 pair_key : _pair_keys)
+    {
+        out_potential_collision_pairs.push_back(get_unordered_pair(pair_key));
+    }
+}
+
+int32 Hierarchical_Hash_Grid::_pick_level(const AABB& in_bounds) const
+{
+    const vec3 size = in_bounds.max - in_bounds.min;
+    const float extent = std::max(size.x, std::max(size.y, size.z));
+
+    // Anything bigger than the coarsest cells still goes there, it just spans a few of them
+    for (int32 level = 0; level < _level_count - 1; ++level)
+    {
+        if (extent <= _levels[level].get_cell_size())
+        {
+            return level;
+        }
+    }
+
+    return _level_count - 1;
+}
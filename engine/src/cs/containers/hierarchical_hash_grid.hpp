@@ -0,0 +1,73 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Stack of Spatial_Hash_Grids with growing cell sizes, for scenes mixing object sizes.
+// Every object lives in exactly one level, the finest one whose cells are at least as big
+// as its largest extent. A floor then covers a handful of coarse cells instead of thousands
+// of fine ones, and debris doesn't share its cells with it.
+// Pairs inside a level come from that level's grid, pairs across levels from querying the
+// coarser levels with the finer object's bounds. Levels are walked coarse to fine.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/math/math.hpp"
+#include "cs/containers/pair.hpp"
+#include "cs/containers/dynamic_array.hpp"
+#include "cs/containers/spatial_hash_grid.hpp"
+#include "cs/engine/physics/broadphase.hpp"
+
+class Hierarchical_Hash_Grid : public Broadphase
+{
+public:
+    static constexpr int32 MAX_LEVELS = 8;
+
+public:
+    // Level k has cells of min_cell_size * level_ratio^k
+    Hierarchical_Hash_Grid(float min_cell_size = 1.5f, int32 level_count = 5, float level_ratio = 4.0f);
+
+    Broadphase_Type::Type get_type() const override { return Broadphase_Type::Hierarchical_Grid; }
+
+    // The levels do the sweeping, they get the pool
+    void set_thread_pool(Thread_Pool* in_thread_pool) override;
+
+    void update(uint32 in_id, const AABB& in_bounds) override;
+    void remove(uint32 in_id) override;
+    void clear() override;
+
+    bool contains(uint32 in_id) const { return in_id < _id_levels.size() && _id_levels[in_id] != invalid_level; }
+    int32 get_level_count() const { return _level_count; }
+    // -1 if the id isn't in the grid
+    int32 get_level(uint32 in_id) const { return contains(in_id) ? _id_levels[in_id] : -1; }
+    const Spatial_Hash_Grid& get_level_grid(int32 level) const
+    {
+        assert(level >= 0 && level < _level_count);
+        return _levels[level];
+    }
+
+    // Appends every id overlapping in_bounds once, sorted, returns how many were added
+    int32 get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const override;
+
+    // Walks the cells along the ray in every level, appends everything in them once, sorted
+    int32 raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_ids) const override;
+
+    // Each overlapping pair once, smaller id first, sorted
+    void find_pairs(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs) override;
+
+private:
+    static constexpr uint8 invalid_level = 0xFF;
+
+    Spatial_Hash_Grid _levels[MAX_LEVELS];
+    int32 _level_count { 0 };
+
+    // Indexed by id
+    Dynamic_Array<uint8> _id_levels;
+
+    Dynamic_Array<Pair<uint32, uint32>> _level_pairs;
+    Dynamic_Array<uint32> _query_ids;
+    Dynamic_Array<uint64> _pair_keys;
+
+private:
+    int32 _pick_level(const AABB& in_bounds) const;
+};
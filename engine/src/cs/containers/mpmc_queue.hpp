@@ -0,0 +1,149 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Bounded lock free queue for any number of producers and consumers (Vyukov's design).
+// Every cell carries a sequence number telling whether it's ready to be written
+// or read for the current lap, so producers and consumers only contend on a
+// single CAS of their own cache line padded index.
+//
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "cs/cs.hpp"
+
+template<typename Type, int64 N>
+class MPMC_Queue
+{
+    static_assert(N > 1 && (N & (N - 1)) == 0, "MPMC_Queue size has to be a power of two");
+
+public:
+    MPMC_Queue()
+    {
+        for (int64 i = 0; i < N; ++i)
+        {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MPMC_Queue(const MPMC_Queue&) = delete;
+    MPMC_Queue& operator=(const MPMC_Queue&) = delete;
+
+    ~MPMC_Queue()
+    {
+        const uint64 tail = _tail.load(std::memory_order_acquire);
+        for (uint64 i = _head.load(std::memory_order_relaxed); i != tail; ++i)
+        {
+            _cells[i & (N - 1)].get()->~Type();
+        }
+    }
+
+    bool try_push(const Type& value)
+    {
+        return try_emplace(value);
+    }
+
+    bool try_push(Type&& value)
+    {
+        return try_emplace(std::move(value));
+    }
+
+    template<typename... Args>
+    bool try_emplace(Args&&... args)
+    {
+        Cell* cell;
+        uint64 position = _tail.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            cell = &_cells[position & (N - 1)];
+            const uint64 sequence = cell->sequence.load(std::memory_order_acquire);
+            const int64 difference = static_cast<int64>(sequence) - static_cast<int64>(position);
+
+            if (difference == 0)
+            {
+                // Cell is free for this lap, claim it
+                if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // Consumer hasn't freed the cell from the previous lap, full
+                return false;
+            }
+            else
+            {
+                position = _tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (cell->get()) Type(std::forward<Args>(args)...);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(Type& out_value)
+    {
+        Cell* cell;
+        uint64 position = _head.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            cell = &_cells[position & (N - 1)];
+            const uint64 sequence = cell->sequence.load(std::memory_order_acquire);
+            const int64 difference = static_cast<int64>(sequence) - static_cast<int64>(position + 1);
+
+            if (difference == 0)
+            {
+                if (_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // Producer hasn't written the cell yet, empty
+                return false;
+            }
+            else
+            {
+                position = _head.load(std::memory_order_relaxed);
+            }
+        }
+
+        Type* value = cell->get();
+        out_value = std::move(*value);
+        value->~Type();
+
+        // Free the cell for the producers' next lap
+        cell->sequence.store(position + N, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot, other threads can change it right after
+    int64 size() const
+    {
+        const int64 size = static_cast<int64>(_tail.load(std::memory_order_relaxed) - _head.load(std::memory_order_relaxed));
+        return size < 0 ? 0 : size;
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr int64 capacity() { return N; }
+
+private:
+    struct Cell
+    {
+        std::atomic<uint64> sequence;
+        alignas(Type) unsigned char storage[sizeof(Type)];
+
+        Type* get() { return reinterpret_cast<Type*>(storage); }
+    };
+
+    alignas(CS_CACHE_LINE_SIZE) std::atomic<uint64> _tail { 0 };
+    alignas(CS_CACHE_LINE_SIZE) std::atomic<uint64> _head { 0 };
+    alignas(CS_CACHE_LINE_SIZE) Cell _cells[N];
+};
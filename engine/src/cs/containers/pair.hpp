@@ -10,3 +10,14 @@ struct Pair
 
     inline bool operator==(const Pair& other) const { return a == other.a && b == other.b; }
 };
+
+// Same key for (a, b) and (b, a), smaller id in the high half so sorted keys are sorted by first id
+inline uint64 make_unordered_pair_key(uint32 a, uint32 b)
+{
+    return a < b ? (static_cast<uint64>(a) << 32) | b : (static_cast<uint64>(b) << 32) | a;
+}
+
+inline Pair<uint32, uint32> get_unordered_pair(uint64 key)
+{
+    return { static_cast<uint32>(key >> 32), static_cast<uint32>(key) };
+}
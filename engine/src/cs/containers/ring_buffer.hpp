@@ -0,0 +1,266 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Growable FIFO over a power of two circular buffer, single threaded.
+// push_back and pop_front are O(1), unlike Dynamic_Array::dequeue which shifts
+// the whole array. Grows by doubling and unwraps the elements into the new buffer.
+//
+
+#pragma once
+
+#include <memory>
+#include <utility>
+
+#include "cs/cs.hpp"
+#include "cs/containers/dynamic_array.hpp"
+#include "cs/memory/memory_stats.hpp"
+
+template<typename Type, typename Allocator = std::allocator<Type>>
+class Ring_Buffer
+{
+    using Allocator_Traits = std::allocator_traits<Allocator>;
+
+public:
+    Ring_Buffer() = default;
+
+    explicit Ring_Buffer(const Allocator& allocator)
+        : _allocator(allocator)
+    {
+    }
+
+    Ring_Buffer(int64 initial_capacity, const Allocator& allocator = Allocator())
+        : _allocator(allocator)
+    {
+        reserve(initial_capacity);
+    }
+
+    Ring_Buffer(const Ring_Buffer& other)
+        : _allocator(Allocator_Traits::select_on_container_copy_construction(other._allocator))
+    {
+        _copy_from(other);
+    }
+
+    Ring_Buffer(Ring_Buffer&& other) noexcept
+        : _allocator(std::move(other._allocator))
+    {
+        _steal_from(other);
+    }
+
+    Ring_Buffer& operator=(const Ring_Buffer& other)
+    {
+        if (this != &other)
+        {
+            clear();
+            if constexpr (Allocator_Traits::propagate_on_container_copy_assignment::value)
+            {
+                if (_allocator != other._allocator)
+                {
+                    _deallocate();
+                }
+                _allocator = other._allocator;
+            }
+            _copy_from(other);
+        }
+
+        return *this;
+    }
+
+    Ring_Buffer& operator=(Ring_Buffer&& other) noexcept(Allocator_Traits::propagate_on_container_move_assignment::value || Allocator_Traits::is_always_equal::value)
+    {
+        if (this != &other)
+        {
+            clear();
+            if constexpr (Allocator_Traits::propagate_on_container_move_assignment::value)
+            {
+                _deallocate();
+                _allocator = std::move(other._allocator);
+                _steal_from(other);
+            }
+            else if (_allocator == other._allocator)
+            {
+                _deallocate();
+                _steal_from(other);
+            }
+            else
+            {
+                // Can't take memory owned by another allocator, move the elements over
+                reserve(other._size);
+                while (!other.empty())
+                {
+                    push_back(other.pop_front());
+                }
+            }
+        }
+
+        return *this;
+    }
+
+    ~Ring_Buffer()
+    {
+        clear();
+        _deallocate();
+    }
+
+    void reserve(int64 new_capacity)
+    {
+        if (new_capacity <= _capacity)
+        {
+            return;
+        }
+
+        int64 capacity = _capacity == 0 ? 8 : _capacity;
+        while (capacity < new_capacity)
+        {
+            capacity *= 2;
+        }
+
+        _grow(capacity);
+    }
+
+    void push_back(const Type& value)
+    {
+        emplace_back(value);
+    }
+
+    void push_back(Type&& value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template<typename... Args>
+    Type& emplace_back(Args&&... args)
+    {
+        if (_size == _capacity)
+        {
+            // args could reference an element, construct it before the old buffer goes away
+            Type value(std::forward<Args>(args)...);
+            _grow(_capacity == 0 ? 8 : _capacity * 2);
+            return *new (_slot(_size++)) Type(std::move(value));
+        }
+
+        return *new (_slot(_size++)) Type(std::forward<Args>(args)...);
+    }
+
+    Type pop_front()
+    {
+        assert(_size > 0);
+        Type* front = _slot(0);
+        Type ret = std::move(*front);
+        front->~Type();
+
+        _head = (_head + 1) & (_capacity - 1);
+        --_size;
+        return ret;
+    }
+
+    void pop_back()
+    {
+        if (_size == 0) return;
+        _slot(_size - 1)->~Type();
+        --_size;
+    }
+
+    void clear()
+    {
+        for (int64 i = 0; i < _size; ++i)
+        {
+            _slot(i)->~Type();
+        }
+        _head = 0;
+        _size = 0;
+    }
+
+    // Same names as Dynamic_Array, so it can stand in for queue style uses
+    void enqueue(const Type& value) { push_back(value); }
+    void enqueue(Type&& value) { push_back(std::move(value)); }
+    Type dequeue() { return pop_front(); }
+
+    // Index 0 is the front
+    Type& operator[](int64 index)
+    {
+        assert(index >= 0 && index < _size);
+        return *_slot(index);
+    }
+
+    const Type& operator[](int64 index) const
+    {
+        assert(index >= 0 && index < _size);
+        return *_slot(index);
+    }
+
+    Type& front() { assert(_size > 0); return *_slot(0); }
+    const Type& front() const { assert(_size > 0); return *_slot(0); }
+
+    Type& back() { assert(_size > 0); return *_slot(_size - 1); }
+    const Type& back() const { assert(_size > 0); return *_slot(_size - 1); }
+
+    bool empty() const { return _size == 0; }
+    int64 size() const { return _size; }
+    int64 capacity() const { return _capacity; }
+    const Allocator& get_allocator() const { return _allocator; }
+
+private:
+    Type* _data { nullptr };
+    int64 _capacity { 0 }, _size { 0 }, _head { 0 };
+
+    Allocator _allocator;
+
+private:
+    Type* _slot(int64 index) const
+    {
+        return _data + ((_head + index) & (_capacity - 1));
+    }
+
+    void _grow(int64 new_capacity)
+    {
+        assert((new_capacity & (new_capacity - 1)) == 0);
+
+        Type* new_data = Container_Memory::allocate(_allocator, new_capacity, Container_Family::Ring_Buffer);
+
+        // Unwrap into [0, _size), the part after _head first
+        const int64 first_count = _capacity - _head < _size ? _capacity - _head : _size;
+        Array_Helpers::relocate(_data + _head, new_data, first_count);
+        Array_Helpers::relocate(_data, new_data + first_count, _size - first_count);
+
+        _deallocate();
+        _data = new_data;
+        _capacity = new_capacity;
+        _head = 0;
+    }
+
+    void _deallocate()
+    {
+        if (_data)
+        {
+            Container_Memory::deallocate(_allocator, _data, _capacity, Container_Family::Ring_Buffer);
+            _data = nullptr;
+            _capacity = 0;
+        }
+    }
+
+    // Expects this buffer to be empty
+    void _copy_from(const Ring_Buffer& other)
+    {
+        reserve(other._size);
+        for (int64 i = 0; i < other._size; ++i)
+        {
+            new (_data + i) Type(*other._slot(i));
+        }
+        _head = 0;
+        _size = other._size;
+    }
+
+    // Expects this buffer to be empty and deallocated
+    void _steal_from(Ring_Buffer& other)
+    {
+        _data = other._data;
+        _capacity = other._capacity;
+        _size = other._size;
+        _head = other._head;
+
+        other._data = nullptr;
+        other._capacity = 0;
+        other._size = 0;
+        other._head = 0;
+    }
+};
@@ -0,0 +1,208 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Dense array of values addressed through stable, generational handles.
+// Values stay packed so iterating is a plain array walk. Removing swaps the last
+// value into the hole and patches its slot, so other handles stay valid. Every slot
+// has a generation that's bumped on remove, so a handle to a removed value is
+// detected instead of silently pointing at whatever reused the slot.
+//
+
+#pragma once
+
+#include <memory>
+#include <cstdint>
+#include <utility>
+
+#include "cs/cs.hpp"
+#include "cs/containers/dynamic_array.hpp"
+
+template<typename Type>
+struct Slot_Map_Handle
+{
+    uint32 index { 0 };
+    // 0 is never handed out, so a default handle is invalid
+    uint32 generation { 0 };
+
+    // Only tells if the handle was ever set, use Slot_Map::contains to check it's still alive
+    bool is_valid() const { return generation != 0; }
+
+    bool operator==(const Slot_Map_Handle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Slot_Map_Handle& other) const { return !(*this == other); }
+};
+
+template<typename Type, typename Allocator = std::allocator<Type>>
+class Slot_Map
+{
+public:
+    using Handle = Slot_Map_Handle<Type>;
+
+public:
+    Slot_Map() = default;
+
+    explicit Slot_Map(const Allocator& allocator)
+        : _values(allocator),
+        _value_slots(Index_Allocator(allocator)),
+        _slots(Slot_Allocator(allocator))
+    {
+    }
+
+    void reserve(int64 capacity)
+    {
+        _values.reserve(capacity);
+        _value_slots.reserve(capacity);
+        _slots.reserve(capacity);
+    }
+
+    Handle insert(const Type& value)
+    {
+        return emplace(value);
+    }
+
+    Handle insert(Type&& value)
+    {
+        return emplace(std::move(value));
+    }
+
+    template<typename... Args>
+    Handle emplace(Args&&... args)
+    {
+        uint32 slot_index;
+        if (_free_head != invalid_index)
+        {
+            slot_index = _free_head;
+            _free_head = _slots[slot_index].index;
+        }
+        else
+        {
+            slot_index = static_cast<uint32>(_slots.size());
+            _slots.push_back({ 0, 1 });
+        }
+
+        Slot& slot = _slots[slot_index];
+        slot.index = static_cast<uint32>(_values.size());
+
+        _values.emplace_back(std::forward<Args>(args)...);
+        _value_slots.push_back(slot_index);
+
+        return { slot_index, slot.generation };
+    }
+
+    // Returns false if the handle was already stale
+    bool remove(const Handle& handle)
+    {
+        if (!contains(handle))
+        {
+            return false;
+        }
+
+        Slot& slot = _slots[handle.index];
+        const uint32 value_index = slot.index;
+        const uint32 last_index = static_cast<uint32>(_values.size() - 1);
+
+        // The last value moves into the hole, point its slot at the new position
+        if (value_index != last_index)
+        {
+            _slots[_value_slots[last_index]].index = value_index;
+        }
+        _values.swap_remove(value_index);
+        _value_slots.swap_remove(value_index);
+
+        slot.generation = slot.generation + 1 == 0 ? 1 : slot.generation + 1;
+        slot.index = _free_head;
+        _free_head = handle.index;
+
+        return true;
+    }
+
+    void clear()
+    {
+        for (uint32 value_slot : _value_slots)
+        {
+            Slot& slot = _slots[value_slot];
+            slot.generation = slot.generation + 1 == 0 ? 1 : slot.generation + 1;
+            slot.index = _free_head;
+            _free_head = value_slot;
+        }
+
+        _values.clear();
+        _value_slots.clear();
+    }
+
+    bool contains(const Handle& handle) const
+    {
+        return handle.generation != 0 && handle.index < _slots.size() && _slots[handle.index].generation == handle.generation;
+    }
+
+    // nullptr for stale handles
+    Type* find(const Handle& handle)
+    {
+        return contains(handle) ? &_values[_slots[handle.index].index] : nullptr;
+    }
+
+    const Type* find(const Handle& handle) const
+    {
+        return contains(handle) ? &_values[_slots[handle.index].index] : nullptr;
+    }
+
+    Type& operator[](const Handle& handle)
+    {
+        assert(contains(handle));
+        return _values[_slots[handle.index].index];
+    }
+
+    const Type& operator[](const Handle& handle) const
+    {
+        assert(contains(handle));
+        return _values[_slots[handle.index].index];
+    }
+
+    // Dense position of a value, only stable until the next remove
+    int64 get_index(const Handle& handle) const
+    {
+        assert(contains(handle));
+        return _slots[handle.index].index;
+    }
+
+    Handle get_handle(int64 index) const
+    {
+        assert(index >= 0 && index < _values.size());
+        const uint32 slot_index = _value_slots[index];
+        return { slot_index, _slots[slot_index].generation };
+    }
+
+    Type& get_at(int64 index) { return _values[index]; }
+    const Type& get_at(int64 index) const { return _values[index]; }
+
+    int64 size() const { return _values.size(); }
+    bool empty() const { return _values.size() == 0; }
+
+    Type* data() { return _values.begin(); }
+    const Type* data() const { return _values.begin(); }
+
+    // Iterates the values, in no particular order
+    Type* begin() { return _values.begin(); }
+    Type* end() { return _values.end(); }
+
+    const Type* begin() const { return _values.begin(); }
+    const Type* end() const { return _values.end(); }
+
+private:
+    struct Slot
+    {
+        // Position in _values while alive, next free slot while free
+        uint32 index;
+        uint32 generation;
+    };
+
+    using Index_Allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<uint32>;
+    using Slot_Allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<Slot>;
+
+    static constexpr uint32 invalid_index = UINT32_MAX;
+
+    Dynamic_Array<Type, Allocator> _values;
+    // Slot of each value, to patch it when the value moves on remove
+    Dynamic_Array<uint32, Index_Allocator> _value_slots;
+    Dynamic_Array<Slot, Slot_Allocator> _slots;
+    uint32 _free_head { invalid_index };
+};
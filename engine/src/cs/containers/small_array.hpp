@@ -0,0 +1,406 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Dynamic_Array with room for N elements inside the object itself.
+// Only spills to the heap once more than N elements are added, so short lists
+// (cell contents, task dependencies, event bindings) never touch the allocator.
+//
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <iterator>
+#include <initializer_list>
+
+#include "cs/cs.hpp"
+#include "cs/containers/dynamic_array.hpp"
+#include "cs/memory/memory_stats.hpp"
+
+template<typename Type, int64 N, typename Allocator = std::allocator<Type>>
+class Small_Array
+{
+    static_assert(N > 0, "Small_Array needs at least one inline element");
+
+    using Allocator_Traits = std::allocator_traits<Allocator>;
+
+public:
+    Small_Array() = default;
+
+    explicit Small_Array(const Allocator& allocator)
+        : _allocator(allocator)
+    {
+    }
+
+    Small_Array(std::initializer_list<Type> list, const Allocator& allocator = Allocator())
+        : _allocator(allocator)
+    {
+        reserve(list.size());
+        Array_Helpers::copy_construct(list.begin(), _data, list.size());
+        _size = list.size();
+    }
+
+    Small_Array(const Small_Array& other)
+        : _allocator(Allocator_Traits::select_on_container_copy_construction(other._allocator))
+    {
+        reserve(other.size());
+        Array_Helpers::copy_construct(other._data, _data, other._size);
+        _size = other._size;
+    }
+
+    Small_Array(Small_Array&& other) noexcept
+        : _allocator(std::move(other._allocator))
+    {
+        _move_from(other, true);
+    }
+
+    Small_Array& operator=(const Small_Array& other)
+    {
+        if (this != &other)
+        {
+            clear();
+            if constexpr (Allocator_Traits::propagate_on_container_copy_assignment::value)
+            {
+                if (_allocator != other._allocator)
+                {
+                    _release_heap();
+                }
+                _allocator = other._allocator;
+            }
+            reserve(other.size());
+            Array_Helpers::copy_construct(other._data, _data, other._size);
+            _size = other._size;
+        }
+
+        return *this;
+    }
+
+    Small_Array& operator=(Small_Array&& other) noexcept(Allocator_Traits::propagate_on_container_move_assignment::value || Allocator_Traits::is_always_equal::value)
+    {
+        if (this != &other)
+        {
+            clear();
+            if constexpr (Allocator_Traits::propagate_on_container_move_assignment::value)
+            {
+                _release_heap();
+                _allocator = std::move(other._allocator);
+                _move_from(other, true);
+            }
+            else if (_allocator == other._allocator)
+            {
+                _release_heap();
+                _move_from(other, true);
+            }
+            else
+            {
+                _move_from(other, false);
+            }
+        }
+
+        return *this;
+    }
+
+    ~Small_Array()
+    {
+        clear();
+        _release_heap();
+    }
+
+    void reserve(int64 new_size)
+    {
+        _increase_capacity(new_size);
+    }
+
+    // Default constructs new elements
+    void resize(int64 new_size)
+    {
+        _resize(new_size, [](Type* at) { new (at) Type(); });
+    }
+
+    void resize(int64 new_size, const Type& value)
+    {
+        // value could live inside this array
+        const Type copy(value);
+        _resize(new_size, [&copy](Type* at) { new (at) Type(copy); });
+    }
+
+    void push_back(const Type& value)
+    {
+        emplace_back(value);
+    }
+
+    void push_back(Type&& value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    template<typename... Args>
+    Type& emplace_back(Args&&... args)
+    {
+        if (_size == _capacity)
+        {
+            // Construct into the new storage first, args could reference elements of the old one
+            const int64 new_capacity = _capacity * 2;
+            Type* new_data = Container_Memory::allocate(_allocator, new_capacity, Container_Family::Small_Array);
+            new (new_data + _size) Type(std::forward<Args>(args)...);
+            Array_Helpers::relocate(_data, new_data, _size);
+
+            _release_heap();
+            _data = new_data;
+            _capacity = new_capacity;
+        }
+        else
+        {
+            new (_data + _size) Type(std::forward<Args>(args)...);
+        }
+
+        return _data[_size++];
+    }
+
+    void insert(int64 index, const Type& value)
+    {
+        _insert(index, Type(value));
+    }
+
+    void insert(int64 index, Type&& value)
+    {
+        _insert(index, Type(std::move(value)));
+    }
+
+    void clear()
+    {
+        Array_Helpers::destroy(_data, _size);
+        _size = 0;
+    }
+
+    void pop_back()
+    {
+        if (_size == 0) return;
+        _data[_size - 1].~Type();
+        --_size;
+    }
+
+    // Keeps order, O(n)
+    void erase(int64 index)
+    {
+        assert(index >= 0 && index < _size);
+        Array_Helpers::erase_shift(_data, _size, index);
+        --_size;
+    }
+
+    // Moves the last element into index, O(1) but doesn't keep order
+    void swap_remove(int64 index)
+    {
+        assert(index >= 0 && index < _size);
+        if (index != _size - 1)
+        {
+            _data[index] = std::move(_data[_size - 1]);
+        }
+        pop_back();
+    }
+
+    void enqueue(const Type& value)
+    {
+        push_back(value);
+    }
+
+    void enqueue(Type&& value)
+    {
+        push_back(std::move(value));
+    }
+
+    Type dequeue()
+    {
+        assert(_size > 0);
+        Type ret = std::move(_data[0]);
+        erase(0);
+        return ret;
+    }
+
+    Type& operator[](int64 index)
+    {
+        assert(_size > 0 && index >= 0 && index < _size);
+        return _data[index];
+    }
+
+    const Type& operator[](int64 index) const
+    {
+        assert(_size > 0 && index >= 0 && index < _size);
+        return _data[index];
+    }
+
+    int64 find_first(const Type& value) const
+    {
+        for (int64 i = 0; i < _size; ++i)
+        {
+            if (_data[i] == value)
+            {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    template<typename Predicate>
+    int64 find_if(Predicate predicate) const
+    {
+        for (int64 i = 0; i < _size; ++i)
+        {
+            if (predicate(_data[i]))
+            {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    template<typename Predicate>
+    bool erase_if(Predicate predicate)
+    {
+        for (int64 i = 0; i < _size; ++i)
+        {
+            if (predicate(_data[i]))
+            {
+                erase(i);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // Keeps order of the remaining elements, single pass
+    template<typename Predicate>
+    int64 erase_all_if(Predicate predicate)
+    {
+        const int64 new_size = Array_Helpers::erase_all_if(_data, _size, predicate);
+        const int64 count = _size - new_size;
+        _size = new_size;
+        return count;
+    }
+
+    int64 size() const { return _size; }
+    int64 size_in_bytes() const { return _size * sizeof(Type); }
+    int64 capacity() const { return _capacity; }
+    bool is_inline() const { return _data == _inline_data(); }
+    const Allocator& get_allocator() const { return _allocator; }
+
+    Type& front() { assert(_size > 0); return _data[0]; }
+    const Type& front() const { assert(_size > 0); return _data[0]; }
+
+    Type& back() { assert(_size > 0); return _data[_size - 1]; }
+    const Type& back() const { assert(_size > 0); return _data[_size - 1]; }
+
+    // Iterator support
+    Type* begin() { return _data; }
+    Type* end() { return _data + _size; }
+
+    const Type* begin() const { return _data; }
+    const Type* end() const { return _data + _size; }
+
+    const Type* cbegin() const { return _data; }
+    const Type* cend() const { return _data + _size; }
+
+    std::reverse_iterator<Type*> rbegin() { return std::reverse_iterator<Type*>(end()); }
+    std::reverse_iterator<Type*> rend() { return std::reverse_iterator<Type*>(begin()); }
+
+    std::reverse_iterator<const Type*> rbegin() const { return std::reverse_iterator<const Type*>(end()); }
+    std::reverse_iterator<const Type*> rend() const { return std::reverse_iterator<const Type*>(begin()); }
+
+    std::reverse_iterator<const Type*> crbegin() const { return std::reverse_iterator<const Type*>(cend()); }
+    std::reverse_iterator<const Type*> crend() const { return std::reverse_iterator<const Type*>(cbegin()); }
+
+private:
+    alignas(Type) unsigned char _inline_storage[sizeof(Type) * N];
+    Type* _data { _inline_data() };
+    int64 _capacity { N }, _size { 0 };
+
+    Allocator _allocator;
+
+private:
+    Type* _inline_data() { return reinterpret_cast<Type*>(_inline_storage); }
+    const Type* _inline_data() const { return reinterpret_cast<const Type*>(_inline_storage); }
+
+    void _increase_capacity(int64 new_capacity)
+    {
+        // No need to resize
+        if (new_capacity <= _capacity)
+        {
+            return;
+        }
+
+        Type* new_data = Container_Memory::allocate(_allocator, new_capacity, Container_Family::Small_Array);
+        Array_Helpers::relocate(_data, new_data, _size);
+
+        _release_heap();
+        _data = new_data;
+        _capacity = new_capacity;
+    }
+
+    void _release_heap()
+    {
+        if (!is_inline())
+        {
+            Container_Memory::deallocate(_allocator, _data, _capacity, Container_Family::Small_Array);
+            _data = _inline_data();
+            _capacity = N;
+        }
+    }
+
+    template<typename Construct>
+    void _resize(int64 new_size, Construct&& construct)
+    {
+        assert(new_size >= 0);
+
+        if (new_size < _size)
+        {
+            Array_Helpers::destroy(_data + new_size, _size - new_size);
+            _size = new_size;
+            return;
+        }
+
+        _increase_capacity(new_size);
+        for (; _size < new_size; ++_size)
+        {
+            construct(_data + _size);
+        }
+    }
+
+    void _insert(int64 index, Type&& value)
+    {
+        assert(index >= 0 && index <= _size);
+
+        if (_size == _capacity)
+        {
+            _increase_capacity(_capacity * 2);
+        }
+
+        Array_Helpers::insert_shift(_data, _size, index);
+        new (_data + index) Type(std::move(value));
+        ++_size;
+    }
+
+    // Expects this array to be empty, and inline when stealing.
+    // Other's heap buffer is only taken over when the allocators allow it
+    void _move_from(Small_Array& other, bool can_steal_heap)
+    {
+        if (other.is_inline() || !can_steal_heap)
+        {
+            reserve(other._size);
+            Array_Helpers::relocate(other._data, _data, other._size);
+            _size = other._size;
+        }
+        else
+        {
+            _data = other._data;
+            _capacity = other._capacity;
+            _size = other._size;
+            other._data = other._inline_data();
+            other._capacity = N;
+        }
+
+        other._size = 0;
+    }
+};
@@ -3,6 +3,7 @@
 
 #include "cs/containers/spatial_hash_grid.hpp"
 #include "cs/engine/profiling/profiler.hpp"
+#include "cs/engine/thread_pool.hpp"
 
 #include <algorithm>
 
@@ -10,169 +11,628 @@ Spatial_Hash_Grid::Spatial_Hash_Grid(float cell_size)
     :_cell_size(cell_size)
 {
     assert(fabs(_cell_size) > NEARLY_ZERO);
+    _inverse_cell_size = 1.0f / _cell_size;
 }
 
-void Spatial_Hash_Grid::add(const Name_Id& in_id, const AABB& in_bounds)
+template<typename Function>
+void Spatial_Hash_Grid::_parallel_for(int64 count, int64 min_chunk_size, const Function& function)
+{
+    if (_thread_pool == nullptr)
+    {
+        if (count > 0)
+        {
+            function(0, count, 0);
+        }
+        return;
+    }
+
+    _thread_pool->parallel_for(count, min_chunk_size, function);
+}
+
+bool Spatial_Hash_Grid::_intersects(uint32 a_id, uint32 b_id) const
+{
+    const vec3& a_min = _bounds_min[a_id];
+    const vec3& a_max = _bounds_max[a_id];
+    const vec3& b_min = _bounds_min[b_id];
+    const vec3& b_max = _bounds_max[b_id];
+
+    return a_min.x <= b_max.x && a_max.x >= b_min.x &&
+        a_min.y <= b_max.y && a_max.y >= b_min.y &&
+        a_min.z <= b_max.z && a_max.z >= b_min.z;
+}
+
+bool Spatial_Hash_Grid::_intersects(uint32 in_id, const AABB& in_bounds) const
+{
+    const vec3& a_min = _bounds_min[in_id];
+    const vec3& a_max = _bounds_max[in_id];
+
+    return a_min.x <= in_bounds.max.x && a_max.x >= in_bounds.min.x &&
+        a_min.y <= in_bounds.max.y && a_max.y >= in_bounds.min.y &&
+        a_min.z <= in_bounds.max.z && a_max.z >= in_bounds.min.z;
+}
+
+Spatial_Hash_Grid::Cell_Range Spatial_Hash_Grid::_get_cells_for_bounds(const AABB& in_bounds) const
+{
+    Cell_Range range;
+    range.min = {
+        static_cast<int32>(std::floor(in_bounds.min.x * _inverse_cell_size)),
+        static_cast<int32>(std::floor(in_bounds.min.y * _inverse_cell_size)),
+        static_cast<int32>(std::floor(in_bounds.min.z * _inverse_cell_size))
+    };
+
+    range.max = {
+        static_cast<int32>(std::floor(in_bounds.max.x * _inverse_cell_size)),
+        static_cast<int32>(std::floor(in_bounds.max.y * _inverse_cell_size)),
+        static_cast<int32>(std::floor(in_bounds.max.z * _inverse_cell_size))
+    };
+
+    return range;
+}
+
+uint64 Spatial_Hash_Grid::_cell_key(int32 x, int32 y, int32 z)
+{
+    // Coordinates are already in cells, 21 bits each covers +-1M cells per axis without collisions
+    constexpr uint64 mask = (1ull << 21) - 1;
+    return ((static_cast<uint64>(x) & mask) << 42) |
+        ((static_cast<uint64>(y) & mask) << 21) |
+        (static_cast<uint64>(z) & mask);
+}
+
+void Spatial_Hash_Grid::add(uint32 in_id, const AABB& in_bounds)
+{
+    PROFILE_FUNCTION()
+
+    if (contains(in_id))
+    {
+        return;
+    }
+
+    _ensure_id(in_id);
+    _insert(in_id, in_bounds, _get_cells_for_bounds(in_bounds));
+    _count++;
+}
+
+void Spatial_Hash_Grid::update(uint32 in_id, const AABB& in_bounds)
 {
     PROFILE_FUNCTION()
 
-    if (_id_to_hash.find(in_id) != _id_to_hash.end())
+    if (!contains(in_id))
+    {
+        add(in_id, in_bounds);
+        return;
+    }
+
+    // Static and sleeping bodies come through here every step with the same bounds
+    if (_has_same_bounds(in_id, in_bounds))
     {
         return;
     }
 
-    _bounds[in_id] = in_bounds;
+    _move(in_id, in_bounds, _get_cells_for_bounds(in_bounds));
+}
+
+void Spatial_Hash_Grid::update_all(const AABB* in_bounds, int64 count)
+{
+    PROFILE_FUNCTION()
 
-    ivec3 min, max;
-    _get_cells_for_bounds(in_bounds, min, max);
-    for (int32 x = min.x; x <= max.x; x++)
+    if (count == 0)
     {
-        for (int32 y = min.y; y <= max.y; y++)
+        return;
+    }
+
+    _ensure_id(static_cast<uint32>(count - 1));
+    _new_ranges.resize(count);
+    _update_kinds.resize(count);
+
+    // Comparing bounds and working out cells is per object, touching cells has to stay in order
+    _parallel_for(count, 256, [&](int64 begin, int64 end, int64){
+        for (int64 i = begin; i < end; ++i)
         {
-            for (int32 z = min.z; z <= max.z; z++)
+            const uint32 id = static_cast<uint32>(i);
+            if (!_is_present[id])
+            {
+                _update_kinds[i] = Update_Kind::Added;
+            }
+            else if (_has_same_bounds(id, in_bounds[i]))
+            {
+                _update_kinds[i] = Update_Kind::Unchanged;
+                continue;
+            }
+            else
             {
-                int32 hash = _hash(x, y, z);
+                _update_kinds[i] = Update_Kind::Moved;
+            }
+
+            _new_ranges[i] = _get_cells_for_bounds(in_bounds[i]);
+        }
+    });
 
-                Cell& cell = _cells[hash];
-                cell.dirty = true;
-                cell.object_ids.push_back(in_id);
-                _id_to_hash[in_id].push_back(hash);
-            }   
-        }   
+    for (int64 i = 0; i < count; ++i)
+    {
+        const uint32 id = static_cast<uint32>(i);
+        switch (_update_kinds[i])
+        {
+        case Update_Kind::Added:
+            _insert(id, in_bounds[i], _new_ranges[i]);
+            _count++;
+            break;
+        case Update_Kind::Moved:
+            _move(id, in_bounds[i], _new_ranges[i]);
+            break;
+        default:
+            break;
+        }
     }
 }
 
-void Spatial_Hash_Grid::update(const Name_Id& in_id, const AABB& in_bounds)
+bool Spatial_Hash_Grid::_has_same_bounds(uint32 in_id, const AABB& in_bounds) const
+{
+    const vec3& bounds_min = _bounds_min[in_id];
+    const vec3& bounds_max = _bounds_max[in_id];
+    return bounds_min.x == in_bounds.min.x && bounds_min.y == in_bounds.min.y && bounds_min.z == in_bounds.min.z &&
+        bounds_max.x == in_bounds.max.x && bounds_max.y == in_bounds.max.y && bounds_max.z == in_bounds.max.z;
+}
+
+void Spatial_Hash_Grid::_move(uint32 in_id, const AABB& in_bounds, const Cell_Range& new_range)
+{
+    _bounds_min[in_id] = in_bounds.min;
+    _bounds_max[in_id] = in_bounds.max;
+
+    const Cell_Range old_range = _cell_ranges[in_id];
+    _cell_ranges[in_id] = new_range;
+
+    if (!(old_range == new_range))
+    {
+        _grow_occupied_range(new_range);
+
+        for (int32 x = old_range.min.x; x <= old_range.max.x; x++)
+        {
+            for (int32 y = old_range.min.y; y <= old_range.max.y; y++)
+            {
+                for (int32 z = old_range.min.z; z <= old_range.max.z; z++)
+                {
+                    if (!new_range.contains(x, y, z))
+                    {
+                        _remove_from_cell(in_id, _cell_key(x, y, z));
+                    }
+                }
+            }
+        }
+    }
+
+    // Cells it stays in still need a re-sweep, the bounds moved even if the cells didn't
+    for (int32 x = new_range.min.x; x <= new_range.max.x; x++)
+    {
+        for (int32 y = new_range.min.y; y <= new_range.max.y; y++)
+        {
+            for (int32 z = new_range.min.z; z <= new_range.max.z; z++)
+            {
+                const uint64 key = _cell_key(x, y, z);
+                if (old_range.contains(x, y, z))
+                {
+                    Cell* cell = _cells.find(key);
+                    assert(cell);
+                    cell->dirty = true;
+                }
+                else
+                {
+                    _add_to_cell(in_id, key);
+                }
+            }
+        }
+    }
+}
+
+void Spatial_Hash_Grid::remove(uint32 in_id)
 {
     PROFILE_FUNCTION()
-    
-    if (_id_to_hash.find(in_id) != _id_to_hash.end())
+
+    if (!contains(in_id))
     {
-        Dynamic_Array<int32>& previous_hashes = _id_to_hash[in_id];
-        for (int32 hash : previous_hashes)
+        return;
+    }
+
+    _remove_from_cells(in_id);
+    _is_present[in_id] = 0;
+    _count--;
+}
+
+void Spatial_Hash_Grid::clear()
+{
+    _bounds_min.clear();
+    _bounds_max.clear();
+    _cell_ranges.clear();
+    _is_present.clear();
+    _cells.clear();
+    _occupied_range = { ivec3(INT32_MAX), ivec3(INT32_MIN) };
+    _count = 0;
+}
+
+void Spatial_Hash_Grid::_ensure_id(uint32 in_id)
+{
+    if (in_id < _is_present.size())
+    {
+        return;
+    }
+
+    // Ids usually arrive one at a time, grow like push_back would instead of by one
+    const int64 size = static_cast<int64>(in_id) + 1;
+    if (size > _is_present.capacity())
+    {
+        const int64 capacity = size > _is_present.capacity() * 2 ? size : _is_present.capacity() * 2;
+        _bounds_min.reserve(capacity);
+        _bounds_max.reserve(capacity);
+        _cell_ranges.reserve(capacity);
+        _is_present.reserve(capacity);
+    }
+
+    _bounds_min.resize(size);
+    _bounds_max.resize(size);
+    _cell_ranges.resize(size);
+    _is_present.resize(size, 0);
+}
+
+void Spatial_Hash_Grid::_insert(uint32 in_id, const AABB& in_bounds, const Cell_Range& range)
+{
+    _bounds_min[in_id] = in_bounds.min;
+    _bounds_max[in_id] = in_bounds.max;
+    _is_present[in_id] = 1;
+    _cell_ranges[in_id] = range;
+    _grow_occupied_range(range);
+
+    for (int32 x = range.min.x; x <= range.max.x; x++)
+    {
+        for (int32 y = range.min.y; y <= range.max.y; y++)
         {
-            Cell& cell = _cells.at(hash);
-            cell.dirty = true;
-            cell.object_ids.erase_if([in_id](const Name_Id& value){ return value == in_id; });
+            for (int32 z = range.min.z; z <= range.max.z; z++)
+            {
+                _add_to_cell(in_id, _cell_key(x, y, z));
+            }
         }
-        _id_to_hash.erase(in_id);
     }
+}
 
-    add(in_id, in_bounds);
+void Spatial_Hash_Grid::_grow_occupied_range(const Cell_Range& range)
+{
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+        _occupied_range.min.data[axis] = std::min(_occupied_range.min.data[axis], range.min.data[axis]);
+        _occupied_range.max.data[axis] = std::max(_occupied_range.max.data[axis], range.max.data[axis]);
+    }
 }
 
-int32 Spatial_Hash_Grid::get_potential_collisions(const Name_Id& in_id, const AABB& in_bounds, Dynamic_Array<Name_Id>& out_potential_colliders)
+void Spatial_Hash_Grid::_remove_from_cells(uint32 in_id)
+{
+    // The cached range says exactly which cells hold the id
+    const Cell_Range& range = _cell_ranges[in_id];
+    for (int32 x = range.min.x; x <= range.max.x; x++)
+    {
+        for (int32 y = range.min.y; y <= range.max.y; y++)
+        {
+            for (int32 z = range.min.z; z <= range.max.z; z++)
+            {
+                _remove_from_cell(in_id, _cell_key(x, y, z));
+            }
+        }
+    }
+}
+
+void Spatial_Hash_Grid::_add_to_cell(uint32 in_id, uint64 key)
+{
+    Cell& cell = _cells.find_or_add(key);
+    cell.dirty = true;
+    cell.object_ids.push_back(in_id);
+}
+
+void Spatial_Hash_Grid::_remove_from_cell(uint32 in_id, uint64 key)
+{
+    Cell* cell = _cells.find(key);
+    assert(cell);
+
+    const int64 index = cell->object_ids.find_first(in_id);
+    assert(index != -1);
+    cell->object_ids.swap_remove(index);
+    cell->dirty = true;
+
+    // Keep the table to occupied cells, so sweeping doesn't visit everywhere something once was
+    if (cell->object_ids.size() == 0)
+    {
+        _cells.erase(key);
+    }
+}
+
+int32 Spatial_Hash_Grid::get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const
 {
     PROFILE_FUNCTION()
 
-    int32 count = 0;
+    const int64 previous_size = out_potential_colliders.size();
 
-    ivec3 min, max;
-    _get_cells_for_bounds(in_bounds, min, max);
+    const Cell_Range range = _get_cells_for_bounds(in_bounds);
 
-    for (int32 x = min.x - 1; x <= max.x + 1; x++)
+    // Objects are in every cell they touch, so the cells in_bounds touches are enough
+    for (int32 x = range.min.x; x <= range.max.x; x++)
     {
-        for (int32 y = min.y - 1; y <= max.y + 1; y++)
+        for (int32 y = range.min.y; y <= range.max.y; y++)
         {
-            for (int32 z = min.z - 1; z <= max.z + 1; z++)
+            for (int32 z = range.min.z; z <= range.max.z; z++)
             {
-                int32 hash = _hash(x, y, z);
-                if (_cells.find(hash) == _cells.end())
+                const Cell* cell = _cells.find(_cell_key(x, y, z));
+                if (cell == nullptr)
                 {
                     continue;
                 }
 
-                for (const Name_Id& id : _cells[hash].object_ids)
+                for (uint32 id : cell->object_ids)
                 {
-                    if (id == in_id || !_check_aabb_intersection(in_id, id))
-                    {
-                        continue;
-                    }
-
-                    if (out_potential_colliders.find_first(id) == -1)
+                    // Same inclusive test as the sweep, AABB::intersects misses boxes resting on each other
+                    if (id != in_id && _intersects(id, in_bounds))
                     {
                         out_potential_colliders.push_back(id);
                     }
-                    count++;
                 }
-            }   
-        }   
+            }
+        }
     }
 
-    return count;
+    // Objects spanning several cells show up once per cell, drop the repeats in one pass
+    // instead of searching the array for every hit
+    uint32* new_begin = out_potential_colliders.begin() + previous_size;
+    std::sort(new_begin, out_potential_colliders.end());
+    const uint32* new_end = std::unique(new_begin, out_potential_colliders.end());
+
+    out_potential_colliders.resize(new_end - out_potential_colliders.begin());
+    return static_cast<int32>(out_potential_colliders.size() - previous_size);
 }
 
-void Spatial_Hash_Grid::sweep_and_prune_cells(Dynamic_Array<Pair<Name_Id, Name_Id>>& out_potential_collision_pairs)
+int32 Spatial_Hash_Grid::raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_ids) const
 {
     PROFILE_FUNCTION()
 
-    //TODO: remove only unchanged ones
-    out_potential_collision_pairs.clear();
-    for (auto& [id, cell] : _cells)
+    const int64 previous_size = out_ids.size();
+    if (_count == 0)
     {
-        std::sort(cell.object_ids.begin(), cell.object_ids.end(), [&](const Name_Id& a, const Name_Id& b){
-            return _bounds[a].min.x < _bounds[b].min.x;
-        });
+        return 0;
+    }
 
-        for (int32 ai = 0; ai < cell.object_ids.size(); ++ai)
+    // The hashed cells go on forever, so the ray is clipped to the occupied ones first
+    float t_enter = 0.0f;
+    float t_exit = max_distance;
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+        const float occupied_min = _occupied_range.min.data[axis] * _cell_size;
+        const float occupied_max = (_occupied_range.max.data[axis] + 1) * _cell_size;
+        if (direction[axis] == 0.0f)
         {
-            const Name_Id& a = cell.object_ids[ai];
-            const AABB& bounds_a = _bounds[a];
-            for (int32 bi = ai + 1; bi < cell.object_ids.size(); ++bi)
+            if (origin[axis] < occupied_min || origin[axis] > occupied_max)
             {
-                const Name_Id& b = cell.object_ids[bi];
-                if (a == b)
-                {
-                    continue;
-                }
+                return 0;
+            }
+            continue;
+        }
 
-                const AABB& bounds_b = _bounds[b];
+        const float inverse_direction = 1.0f / direction[axis];
+        const float t_a = (occupied_min - origin[axis]) * inverse_direction;
+        const float t_b = (occupied_max - origin[axis]) * inverse_direction;
+        t_enter = std::max(t_enter, std::min(t_a, t_b));
+        t_exit = std::min(t_exit, std::max(t_a, t_b));
+    }
 
-                if (bounds_b.min.x > bounds_a.max.x)
-                {
-                    break;
-                }
+    if (t_enter > t_exit)
+    {
+        return 0;
+    }
 
-                if (bounds_a.intersects(bounds_b))
-                {
-                    // Don't add already detected pairs
-                    Pair<Name_Id, Name_Id> pair(a, b);
-                    Pair<Name_Id, Name_Id> inverse_pair(b, a);
-                    if (out_potential_collision_pairs.find_first(pair) == -1 &&
-                    out_potential_collision_pairs.find_first(inverse_pair) == -1)
-                    {
-                        out_potential_collision_pairs.push_back(pair);
-                    }
-                }
+    // Amanatides-Woo: step into whichever neighbouring cell the ray reaches first
+    const vec3 start = origin + direction * t_enter;
+    int32 cell[3];
+    int32 step[3];
+    float t_next[3];
+    float t_delta[3];
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+        cell[axis] = clamp(static_cast<int32>(std::floor(start[axis] * _inverse_cell_size)),
+            _occupied_range.min.data[axis], _occupied_range.max.data[axis]);
+
+        if (direction[axis] > 0.0f)
+        {
+            step[axis] = 1;
+            t_next[axis] = ((cell[axis] + 1) * _cell_size - origin[axis]) / direction[axis];
+            t_delta[axis] = _cell_size / direction[axis];
+        }
+        else if (direction[axis] < 0.0f)
+        {
+            step[axis] = -1;
+            t_next[axis] = (cell[axis] * _cell_size - origin[axis]) / direction[axis];
+            t_delta[axis] = -_cell_size / direction[axis];
+        }
+        else
+        {
+            step[axis] = 0;
+            t_next[axis] = FLT_MAX;
+            t_delta[axis] = FLT_MAX;
+        }
+    }
+
+    while (true)
+    {
+        if (const Cell* found_cell = _cells.find(_cell_key(cell[0], cell[1], cell[2])))
+        {
+            for (uint32 id : found_cell->object_ids)
+            {
+                out_ids.push_back(id);
             }
         }
+
+        const int32 axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+        if (step[axis] == 0 || t_next[axis] > t_exit)
+        {
+            break;
+        }
+
+        cell[axis] += step[axis];
+        if (cell[axis] < _occupied_range.min.data[axis] || cell[axis] > _occupied_range.max.data[axis])
+        {
+            break;
+        }
+        t_next[axis] += t_delta[axis];
     }
+
+    uint32* new_begin = out_ids.begin() + previous_size;
+    std::sort(new_begin, out_ids.end());
+    const uint32* new_end = std::unique(new_begin, out_ids.end());
+
+    out_ids.resize(new_end - out_ids.begin());
+    return static_cast<int32>(out_ids.size() - previous_size);
 }
 
-bool Spatial_Hash_Grid::_check_aabb_intersection(const Name_Id& a_id, const Name_Id& b_id)
+void Spatial_Hash_Grid::sweep_and_prune_cells(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs)
 {
-    return _bounds[a_id].intersects(_bounds[b_id]);
+    PROFILE_FUNCTION()
+
+    // Nothing in a clean cell moved since last time, its pairs are still right
+    _dirty_cells.clear();
+    _pair_cells.clear();
+    for (auto& [key, cell] : _cells)
+    {
+        if (cell.dirty)
+        {
+            _dirty_cells.push_back(&cell);
+            cell.dirty = false;
+        }
+
+        if (cell.object_ids.size() > 1)
+        {
+            _pair_cells.push_back(&cell);
+        }
+    }
+
+    // Cells only write their own pairs, they can be swept in any order
+    const int64 sweep_chunk_count = _get_chunk_count(_dirty_cells.size(), 32);
+    if (_chunk_sort_keys.size() < sweep_chunk_count)
+    {
+        _chunk_sort_keys.resize(sweep_chunk_count);
+    }
+
+    _parallel_for(_dirty_cells.size(), 32, [&](int64 begin, int64 end, int64 chunk_index){
+        for (int64 i = begin; i < end; ++i)
+        {
+            _sweep_cell(*_dirty_cells[i], _chunk_sort_keys[chunk_index]);
+        }
+    });
+
+    // Pairs sharing several cells were found in each of them, sorting the canonical
+    // keys puts the repeats next to each other. Every chunk sorts its own share first
+    const int64 gather_chunk_count = _get_chunk_count(_pair_cells.size(), 64);
+    if (_chunk_pair_keys.size() < gather_chunk_count)
+    {
+        _chunk_pair_keys.resize(gather_chunk_count);
+    }
+
+    _parallel_for(_pair_cells.size(), 64, [&](int64 begin, int64 end, int64 chunk_index){
+        Dynamic_Array<uint64>& pair_keys = _chunk_pair_keys[chunk_index];
+        pair_keys.clear();
+        for (int64 i = begin; i < end; ++i)
+        {
+            for (uint64 pair_key : _pair_cells[i]->pairs)
+            {
+                pair_keys.push_back(pair_key);
+            }
+        }
+
+        std::sort(pair_keys.begin(), pair_keys.end());
+        pair_keys.resize(std::unique(pair_keys.begin(), pair_keys.end()) - pair_keys.begin());
+    });
+
+    // Chunk buffers go back to back in chunk order, then sorted runs are merged pairwise,
+    // the result is sorted whichever thread did what
+    _chunk_offsets.resize(gather_chunk_count + 1);
+    _chunk_offsets[0] = 0;
+    for (int64 chunk = 0; chunk < gather_chunk_count; ++chunk)
+    {
+        _chunk_offsets[chunk + 1] = _chunk_offsets[chunk] + _chunk_pair_keys[chunk].size();
+    }
+
+    _pair_keys.resize(_chunk_offsets[gather_chunk_count]);
+    for (int64 chunk = 0; chunk < gather_chunk_count; ++chunk)
+    {
+        std::copy(_chunk_pair_keys[chunk].begin(), _chunk_pair_keys[chunk].end(), _pair_keys.begin() + _chunk_offsets[chunk]);
+    }
+
+    for (int64 width = 1; width < gather_chunk_count; width *= 2)
+    {
+        const int64 merge_count = (gather_chunk_count + 2 * width - 1) / (2 * width);
+        _parallel_for(merge_count, 1, [&](int64 begin, int64 end, int64){
+            for (int64 merge = begin; merge < end; ++merge)
+            {
+                const int64 left = merge * 2 * width;
+                const int64 middle = std::min(left + width, gather_chunk_count);
+                const int64 right = std::min(left + 2 * width, gather_chunk_count);
+                if (middle < right)
+                {
+                    std::inplace_merge(_pair_keys.begin() + _chunk_offsets[left],
+                        _pair_keys.begin() + _chunk_offsets[middle],
+                        _pair_keys.begin() + _chunk_offsets[right]);
+                }
+            }
+        });
+    }
+
+    const int64 unique_count = std::unique(_pair_keys.begin(), _pair_keys.end()) - _pair_keys.begin();
+
+    out_potential_collision_pairs.clear();
+    out_potential_collision_pairs.reserve(unique_count);
+    for (int64 i = 0; i < unique_count; ++i)
+    {
+        out_potential_collision_pairs.push_back(get_unordered_pair(_pair_keys[i]));
+    }
 }
 
-void Spatial_Hash_Grid::_get_cells_for_bounds(const AABB& in_bounds, ivec3& out_min, ivec3& out_max) const 
+void Spatial_Hash_Grid::_sweep_cell(Cell& cell, Dynamic_Array<Sort_Key>& sort_keys) const
 {
-    out_min = { 
-        static_cast<int32>(std::floor(in_bounds.min.x / _cell_size)),
-        static_cast<int32>(std::floor(in_bounds.min.y / _cell_size)),
-        static_cast<int32>(std::floor(in_bounds.min.z / _cell_size))
-    };
+    cell.pairs.clear();
 
-    out_max = { 
-        static_cast<int32>(std::floor(in_bounds.max.x / _cell_size)),
-        static_cast<int32>(std::floor(in_bounds.max.y / _cell_size)),
-        static_cast<int32>(std::floor(in_bounds.max.z / _cell_size))
-    };
+    const int64 count = cell.object_ids.size();
+    if (count < 2)
+    {
+        return;
+    }
+
+    sort_keys.clear();
+    for (uint32 id : cell.object_ids)
+    {
+        sort_keys.push_back({ _bounds_min[id].x, id });
+    }
+
+    std::sort(sort_keys.begin(), sort_keys.end(), [](const Sort_Key& a, const Sort_Key& b){
+        return a.min_x < b.min_x;
+    });
+
+    for (int64 ai = 0; ai < count; ++ai)
+    {
+        const uint32 a = sort_keys[ai].id;
+        const float max_x = _bounds_max[a].x;
+        for (int64 bi = ai + 1; bi < count; ++bi)
+        {
+            if (sort_keys[bi].min_x > max_x)
+            {
+                break;
+            }
+
+            const uint32 b = sort_keys[bi].id;
+            if (_intersects(a, b))
+            {
+                cell.pairs.push_back(make_unordered_pair_key(a, b));
+            }
+        }
+    }
 }
 
-int32 Spatial_Hash_Grid::_hash(int32 x, int32 y, int32 z) const
+int64 Spatial_Hash_Grid::_get_chunk_count(int64 count, int64 min_chunk_size) const
 {
-    int32 _x = static_cast<int>(std::floor(x / _cell_size));
-    int32 _y = static_cast<int>(std::floor(y / _cell_size));
-    int32 _z = static_cast<int>(std::floor(z / _cell_size));
-    return (_x * 73856093) ^ (_y * 19349663) ^ (_z * 83492791);
+    if (_thread_pool == nullptr)
+    {
+        return count > 0 ? 1 : 0;
+    }
+
+    return _thread_pool->get_chunk_count(count, min_chunk_size);
 }
@@ -1,42 +1,148 @@
 // CS Engine
 // Author: matija.martinec@protonmail.com
+//
+// Uniform grid over hashed cells for the broadphase.
+// Objects are dense uint32 ids picked by the caller (the physics system uses body indices),
+// so their bounds and cell ranges live in flat arrays indexed by id. Cells are kept in one
+// open addressing table keyed by the packed cell coordinates.
+// Updates are incremental: unchanged bounds are skipped, and only cells an object
+// enters or leaves are touched. Every cell caches its overlapping pairs and only
+// re-sweeps once something in it moved.
+// With a thread pool set, update_all works out cell ranges and find_pairs sweeps cells on
+// the workers. Pairs are collected into per chunk buffers and merged into sorted order, so
+// the result is the same however the work was split.
+//
 
 #pragma once
 
 #include "cs/cs.hpp"
 #include "cs/math/math.hpp"
-#include "cs/name_id.hpp"
 #include "cs/containers/pair.hpp"
 #include "cs/containers/dynamic_array.hpp"
+#include "cs/containers/small_array.hpp"
+#include "cs/containers/flat_hash_map.hpp"
+#include "cs/engine/physics/broadphase.hpp"
 
-#include <unordered_map>
-
-class Spatial_Hash_Grid
+class Spatial_Hash_Grid : public Broadphase
 {
 public:
     struct Cell
     {
-        bool dirty { false };
-        Dynamic_Array<Name_Id> object_ids;
+        // Set when an object entered, left or moved inside, pairs is stale until the next sweep
+        bool dirty { true };
+        Small_Array<uint32, 8> object_ids;
+        // make_unordered_pair_key of every overlapping pair in the cell
+        Dynamic_Array<uint64> pairs;
     };
 
 public:
     Spatial_Hash_Grid() = default;
     Spatial_Hash_Grid(float cell_size);
-    void add(const Name_Id& in_id, const AABB& in_bounds);
-    void update(const Name_Id& in_id, const AABB& in_bounds);
-    int32 get_potential_collisions(const Name_Id& in_id, const AABB& in_bounds, Dynamic_Array<Name_Id>& out_potential_colliders);
+    Broadphase_Type::Type get_type() const override { return Broadphase_Type::Uniform_Grid; }
+
+    void add(uint32 in_id, const AABB& in_bounds);
+    void update(uint32 in_id, const AABB& in_bounds) override;
+    void update_all(const AABB* in_bounds, int64 count) override;
+    void remove(uint32 in_id) override;
+    void clear() override;
+
+    bool contains(uint32 in_id) const { return in_id < _is_present.size() && _is_present[in_id]; }
+    int64 size() const { return _count; }
+    float get_cell_size() const { return _cell_size; }
+
+    AABB get_bounds(uint32 in_id) const
+    {
+        assert(contains(in_id));
+        return AABB(_bounds_min[in_id], _bounds_max[in_id]);
+    }
+
+    // Appends every id overlapping in_bounds once, sorted, returns how many were added.
+    // Doesn't look at what was in the array before
+    int32 get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const override;
 
-    void sweep_and_prune_cells(Dynamic_Array<Pair<Name_Id, Name_Id>>& out_potential_collision_pairs);
+    // Walks the cells along the ray, appends everything in them once, sorted
+    int32 raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_ids) const override;
+
+    // Each overlapping pair once, smaller id first, sorted
+    void sweep_and_prune_cells(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs);
+
+    void find_pairs(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs) override
+    {
+        sweep_and_prune_cells(out_potential_collision_pairs);
+    }
 
 private:
+    struct Cell_Range
+    {
+        ivec3 min, max;
+
+        bool contains(int32 x, int32 y, int32 z) const
+        {
+            return x >= min.x && x <= max.x && y >= min.y && y <= max.y && z >= min.z && z <= max.z;
+        }
+
+        bool operator==(const Cell_Range& other) const
+        {
+            return min.x == other.min.x && min.y == other.min.y && min.z == other.min.z &&
+                max.x == other.max.x && max.y == other.max.y && max.z == other.max.z;
+        }
+    };
+
+    // Copied out of the bounds so sorting a cell doesn't chase ids
+    struct Sort_Key
+    {
+        float min_x;
+        uint32 id;
+    };
+
+    enum Update_Kind : uint8
+    {
+        Unchanged,
+        Moved,
+        Added
+    };
+
     float _cell_size { 5.0f };
-    std::unordered_map<uint32, Dynamic_Array<int32>> _id_to_hash;
-    std::unordered_map<uint32, AABB> _bounds;
-    std::unordered_map<int32, Cell> _cells;
+    float _inverse_cell_size { 1.0f / 5.0f };
+
+    // Indexed by id
+    Dynamic_Array<vec3> _bounds_min;
+    Dynamic_Array<vec3> _bounds_max;
+    Dynamic_Array<Cell_Range> _cell_ranges;
+    Dynamic_Array<uint8> _is_present;
+    int64 _count { 0 };
+
+    Flat_Hash_Map<uint64, Cell> _cells;
+    // Every cell anything was put in since the last clear, raycasts don't walk past it.
+    // Only grows, an object leaving doesn't shrink it
+    Cell_Range _occupied_range { ivec3(INT32_MAX), ivec3(INT32_MIN) };
+
+    // Scratch kept between steps
+    Dynamic_Array<Cell_Range> _new_ranges;
+    Dynamic_Array<uint8> _update_kinds;
+    Dynamic_Array<Cell*> _dirty_cells;
+    Dynamic_Array<const Cell*> _pair_cells;
+    Dynamic_Array<Dynamic_Array<Sort_Key>> _chunk_sort_keys;
+    Dynamic_Array<Dynamic_Array<uint64>> _chunk_pair_keys;
+    Dynamic_Array<int64> _chunk_offsets;
+    Dynamic_Array<uint64> _pair_keys;
 
 private:
-    bool _check_aabb_intersection(const Name_Id& a_id, const Name_Id& b_id);
-    void _get_cells_for_bounds(const AABB& in_bounds, ivec3& out_min, ivec3& out_max) const;
-    int32 _hash(int32 x, int32 y, int32 z) const;
+    void _ensure_id(uint32 in_id);
+    bool _has_same_bounds(uint32 in_id, const AABB& in_bounds) const;
+    void _insert(uint32 in_id, const AABB& in_bounds, const Cell_Range& range);
+    void _grow_occupied_range(const Cell_Range& range);
+    void _move(uint32 in_id, const AABB& in_bounds, const Cell_Range& new_range);
+    void _remove_from_cells(uint32 in_id);
+    void _add_to_cell(uint32 in_id, uint64 key);
+    void _remove_from_cell(uint32 in_id, uint64 key);
+    void _sweep_cell(Cell& cell, Dynamic_Array<Sort_Key>& sort_keys) const;
+    int64 _get_chunk_count(int64 count, int64 min_chunk_size) const;
+    // Runs on the thread pool if there is one, chunk indices are below _get_chunk_count
+    template<typename Function>
+    void _parallel_for(int64 count, int64 min_chunk_size, const Function& function);
+    bool _intersects(uint32 a_id, uint32 b_id) const;
+    bool _intersects(uint32 in_id, const AABB& in_bounds) const;
+    Cell_Range _get_cells_for_bounds(const AABB& in_bounds) const;
+    static uint64 _cell_key(int32 x, int32 y, int32 z);
 };
@@ -0,0 +1,117 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Bounded lock free queue for exactly one producer and one consumer thread.
+// Head and tail live on separate cache lines, and each side caches the other's
+// index so it only touches the shared line when the queue looks full/empty.
+//
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "cs/cs.hpp"
+
+template<typename Type, int64 N>
+class SPSC_Queue
+{
+    static_assert(N > 1 && (N & (N - 1)) == 0, "SPSC_Queue size has to be a power of two");
+
+public:
+    SPSC_Queue() = default;
+    SPSC_Queue(const SPSC_Queue&) = delete;
+    SPSC_Queue& operator=(const SPSC_Queue&) = delete;
+
+    ~SPSC_Queue()
+    {
+        const uint64 tail = _producer.tail.load(std::memory_order_acquire);
+        for (uint64 i = _consumer.head.load(std::memory_order_relaxed); i != tail; ++i)
+        {
+            _slot(i)->~Type();
+        }
+    }
+
+    // Producer thread only
+    bool try_push(const Type& value)
+    {
+        return try_emplace(value);
+    }
+
+    // Producer thread only
+    bool try_push(Type&& value)
+    {
+        return try_emplace(std::move(value));
+    }
+
+    // Producer thread only
+    template<typename... Args>
+    bool try_emplace(Args&&... args)
+    {
+        const uint64 tail = _producer.tail.load(std::memory_order_relaxed);
+        if (tail - _producer.cached_head == N)
+        {
+            _producer.cached_head = _consumer.head.load(std::memory_order_acquire);
+            if (tail - _producer.cached_head == N)
+            {
+                return false;
+            }
+        }
+
+        new (_slot(tail)) Type(std::forward<Args>(args)...);
+        _producer.tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool try_pop(Type& out_value)
+    {
+        const uint64 head = _consumer.head.load(std::memory_order_relaxed);
+        if (head == _consumer.cached_tail)
+        {
+            _consumer.cached_tail = _producer.tail.load(std::memory_order_acquire);
+            if (head == _consumer.cached_tail)
+            {
+                return false;
+            }
+        }
+
+        Type* slot = _slot(head);
+        out_value = std::move(*slot);
+        slot->~Type();
+        _consumer.head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a snapshot when called while the other side is running
+    int64 size() const
+    {
+        return static_cast<int64>(_producer.tail.load(std::memory_order_acquire) - _consumer.head.load(std::memory_order_acquire));
+    }
+
+    bool empty() const { return size() == 0; }
+    static constexpr int64 capacity() { return N; }
+
+private:
+    struct alignas(CS_CACHE_LINE_SIZE) Producer
+    {
+        std::atomic<uint64> tail { 0 };
+        uint64 cached_head { 0 };
+    };
+
+    struct alignas(CS_CACHE_LINE_SIZE) Consumer
+    {
+        std::atomic<uint64> head { 0 };
+        uint64 cached_tail { 0 };
+    };
+
+    Producer _producer;
+    Consumer _consumer;
+    alignas(CS_CACHE_LINE_SIZE) unsigned char _storage[sizeof(Type) * N];
+
+private:
+    Type* _slot(uint64 index)
+    {
+        return reinterpret_cast<Type*>(_storage) + (index & (N - 1));
+    }
+};
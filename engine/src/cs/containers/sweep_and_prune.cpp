@@ -0,0 +1,577 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/containers/sweep_and_prune.hpp"
+#include "cs/engine/profiling/profiler.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+    bool overlaps(const AABB& a, const AABB& b)
+    {
+        return a.min.x <= b.max.x && a.max.x >= b.min.x &&
+            a.min.y <= b.max.y && a.max.y >= b.min.y &&
+            a.min.z <= b.max.z && a.max.z >= b.min.z;
+    }
+
+    // Slab test, narrows [t_enter, t_exit] to the part of the ray inside bounds
+    bool clip_ray(const AABB& bounds, const vec3& origin, const vec3& inverse_direction, float& t_enter, float& t_exit)
+    {
+        for (int32 axis = 0; axis < 3; ++axis)
+        {
+            const float t_a = (bounds.min[axis] - origin[axis]) * inverse_direction[axis];
+            const float t_b = (bounds.max[axis] - origin[axis]) * inverse_direction[axis];
+            // NaN from a ray lying in a slab plane drops out of max/min this way round
+            t_enter = std::max(t_enter, std::min(t_a, t_b));
+            t_exit = std::min(t_exit, std::max(t_a, t_b));
+        }
+
+        return t_enter <= t_exit;
+    }
+}
+
+void Sweep_And_Prune::update(uint32 in_id, const AABB& in_bounds)
+{
+    PROFILE_FUNCTION()
+
+    _ensure_id(in_id);
+
+    _max_x_extent = std::max(_max_x_extent, in_bounds.max.x - in_bounds.min.x);
+
+    const uint8 state = _states[in_id];
+    if (state != State::Sorted)
+    {
+        if (state == State::Absent)
+        {
+            _states[in_id] = State::Pending;
+            _pending_ids.push_back(in_id);
+            _count++;
+        }
+
+        _bounds[in_id] = in_bounds;
+        return;
+    }
+
+    const AABB old_bounds = _bounds[in_id];
+    _bounds[in_id] = in_bounds;
+
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+        const float new_min = in_bounds.min[axis];
+        const float new_max = in_bounds.max[axis];
+        const float old_min = old_bounds.min[axis];
+        const float old_max = old_bounds.max[axis];
+
+        Dynamic_Array<Endpoint>& endpoints = _axes[axis];
+        endpoints[_proxies[in_id].min[axis]].value = new_min;
+        endpoints[_proxies[in_id].max[axis]].value = new_max;
+
+        // Grow first, then shrink, so the min never has to pass its own max
+        if (new_min < old_min)
+        {
+            _sort_min_down(axis, _proxies[in_id].min[axis]);
+        }
+
+        if (new_max > old_max)
+        {
+            _sort_max_up(axis, _proxies[in_id].max[axis]);
+        }
+
+        if (new_min > old_min)
+        {
+            _sort_min_up(axis, _proxies[in_id].min[axis]);
+        }
+
+        if (new_max < old_max)
+        {
+            _sort_max_down(axis, _proxies[in_id].max[axis]);
+        }
+    }
+}
+
+void Sweep_And_Prune::remove(uint32 in_id)
+{
+    PROFILE_FUNCTION()
+
+    if (!contains(in_id))
+    {
+        return;
+    }
+
+    _count--;
+
+    if (_states[in_id] == State::Pending)
+    {
+        _pending_ids.swap_remove(_pending_ids.find_first(in_id));
+        _states[in_id] = State::Absent;
+        return;
+    }
+
+    // Everything overlapping it on x starts before its max
+    const Proxy proxy = _proxies[in_id];
+    const Dynamic_Array<Endpoint>& x_endpoints = _axes[0];
+    for (uint32 index = 0; index < proxy.max[0]; ++index)
+    {
+        const Endpoint& endpoint = x_endpoints[index];
+        const uint32 other_id = endpoint.get_id();
+        if (endpoint.is_max() || other_id == in_id || _proxies[other_id].max[0] < proxy.min[0])
+        {
+            continue;
+        }
+
+        if (_overlaps_other_axes(0, in_id, other_id))
+        {
+            _raw_removed.push_back(make_unordered_pair_key(in_id, other_id));
+        }
+    }
+
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+        Dynamic_Array<Endpoint>& endpoints = _axes[axis];
+        uint32 write_index = proxy.min[axis];
+        for (uint32 read_index = proxy.min[axis]; read_index < endpoints.size(); ++read_index)
+        {
+            const Endpoint endpoint = endpoints[read_index];
+            if (endpoint.get_id() == in_id)
+            {
+                continue;
+            }
+
+            endpoints[write_index] = endpoint;
+            _set_endpoint_index(axis, endpoint, write_index);
+            write_index++;
+        }
+        endpoints.resize(write_index);
+    }
+
+    _states[in_id] = State::Absent;
+
+    // Settle the events now, something added under the same id later in the step is a new
+    // object, its pairs have to come after these removals instead of cancelling them
+    _fold_events();
+}
+
+void Sweep_And_Prune::clear()
+{
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+        _axes[axis].clear();
+    }
+
+    _proxies.clear();
+    _bounds.clear();
+    _states.clear();
+    _count = 0;
+    _max_x_extent = 0.0f;
+
+    _pending_ids.clear();
+    _raw_added.clear();
+    _raw_removed.clear();
+    _pair_keys.clear();
+    _pair_events.clear();
+    _pending_events.clear();
+}
+
+int32 Sweep_And_Prune::get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const
+{
+    PROFILE_FUNCTION()
+
+    const int64 previous_size = out_potential_colliders.size();
+
+    for (const Endpoint& endpoint : _axes[0])
+    {
+        if (endpoint.value > in_bounds.max.x)
+        {
+            break;
+        }
+
+        const uint32 id = endpoint.get_id();
+        if (!endpoint.is_max() && id != in_id && overlaps(_bounds[id], in_bounds))
+        {
+            out_potential_colliders.push_back(id);
+        }
+    }
+
+    for (uint32 id : _pending_ids)
+    {
+        if (id != in_id && overlaps(_bounds[id], in_bounds))
+        {
+            out_potential_colliders.push_back(id);
+        }
+    }
+
+    std::sort(out_potential_colliders.begin() + previous_size, out_potential_colliders.end());
+    return static_cast<int32>(out_potential_colliders.size() - previous_size);
+}
+
+int32 Sweep_And_Prune::raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_ids) const
+{
+    PROFILE_FUNCTION()
+
+    const int64 previous_size = out_ids.size();
+    const vec3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+    // Not on the axes until the next find_pairs, there's only a step's worth of them
+    for (uint32 id : _pending_ids)
+    {
+        float t_enter = 0.0f;
+        float t_exit = max_distance;
+        if (clip_ray(_bounds[id], origin, inverse_direction, t_enter, t_exit))
+        {
+            out_ids.push_back(id);
+        }
+    }
+
+    const Dynamic_Array<Endpoint>& x_endpoints = _axes[0];
+    if (x_endpoints.size() == 0)
+    {
+        return static_cast<int32>(out_ids.size() - previous_size);
+    }
+
+    // Every axis starts with the smallest min and ends with the biggest max
+    const AABB sorted_extent(
+        vec3(_axes[0][0].value, _axes[1][0].value, _axes[2][0].value),
+        vec3(_axes[0][x_endpoints.size() - 1].value, _axes[1][x_endpoints.size() - 1].value, _axes[2][x_endpoints.size() - 1].value));
+
+    float t_enter = 0.0f;
+    float t_exit = max_distance;
+    if (!clip_ray(sorted_extent, origin, inverse_direction, t_enter, t_exit))
+    {
+        return static_cast<int32>(out_ids.size() - previous_size);
+    }
+
+    const float x_enter = origin.x + direction.x * t_enter;
+    const float x_exit = origin.x + direction.x * t_exit;
+    const float x_min = std::min(x_enter, x_exit);
+    const float x_max = std::max(x_enter, x_exit);
+
+    const Endpoint* endpoint = std::lower_bound(x_endpoints.begin(), x_endpoints.end(), x_min - _max_x_extent,
+        [](const Endpoint& other, float value) { return other.value < value; });
+
+    for (; endpoint != x_endpoints.end() && endpoint->value <= x_max; ++endpoint)
+    {
+        if (endpoint->is_max())
+        {
+            continue;
+        }
+
+        float t_bounds_enter = t_enter;
+        float t_bounds_exit = t_exit;
+        if (clip_ray(_bounds[endpoint->get_id()], origin, inverse_direction, t_bounds_enter, t_bounds_exit))
+        {
+            out_ids.push_back(endpoint->get_id());
+        }
+    }
+
+    return static_cast<int32>(out_ids.size() - previous_size);
+}
+
+void Sweep_And_Prune::find_pairs(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs)
+{
+    PROFILE_FUNCTION()
+
+    _merge_pending();
+    _fold_events();
+    std::swap(_pair_events, _pending_events);
+    _pending_events.clear();
+
+    out_potential_collision_pairs.clear();
+    out_potential_collision_pairs.reserve(_pair_keys.size());
+    for (uint64 pair_key : _pair_keys)
+    {
+        out_potential_collision_pairs.push_back(get_unordered_pair(pair_key));
+    }
+}
+
+void Sweep_And_Prune::_ensure_id(uint32 in_id)
+{
+    if (in_id < _states.size())
+    {
+        return;
+    }
+
+    const int64 size = static_cast<int64>(in_id) + 1;
+    if (size > _states.capacity())
+    {
+        const int64 capacity = size > _states.capacity() * 2 ? size : _states.capacity() * 2;
+        _proxies.reserve(capacity);
+        _bounds.reserve(capacity);
+        _states.reserve(capacity);
+    }
+
+    _proxies.resize(size);
+    _bounds.resize(size);
+    _states.resize(size, State::Absent);
+}
+
+void Sweep_And_Prune::_sort_min_down(int32 axis, uint32 index)
+{
+    Dynamic_Array<Endpoint>& endpoints = _axes[axis];
+    const Endpoint moving = endpoints[index];
+    const uint32 id = moving.get_id();
+
+    while (index > 0 && moving < endpoints[index - 1])
+    {
+        const Endpoint previous = endpoints[index - 1];
+
+        // Starts before another object's end, they overlap on this axis now
+        if (previous.is_max() && _overlaps_other_axes(axis, id, previous.get_id()))
+        {
+            _raw_added.push_back(make_unordered_pair_key(id, previous.get_id()));
+        }
+
+        endpoints[index] = previous;
+        _set_endpoint_index(axis, previous, index);
+        index--;
+    }
+
+    endpoints[index] = moving;
+    _proxies[id].min[axis] = index;
+}
+
+void Sweep_And_Prune::_sort_min_up(int32 axis, uint32 index)
+{
+    Dynamic_Array<Endpoint>& endpoints = _axes[axis];
+    const Endpoint moving = endpoints[index];
+    const uint32 id = moving.get_id();
+    const uint32 last_index = static_cast<uint32>(endpoints.size() - 1);
+
+    while (index < last_index && endpoints[index + 1] < moving)
+    {
+        const Endpoint next = endpoints[index + 1];
+
+        // Starts after another object's end, they stopped overlapping on this axis
+        if (next.is_max() && _overlaps_other_axes(axis, id, next.get_id()))
+        {
+            _raw_removed.push_back(make_unordered_pair_key(id, next.get_id()));
+        }
+
+        endpoints[index] = next;
+        _set_endpoint_index(axis, next, index);
+        index++;
+    }
+
+    endpoints[index] = moving;
+    _proxies[id].min[axis] = index;
+}
+
+void Sweep_And_Prune::_sort_max_down(int32 axis, uint32 index)
+{
+    Dynamic_Array<Endpoint>& endpoints = _axes[axis];
+    const Endpoint moving = endpoints[index];
+    const uint32 id = moving.get_id();
+
+    while (index > 0 && moving < endpoints[index - 1])
+    {
+        const Endpoint previous = endpoints[index - 1];
+
+        // Ends before another object's start, they stopped overlapping on this axis
+        if (!previous.is_max() && _overlaps_other_axes(axis, id, previous.get_id()))
+        {
+            _raw_removed.push_back(make_unordered_pair_key(id, previous.get_id()));
+        }
+
+        endpoints[index] = previous;
+        _set_endpoint_index(axis, previous, index);
+        index--;
+    }
+
+    endpoints[index] = moving;
+    _proxies[id].max[axis] = index;
+}
+
+void Sweep_And_Prune::_sort_max_up(int32 axis, uint32 index)
+{
+    Dynamic_Array<Endpoint>& endpoints = _axes[axis];
+    const Endpoint moving = endpoints[index];
+    const uint32 id = moving.get_id();
+    const uint32 last_index = static_cast<uint32>(endpoints.size() - 1);
+
+    while (index < last_index && endpoints[index + 1] < moving)
+    {
+        const Endpoint next = endpoints[index + 1];
+
+        // Ends after another object's start, they overlap on this axis now
+        if (!next.is_max() && _overlaps_other_axes(axis, id, next.get_id()))
+        {
+            _raw_added.push_back(make_unordered_pair_key(id, next.get_id()));
+        }
+
+        endpoints[index] = next;
+        _set_endpoint_index(axis, next, index);
+        index++;
+    }
+
+    endpoints[index] = moving;
+    _proxies[id].max[axis] = index;
+}
+
+void Sweep_And_Prune::_set_endpoint_index(int32 axis, const Endpoint& endpoint, uint32 index)
+{
+    Proxy& proxy = _proxies[endpoint.get_id()];
+    if (endpoint.is_max())
+    {
+        proxy.max[axis] = index;
+    }
+    else
+    {
+        proxy.min[axis] = index;
+    }
+}
+
+bool Sweep_And_Prune::_overlaps_other_axes(int32 axis, uint32 a_id, uint32 b_id) const
+{
+    const Proxy& a = _proxies[a_id];
+    const Proxy& b = _proxies[b_id];
+
+    const int32 axis_1 = (axis + 1) % 3;
+    const int32 axis_2 = (axis + 2) % 3;
+
+    return a.min[axis_1] < b.max[axis_1] && b.min[axis_1] < a.max[axis_1] &&
+        a.min[axis_2] < b.max[axis_2] && b.min[axis_2] < a.max[axis_2];
+}
+
+void Sweep_And_Prune::_merge_pending()
+{
+    if (_pending_ids.size() == 0)
+    {
+        return;
+    }
+
+    // Sorting only the new endpoints and merging keeps this linear in the old ones
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+        Dynamic_Array<Endpoint>& endpoints = _axes[axis];
+        const int64 old_size = endpoints.size();
+        for (uint32 id : _pending_ids)
+        {
+            endpoints.push_back({ _bounds[id].min[axis], id << 1 });
+            endpoints.push_back({ _bounds[id].max[axis], (id << 1) | 1 });
+        }
+
+        std::sort(endpoints.begin() + old_size, endpoints.end());
+        std::inplace_merge(endpoints.begin(), endpoints.begin() + old_size, endpoints.end());
+
+        for (int64 index = 0; index < endpoints.size(); ++index)
+        {
+            _set_endpoint_index(axis, endpoints[index], static_cast<uint32>(index));
+        }
+    }
+
+    // One sweep over x finds every pair with a new object, old pairs are already known
+    _active_ids.clear();
+    _active_new_ids.clear();
+    for (const Endpoint& endpoint : _axes[0])
+    {
+        const uint32 id = endpoint.get_id();
+        const bool is_new = _states[id] == State::Pending;
+
+        if (endpoint.is_max())
+        {
+            _active_ids.swap_remove(_active_ids.find_first(id));
+            if (is_new)
+            {
+                _active_new_ids.swap_remove(_active_new_ids.find_first(id));
+            }
+            continue;
+        }
+
+        for (uint32 other_id : is_new ? _active_ids : _active_new_ids)
+        {
+            if (_overlaps_other_axes(0, id, other_id))
+            {
+                _raw_added.push_back(make_unordered_pair_key(id, other_id));
+            }
+        }
+
+        _active_ids.push_back(id);
+        if (is_new)
+        {
+            _active_new_ids.push_back(id);
+        }
+    }
+
+    for (uint32 id : _pending_ids)
+    {
+        _states[id] = State::Sorted;
+    }
+    _pending_ids.clear();
+}
+
+void Sweep_And_Prune::_fold_events()
+{
+    if (_raw_added.size() == 0 && _raw_removed.size() == 0)
+    {
+        return;
+    }
+
+    std::sort(_raw_added.begin(), _raw_added.end());
+    std::sort(_raw_removed.begin(), _raw_removed.end());
+
+    // A pair can start and end several times in a step, only the difference matters.
+    // Events come out sorted, so they merge into the sorted pairs in one pass
+    _scratch_keys.clear();
+    _scratch_keys.reserve(_pair_keys.size() + _raw_added.size());
+
+    int64 added_index = 0;
+    int64 removed_index = 0;
+    int64 pair_index = 0;
+    while (added_index < _raw_added.size() || removed_index < _raw_removed.size())
+    {
+        uint64 key;
+        if (removed_index == _raw_removed.size() ||
+            (added_index < _raw_added.size() && _raw_added[added_index] < _raw_removed[removed_index]))
+        {
+            key = _raw_added[added_index];
+        }
+        else
+        {
+            key = _raw_removed[removed_index];
+        }
+
+        int32 net = 0;
+        for (; added_index < _raw_added.size() && _raw_added[added_index] == key; ++added_index)
+        {
+            net++;
+        }
+        for (; removed_index < _raw_removed.size() && _raw_removed[removed_index] == key; ++removed_index)
+        {
+            net--;
+        }
+        assert(net >= -1 && net <= 1);
+
+        if (net == 0)
+        {
+            continue;
+        }
+
+        for (; pair_index < _pair_keys.size() && _pair_keys[pair_index] < key; ++pair_index)
+        {
+            _scratch_keys.push_back(_pair_keys[pair_index]);
+        }
+
+        if (net > 0)
+        {
+            assert(pair_index == _pair_keys.size() || _pair_keys[pair_index] != key);
+            _scratch_keys.push_back(key);
+        }
+        else
+        {
+            assert(pair_index < _pair_keys.size() && _pair_keys[pair_index] == key);
+            pair_index++;
+        }
+
+        _pending_events.push_back({ get_unordered_pair(key), net > 0 });
+    }
+
+    for (; pair_index < _pair_keys.size(); ++pair_index)
+    {
+        _scratch_keys.push_back(_pair_keys[pair_index]);
+    }
+
+    std::swap(_pair_keys, _scratch_keys);
+    _raw_added.clear();
+    _raw_removed.clear();
+}
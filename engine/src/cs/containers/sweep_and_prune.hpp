@@ -0,0 +1,139 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Persistent sweep and prune over all three axes.
+// Every axis keeps the objects' min and max endpoints sorted between steps. Moving an object
+// insertion sorts its endpoints into place, which is a few swaps when it moved a little.
+// Every swap of a min past a max starts or ends an overlap on that axis, and when the other
+// two axes overlap too the pair is added or removed, so pairs are never searched for.
+// Besides the full pair list it reports which pairs were added and removed since the last
+// find_pairs, for contact begin/end callbacks.
+// Objects added in a step are merged into the axes together on the next find_pairs.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/math/math.hpp"
+#include "cs/containers/pair.hpp"
+#include "cs/containers/dynamic_array.hpp"
+#include "cs/engine/physics/broadphase.hpp"
+
+class Sweep_And_Prune : public Broadphase
+{
+public:
+    struct Pair_Event
+    {
+        // Smaller id first
+        Pair<uint32, uint32> pair;
+        bool added;
+    };
+
+public:
+    Sweep_And_Prune() = default;
+
+    Broadphase_Type::Type get_type() const override { return Broadphase_Type::Sweep_And_Prune; }
+
+    void update(uint32 in_id, const AABB& in_bounds) override;
+    void remove(uint32 in_id) override;
+    void clear() override;
+
+    bool contains(uint32 in_id) const { return in_id < _states.size() && _states[in_id] != State::Absent; }
+    int64 size() const { return _count; }
+
+    AABB get_bounds(uint32 in_id) const
+    {
+        assert(contains(in_id));
+        return _bounds[in_id];
+    }
+
+    // Appends every id overlapping in_bounds once, sorted, returns how many were added.
+    // Walks the x axis up to in_bounds, it's not meant for many queries per step
+    int32 get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const override;
+
+    // Walks the x endpoints only over the ray's x interval, after clipping it to the objects' extent.
+    // The walk starts the largest x size seen before the interval, so one very long object makes it longer
+    int32 raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_ids) const override;
+
+    // Each overlapping pair once, smaller id first, sorted
+    void find_pairs(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs) override;
+
+    // What changed up to the last find_pairs, in order. A pair shows up at most once, unless an
+    // object was removed and something was added under its id in the same step
+    const Dynamic_Array<Pair_Event>& get_pair_events() const { return _pair_events; }
+
+private:
+    enum State : uint8
+    {
+        Absent,
+        // Waiting to be merged into the axes on the next find_pairs
+        Pending,
+        Sorted
+    };
+
+    struct Endpoint
+    {
+        float value;
+        // id << 1 | is_max
+        uint32 data;
+
+        uint32 get_id() const { return data >> 1; }
+        bool is_max() const { return data & 1; }
+
+        // Mins go before maxes at equal values, so touching objects overlap like in the grids
+        bool operator<(const Endpoint& other) const
+        {
+            return value < other.value || (value == other.value && !is_max() && other.is_max());
+        }
+    };
+
+    // Positions of an object's endpoints in each axis
+    struct Proxy
+    {
+        uint32 min[3];
+        uint32 max[3];
+    };
+
+    Dynamic_Array<Endpoint> _axes[3];
+
+    // Indexed by id
+    Dynamic_Array<Proxy> _proxies;
+    Dynamic_Array<AABB> _bounds;
+    Dynamic_Array<uint8> _states;
+    int64 _count { 0 };
+    // Largest max.x - min.x since the last clear, nothing overlapping an x interval starts further before it
+    float _max_x_extent { 0.0f };
+
+    Dynamic_Array<uint32> _pending_ids;
+
+    // Every overlap start and end since the last fold, the same pair can come and go
+    Dynamic_Array<uint64> _raw_added;
+    Dynamic_Array<uint64> _raw_removed;
+
+    // make_unordered_pair_key of every overlapping pair, sorted
+    Dynamic_Array<uint64> _pair_keys;
+    Dynamic_Array<Pair_Event> _pair_events;
+    // Folded since the last find_pairs, published by the next one
+    Dynamic_Array<Pair_Event> _pending_events;
+
+    Dynamic_Array<uint64> _scratch_keys;
+    // Objects whose x interval is open during the merge sweep
+    Dynamic_Array<uint32> _active_ids;
+    Dynamic_Array<uint32> _active_new_ids;
+
+private:
+    void _ensure_id(uint32 in_id);
+
+    void _sort_min_down(int32 axis, uint32 index);
+    void _sort_min_up(int32 axis, uint32 index);
+    void _sort_max_down(int32 axis, uint32 index);
+    void _sort_max_up(int32 axis, uint32 index);
+    void _set_endpoint_index(int32 axis, const Endpoint& endpoint, uint32 index);
+
+    // Overlap on the two axes other than axis, going by the endpoint order
+    bool _overlaps_other_axes(int32 axis, uint32 a_id, uint32 b_id) const;
+
+    void _merge_pending();
+    // Turns the raw starts and ends into pending pair events and applies them to _pair_keys
+    void _fold_events();
+};
@@ -8,6 +8,7 @@
 #include <cstdlib>
 #include <cassert>
 #include <cstdio>
+#include <type_traits>
 
 #if defined(__ANDROID__)
 	// Should break
@@ -43,9 +44,33 @@
 
 #define CS_MOVE(x) static_cast<decltype(x)&&>(x)
 
+// Padding for data written by different threads, so they don't false share
+#define CS_CACHE_LINE_SIZE 64
+
+// Which vector instructions the 4 wide paths can count on. SSE2 is part of every x64 target
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define CS_SSE2
+#elif defined(__aarch64__) || defined(_M_ARM64)
+	#define CS_NEON
+#endif
+
+// Starting slot count of the Name_Id string table, it doubles whenever it gets half full
+#ifndef CS_NAME_ID_TABLE_CAPACITY
+#define CS_NAME_ID_TABLE_CAPACITY 4096
+#endif
+
 #define SIGN(x) ((x < 0.0f) ? -1.0f : 1.0f)
 #define NEAR_ZERO_CHECK(x) ((fabs(x) < NEARLY_ZERO) ? (NEARLY_ZERO * SIGN(x)) : x)
 
+// Types that can be moved in memory with memcpy instead of move construct + destroy.
+// Trivially copyable types are by default, types with hand written memberwise copies opt in.
+template<typename Type>
+struct Is_Trivially_Relocatable : std::is_trivially_copyable<Type> {};
+
+#define DECLARE_TRIVIALLY_RELOCATABLE(Type) \
+template<> \
+struct Is_Trivially_Relocatable<Type> : std::true_type {};
+
 #define CS_SHARED_PTR_SHOULD_INVOKE_DESTRUCTOR
 //#define CS_MATH_USE_float_PRECISION
 
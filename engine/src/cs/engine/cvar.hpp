@@ -8,7 +8,7 @@
 #include "cs/name_id.hpp"
 #include "cs/engine/singleton.hpp"
 #include "cs/memory/shared_ptr.hpp"
-#include "cs/containers/hash_map.hpp"
+#include "cs/containers/flat_hash_map.hpp"
 
 #include <string>
 #include <sstream>
@@ -51,17 +51,36 @@ public:
     virtual std::string to_string() const override
     {
         std::ostringstream oss;
-        oss << _value;
+        // Streams treat uint8/int8 as characters, enum cvars are stored in them
+        if constexpr (std::is_integral_v<Type> && sizeof(Type) == 1 && !std::is_same_v<Type, bool>)
+        {
+            oss << static_cast<int32>(_value);
+        }
+        else
+        {
+            oss << _value;
+        }
         return oss.str();
     }
 
     virtual void set_from_string(const std::string& value_str) override
     {
         std::istringstream iss(value_str);
-        Type new_value;
-        if (iss >> new_value)
+        if constexpr (std::is_integral_v<Type> && sizeof(Type) == 1 && !std::is_same_v<Type, bool>)
+        {
+            int32 new_value;
+            if (iss >> new_value)
+            {
+                set(static_cast<Type>(new_value));
+            }
+        }
+        else
         {
-            set(new_value);
+            Type new_value;
+            if (iss >> new_value)
+            {
+                set(new_value);
+            }
         }
     }
     
@@ -148,5 +167,5 @@ public:
     }
 
 private:
-    Hash_Map<Name_Id, Shared_Ptr<CVar>> _cvars;
+    Flat_Hash_Map<Name_Id, Shared_Ptr<CVar>> _cvars;
 };
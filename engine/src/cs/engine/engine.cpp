@@ -2,6 +2,8 @@
 #include "cs/engine/cvar.hpp"
 #include "cs/engine/input.hpp"
 #include "cs/engine/thread_pool.hpp"
+#include "cs/memory/frame_allocator.hpp"
+#include "cs/memory/memory_stats.hpp"
 #include "cs/engine/net/net_connection.hpp"
 #include "cs/engine/window/glfw/glfw_window.hpp"
 
@@ -41,8 +43,14 @@ void Engine::initialize(const Dynamic_Array<std::string>& args)
         _create_renderer_backend((Renderer_API::Type)_cvar_renderer_api->get(), _window);
     }
 
+    _convex_hull_pool = Shared_Ptr<Convex_Hull_Pool>::create();
     _physics_system = Shared_Ptr<Physics_System>::create();
+    _physics_system->set_broadphase((Broadphase_Type::Type)_cvar_physics_broadphase->get());
     _physics_system->initialize();
+    // Switching at runtime is fine, bodies go into the new broadphase on the next step
+    _cvar_physics_broadphase->on_change_event.bind([this]() {
+        _physics_system->set_broadphase((Broadphase_Type::Type)_cvar_physics_broadphase->get());
+    });
 
     _net_connection = Shared_Ptr<Net_Connection>::create((Net_Type::Type)_cvar_net_role->get());
 
@@ -54,6 +62,10 @@ void Engine::shutdown()
     PROFILE_FUNCTION()
 
     _vr_system->shutdown();
+
+#ifdef CS_WITH_MEMORY_TRACKING
+    Memory_Stats::print();
+#endif //CS_WITH_MEMORY_TRACKING
 }
 
 using Clock = std::chrono::high_resolution_clock;
@@ -79,6 +91,9 @@ void Engine::run(Entry_Point& entry_point)
     {
         Scoped_Profiler frame_scope("frame");
 
+        // Frame allocations from two frames ago can be reused from here on
+        Frame_Allocator::begin_frame();
+
         // Get current time and calculate elapsed time
         TimePoint currentTime = Clock::now();
         Duration frameTime = currentTime - previousTime;
@@ -203,6 +218,8 @@ void Engine::_initialize_cvars()
     "Exit the application and shutdown the engine.");
     _cvar_fixed_timestep = _cvar_registry->register_cvar<float>("cs_fdt", 1.0f / 60.0f,
         "Fixed timestep");
+    _cvar_physics_broadphase = _cvar_registry->register_cvar<uint8>("cs_physics_broadphase",
+        Broadphase_Type::Uniform_Grid, "Physics broadphase. (0 uniform grid, 1 hierarchical grid, 2 AABB tree, 3 sweep and prune)");
 }
 
 void Engine::_poll_inputs()
@@ -21,6 +21,7 @@ class CVar_Registry;
 class Net_Connection;
 class App;
 class Physics_System;
+class Convex_Hull_Pool;
 class Thread_Pool;
 class Profiler;
 
@@ -58,6 +59,8 @@ private:
     Shared_Ptr<CVar_Registry> _cvar_registry;
     Shared_Ptr<Thread_Pool> _thread_pool;
     Shared_Ptr<Net_Connection> _net_connection;
+    // Outlives the physics system, its colliders point into it
+    Shared_Ptr<Convex_Hull_Pool> _convex_hull_pool;
     Shared_Ptr<Physics_System> _physics_system;
 
     // Headless doesn't need these
@@ -84,6 +87,7 @@ private:
     Shared_Ptr<CVar_T<bool>> _cvar_vr_support;
     Shared_Ptr<CVar_T<bool>> _cvar_exit;
     Shared_Ptr<CVar_T<float>> _cvar_fixed_timestep;
+    Shared_Ptr<CVar_T<uint8>> _cvar_physics_broadphase;
 
 private:
     void _parse_args(const Dynamic_Array<std::string>& args);
@@ -5,6 +5,7 @@
 
 #include "cs/cs.hpp"
 #include "cs/containers/dynamic_array.hpp"
+#include "cs/containers/small_array.hpp"
 
 #include <functional>
 #include <type_traits>
@@ -61,5 +62,5 @@ public:
     }
 
 protected:
-    Dynamic_Array<std::function<void(Args...)>> _events;
+    Small_Array<std::function<void(Args...)>, 2> _events;
 };
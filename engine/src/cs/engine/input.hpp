@@ -8,7 +8,7 @@
 #include "cs/name_id.hpp"
 #include "cs/engine/singleton.hpp"
 #include "cs/memory/shared_ptr.hpp"
-#include "cs/containers/hash_map.hpp"
+#include "cs/containers/flat_hash_map.hpp"
 
 namespace Input_Modifier
 {
@@ -46,9 +46,9 @@ private:
         Dynamic_Array<Pair<Name_Id, float>> _input_to_multiplier_map;
     };
 
-    Hash_Map<Name_Id, float> _input_value_map;
-    Hash_Map<Name_Id, Dynamic_Array<Name_Id>> _input_to_events_map;
-    Hash_Map<Name_Id, Event_State> _event_map;
+    Flat_Hash_Map<Name_Id, float> _input_value_map;
+    Flat_Hash_Map<Name_Id, Dynamic_Array<Name_Id>> _input_to_events_map;
+    Flat_Hash_Map<Name_Id, Event_State> _event_map;
     Dynamic_Array<Name_Id> _changed_events;
 };
 
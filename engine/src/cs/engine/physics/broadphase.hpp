@@ -0,0 +1,78 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Common interface of the broadphase structures, so Physics_System can swap them.
+// Objects are dense uint32 ids picked by the caller, pairs come out as
+// (smaller id, bigger id), each pair once.
+// The queries don't change the structure, so several threads can run them at once as long
+// as nothing updates it meanwhile.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/math/math.hpp"
+#include "cs/containers/pair.hpp"
+#include "cs/containers/dynamic_array.hpp"
+
+namespace Broadphase_Type
+{
+    enum Type : uint8
+    {
+        // One Spatial_Hash_Grid, fine when bodies are all about the same size
+        Uniform_Grid,
+        // Hierarchical_Hash_Grid, for scenes mixing small debris and large static geometry
+        Hierarchical_Grid,
+        // Dynamic_AABB_Tree, for large sparse worlds where activity is clustered
+        AABB_Tree,
+        // Sweep_And_Prune, for scenes where most bodies barely move between steps
+        Sweep_And_Prune,
+        COUNT
+    };
+}
+
+class Thread_Pool;
+
+class Broadphase
+{
+public:
+    // For queries that don't come from an object in the broadphase
+    static constexpr uint32 invalid_id = 0xFFFFFFFF;
+
+public:
+    virtual ~Broadphase() = default;
+
+    // Spreads update_all and find_pairs over the pool's workers where the structure supports it,
+    // nullptr keeps everything on the calling thread
+    virtual void set_thread_pool(Thread_Pool* in_thread_pool) { _thread_pool = in_thread_pool; }
+
+    virtual Broadphase_Type::Type get_type() const = 0;
+
+    // Adds the object if it isn't in yet
+    virtual void update(uint32 in_id, const AABB& in_bounds) = 0;
+    virtual void remove(uint32 in_id) = 0;
+    virtual void clear() = 0;
+
+    // Updates ids [0, count), once per step instead of once per object
+    virtual void update_all(const AABB* in_bounds, int64 count)
+    {
+        for (int64 i = 0; i < count; ++i)
+        {
+            update(static_cast<uint32>(i), in_bounds[i]);
+        }
+    }
+
+    // Appends every id overlapping in_bounds once, except in_id, returns how many were added
+    virtual int32 get_potential_collisions(uint32 in_id, const AABB& in_bounds, Dynamic_Array<uint32>& out_potential_colliders) const = 0;
+
+    // Appends the ids whose bounds the ray may hit within max_distance, returns how many were added.
+    // Can report more than it hits, the caller tests the bounds. direction doesn't have to be
+    // normalized, distance is measured in its lengths. max_distance can be FLT_MAX, every structure
+    // clips the ray to what it holds instead of querying the box around it
+    virtual int32 raycast(const vec3& origin, const vec3& direction, float max_distance, Dynamic_Array<uint32>& out_ids) const = 0;
+
+    virtual void find_pairs(Dynamic_Array<Pair<uint32, uint32>>& out_potential_collision_pairs) = 0;
+
+protected:
+    Thread_Pool* _thread_pool { nullptr };
+};
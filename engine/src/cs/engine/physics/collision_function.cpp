@@ -4,9 +4,21 @@
 #include "cs/engine/physics/collision_function.hpp"
 #include "cs/engine/physics/physics_system.hpp"
 #include <algorithm>
+#include <functional>
 
 namespace Collision_Helpers
 {
+    // Touching or flat shapes can keep GJK going around the origin without ever getting there
+    constexpr int32 max_gjk_iterations = 64;
+
+    // Every EPA iteration adds a point, its faces and horizon can't outgrow these
+    constexpr int32 max_epa_iterations = 48;
+    constexpr int32 max_epa_points = max_epa_iterations + 4;
+    constexpr int32 max_epa_faces = 512;
+    constexpr int32 max_epa_horizon_edges = 128;
+    // How much closer to the origin the next support has to be before EPA calls it done
+    constexpr float epa_tolerance = 0.001f;
+
     mat4 _inertia_tensor_sphere(const Collider& collider, const float mass)
     {
         const float radius = collider.shape.sphere.radius;
@@ -71,8 +83,9 @@ namespace Collision_Helpers
 
     mat4 _inertia_tensor_convex(const Collider& collider, const float mass)
     {
-        //TODO: tetrahedral decomposition
-        return mat4(1.0f);
+        // The hull has it for a mass of 1, around its center of mass
+        const mat4& unit_inertia = Convex_Hull_Pool::get().get_hull(collider.convex_hull).inertia_tensor;
+        return mat4(unit_inertia[0] * mass, unit_inertia[1] * mass, unit_inertia[2] * mass, vec4(0.0f, 0.0f, 0.0f, 1.0f));
     }
 
     mat4 inertia_tensor(const Collider& collider, const float mass)
@@ -149,43 +162,126 @@ namespace Collision_Helpers
         return a + ab * t;
     }
 
-    // Finding the point furthest from the origin in a given direction using the Separation Axis theorem
-    vec3 sat_max_distance(const vec3 (&vertices)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count, const vec3& p, const quat& o, const vec3& direction)
+    // A hull, a box, a cylinder or a sphere placed in the world. Its axes are worked out once per test, so a support query
+    // only projects the direction instead of rotating it with a quaternion
+    struct Convex_Support
     {
-        vec3 furthest_vertex;
-        float max_distance = -FLT_MAX;
+        Collider::Type type;
+        // Only for Convex_Hull, a box's corners follow from half_extents
+        const Convex_Hull_Resource* hull { nullptr };
+        // A cylinder is around the z axis, half_extents.z is its half height
+        vec3 half_extents { vec3::zero_vector };
+        float radius { 0.0f };
+        vec3 position;
+        vec3 axes[3];
+        // The next climb starts from the last support vertex, directions don't change much between queries.
+        // Round shapes have no vertices, it stays 0 for them
+        int32 last_vertex { 0 };
+
+        Convex_Support(const Convex_Hull_Resource& hull, const vec3& position, const quat& orientation)
+            : type(Collider::Convex_Hull), hull(&hull), position(position)
+        {
+            _set_axes(orientation);
+        }
 
-        // Orientate direction in mesh space
-        vec3 transformed_direction = o.mul(direction);
+        Convex_Support(const vec3& half_extents, const vec3& position, const quat& orientation)
+            : type(Collider::Box), half_extents(half_extents), position(position)
+        {
+            _set_axes(orientation);
+        }
+
+        Convex_Support(float radius, float half_height, const vec3& position, const quat& orientation)
+            : type(Collider::Cylinder), half_extents(0.0f, 0.0f, half_height), radius(radius), position(position)
+        {
+            _set_axes(orientation);
+        }
 
-        for (int v = 0; v < count; ++v)
+        Convex_Support(float radius, const vec3& position)
+            : type(Collider::Sphere), radius(radius), position(position)
         {
-            const float distance = vertices[v].dot(transformed_direction);
-            if (distance > max_distance)
+            _set_axes(quat::zero_quat);
+        }
+
+        // Only hulls and boxes have vertices, EPA and the GJK cache rely on them
+        vec3 get_vertex(int32 vertex) const
+        {
+            assert(type == Collider::Convex_Hull || type == Collider::Box);
+
+            // A box corner's bit i is set when it's on the positive side of axis i
+            const vec3 local = hull ? hull->vertices[vertex] : vec3(
+                vertex & 1 ? half_extents.x : -half_extents.x,
+                vertex & 2 ? half_extents.y : -half_extents.y,
+                vertex & 4 ? half_extents.z : -half_extents.z);
+            return _to_world(local);
+        }
+
+        // Finding the point furthest from the origin in a given direction
+        vec3 get_furthest_point(const vec3& direction)
+        {
+            const vec3 local_direction(direction.dot(axes[0]), direction.dot(axes[1]), direction.dot(axes[2]));
+            switch (type)
+            {
+            case Collider::Convex_Hull:
+                last_vertex = hull->find_support_vertex(local_direction, last_vertex);
+                return get_vertex(last_vertex);
+            case Collider::Box:
+                last_vertex = (local_direction.x > 0.0f ? 1 : 0) | (local_direction.y > 0.0f ? 2 : 0) | (local_direction.z > 0.0f ? 4 : 0);
+                return get_vertex(last_vertex);
+            case Collider::Cylinder:
+            {
+                // Furthest cap, then the rim point of that cap. Straight along the axis any cap point will do
+                const float radial = sqrtf(local_direction.x * local_direction.x + local_direction.y * local_direction.y);
+                const float scale = radial > NEARLY_ZERO ? radius / radial : 0.0f;
+                return _to_world(vec3(local_direction.x * scale, local_direction.y * scale,
+                    local_direction.z > 0.0f ? half_extents.z : -half_extents.z));
+            }
+            case Collider::Sphere:
             {
-                max_distance = distance;
-                furthest_vertex = vertices[v];
+                const float length = direction.length();
+                return length > NEARLY_ZERO ? position + direction * (radius / length) : position;
+            }
+            default:
+                assert(false);
+                return position;
             }
         }
 
-        return furthest_vertex + p;
-    }
+    private:
+        void _set_axes(const quat& orientation)
+        {
+            const mat4 rotation = orientation.to_mat4();
+            axes[0] = rotation[0].xyz;
+            axes[1] = rotation[1].xyz;
+            axes[2] = rotation[2].xyz;
+        }
+
+        vec3 _to_world(const vec3& local) const
+        {
+            return position + axes[0] * local.x + axes[1] * local.y + axes[2] * local.z;
+        }
+    };
+
+    // A point of the Minkowski difference and the hull vertices it came from
+    struct Simplex_Point
+    {
+        vec3 point;
+        int32 vertex_a, vertex_b;
+    };
 
     // Used for getting the "mesh" differences, optimizing by getting the difference between furthest point for a given direction
-    vec3 minkowski_difference(const vec3 (&vertices_a)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count_a, const vec3& p_a, const quat& o_a,
-        const vec3 (&vertices_b)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count_b, const vec3& p_b, const quat& o_b, const vec3& direction)
+    vec3 minkowski_difference(Convex_Support& a, Convex_Support& b, const vec3& direction)
     {
-        return sat_max_distance(vertices_a, count_a, p_a, o_a, direction) - sat_max_distance(vertices_b, count_b, p_b, o_b, -direction);
+        return a.get_furthest_point(direction) - b.get_furthest_point(-direction);
     }
     
     // Just a more common name for minkowski_difference
-    vec3 support(const vec3 (&vertices_a)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count_a, const vec3& p_a, const quat& o_a,
-        const vec3 (&vertices_b)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count_b, const vec3& p_b, const quat& o_b, const vec3& direction)
+    Simplex_Point support(Convex_Support& a, Convex_Support& b, const vec3& direction)
     {
-        return minkowski_difference(vertices_a, count_a, p_a, o_a, vertices_b, count_b, p_b, o_b, direction);
+        const vec3 point = minkowski_difference(a, b, direction);
+        return { point, a.last_vertex, b.last_vertex };
     }
 
-    void add_to_simplex(vec3 (&simplex)[4], int32& count, const vec3& support)
+    void add_to_simplex(Simplex_Point (&simplex)[4], int32& count, const Simplex_Point& support)
     {
         assert(count > 0 && count < 4);
 
@@ -203,11 +299,11 @@ namespace Collision_Helpers
         return direction_a.dot(direction_b) > 0;
     }
 
-    bool line_simplex(vec3 (&simplex)[4], int32& count, vec3& direction)
+    bool line_simplex(Simplex_Point (&simplex)[4], int32& count, vec3& direction)
     {
         assert(count == 2);
-        const vec3 a = simplex[0];
-        const vec3 b = simplex[1];
+        const vec3 a = simplex[0].point;
+        const vec3 b = simplex[1].point;
 
         const vec3 ab = b - a;
         const vec3 ao = -a;
@@ -235,12 +331,14 @@ namespace Collision_Helpers
         return false;
     }
 
-    bool triangle_simplex(vec3 (&simplex)[4], int32& count, vec3& direction)
+    bool triangle_simplex(Simplex_Point (&simplex)[4], int32& count, vec3& direction)
     {
         assert(count == 3);
-        const vec3 a = simplex[0];
-        const vec3 b = simplex[1];
-        const vec3 c = simplex[2];
+        const Simplex_Point b_point = simplex[1];
+        const Simplex_Point c_point = simplex[2];
+        const vec3 a = simplex[0].point;
+        const vec3 b = b_point.point;
+        const vec3 c = c_point.point;
 
         const vec3 ab = b - a;
         const vec3 ac = c - a;
@@ -253,7 +351,7 @@ namespace Collision_Helpers
             // Do we already have something in this dir
             if (same_direction(ac, ao))
             {
-                simplex[1] = c;
+                simplex[1] = c_point;
                 count = 2;
 
                 // Look perpendicular to it
@@ -282,8 +380,8 @@ namespace Collision_Helpers
                 else
                 {
                     // swap simplex points
-                    simplex[1] = c;
-                    simplex[2] = b;
+                    simplex[1] = c_point;
+                    simplex[2] = b_point;
                     direction = -abc;
                 }
             }
@@ -292,13 +390,13 @@ namespace Collision_Helpers
         return false;
     }
 
-    bool tetrahedron_simplex(vec3 (&simplex)[4], int32& count, vec3& direction)
+    bool tetrahedron_simplex(Simplex_Point (&simplex)[4], int32& count, vec3& direction)
     {
         assert(count == 4);
-        const vec3 a = simplex[0];
-        const vec3 b = simplex[1];
-        const vec3 c = simplex[2];
-        const vec3 d = simplex[3];
+        const vec3 a = simplex[0].point;
+        const vec3 b = simplex[1].point;
+        const vec3 c = simplex[2].point;
+        const vec3 d = simplex[3].point;
 
         const vec3 ab = b - a;
         const vec3 ac = c - a;
@@ -317,22 +415,26 @@ namespace Collision_Helpers
         
         if (same_direction(acd, ao))
         {
+            // a, c, d
             count = 3;
-            simplex[2] = d;
+            simplex[1] = simplex[2];
+            simplex[2] = simplex[3];
             return triangle_simplex(simplex, count, direction);
         }
         
         if (same_direction(abd, ao))
         {
+            // a, d, b
             count = 3;
-            simplex[1] = d;
+            simplex[2] = simplex[1];
+            simplex[1] = simplex[3];
             return triangle_simplex(simplex, count, direction);
         }
 
         return true;
     }
 
-    bool next_simplex(vec3 (&simplex)[4], int32& count, vec3& direction)
+    bool next_simplex(Simplex_Point (&simplex)[4], int32& count, vec3& direction)
     {
         assert(count >= 2 && count <= 4);
 
@@ -347,193 +449,492 @@ namespace Collision_Helpers
         return false;
     }
 
+    // Last frame's tetrahedron, moved with the hulls. The hulls have moved since, so the winding
+    // the simplex cases count on doesn't hold anymore, every face is checked.
+    // True if it still holds the origin, otherwise out_direction points from it towards the origin
+    bool restore_simplex(Convex_Support& a, Convex_Support& b, const Gjk_Cache& cache, Simplex_Point (&simplex)[4], vec3& out_direction)
+    {
+        vec3 center = vec3::zero_vector;
+        for (int32 i = 0; i < 4; ++i)
+        {
+            const int32 vertex_a = cache.vertices_a[i];
+            const int32 vertex_b = cache.vertices_b[i];
+            simplex[i] = { a.get_vertex(vertex_a) - b.get_vertex(vertex_b), vertex_a, vertex_b };
+            center += simplex[i].point * 0.25f;
+        }
+        out_direction = -center;
+
+        // Each face with the point across from it
+        static constexpr int32 faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+        for (const int32 (&face)[4] : faces)
+        {
+            const vec3& p = simplex[face[0]].point;
+            vec3 normal = (simplex[face[1]].point - p).cross(simplex[face[2]].point - p);
+            const float opposite = normal.dot(simplex[face[3]].point - p);
+            if (fabs(opposite) < 1e-6f)
+            {
+                // Gone flat
+                return false;
+            }
+
+            if (opposite > 0.0f)
+            {
+                normal = -normal;
+            }
+            if (normal.dot(p) <= 0.0f)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
     // Gilbert-Johnson-Keerthi [GJK] algorithm - https://winter.dev/articles/gjk-algorithm
     // We try to construct a simplex (4 - point mesh), that contains the distance 
     // between furthest points, since convex hulls are in question, if the 
     // simplex contains the origin inside it, there must be a collision between the two meshes.
-    bool gjk(const vec3 (&vertices_a)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count_a, const vec3& p_a, const quat& o_a,
-    const vec3 (&vertices_b)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count_b, const vec3& p_b, const quat& o_b, const vec3& initial_direction, vec3 (&simplex)[4])
+    // With a cache a pair that's still apart along its last separating axis costs one support,
+    // one that still holds the origin in last frame's tetrahedron costs none.
+    bool gjk(Convex_Support& a, Convex_Support& b, const vec3& initial_direction, Gjk_Cache* cache, Simplex_Point (&simplex)[4])
     {
-        // choose an initial direction, for the first support
-        vec3 support = Collision_Helpers::support(vertices_a, count_a, p_a, o_a, vertices_b, count_b, p_b, o_b, initial_direction);
+        int32 count_s = 0;
+        vec3 direction = initial_direction;
 
-        // First point of simplex is the initial furthest distance
-        int32 count_s = 1;
-        simplex[0] = support;
-        //printf("adding to simplex support: %f %f %f\n", support.x, support.y, support.z);
+        if (cache && cache->count > 0)
+        {
+            // Climbs start where they ended last frame
+            a.last_vertex = cache->vertices_a[0];
+            b.last_vertex = cache->vertices_b[0];
 
-        // As the support function shows us a result away from the origin, we flip it to be towards the origin, so the next point can 
-        // point away from the first point.
-        vec3 direction = -support;
+            if (cache->is_separated)
+            {
+                direction = cache->separating_axis;
+            }
+            else if (restore_simplex(a, b, *cache, simplex, direction))
+            {
+                return true;
+            }
+        }
 
-        while(true)
+        bool is_colliding = false;
+        if (count_s == 0)
+        {
+            if (direction.length_squared() < 1e-12f)
+            {
+                direction = vec3(1.0f, 0.0f, 0.0f);
+            }
+
+            // choose an initial direction, for the first support
+            const Simplex_Point support = Collision_Helpers::support(a, b, direction);
+
+            // Nothing of the difference gets past the origin along the starting direction, it separates them
+            if (support.point.dot(direction) > 0)
+            {
+                // First point of simplex is the initial furthest distance
+                count_s = 1;
+                simplex[0] = support;
+
+                // As the support function shows us a result away from the origin, we flip it to be towards the origin, so the next point can 
+                // point away from the first point.
+                direction = -support.point;
+            }
+        }
+
+        for (int32 iteration = 0; count_s > 0 && iteration < max_gjk_iterations; ++iteration)
         {
-            //printf("direction: %f %f %f\n", direction.x, direction.y, direction.z);
             // We get the next distance
-            support = Collision_Helpers::support(vertices_a, count_a, p_a, o_a, vertices_b, count_b, p_b, o_b, direction);
+            const Simplex_Point support = Collision_Helpers::support(a, b, direction);
 
             // If a found support (diff between two vertices) is behind the origin,
             // then the origin can't be inside the simplex - no collision
-            if (support.dot(direction) <= 0)
+            if (support.point.dot(direction) <= 0)
             {
-                return false;
+                break;
             }
 
             Collision_Helpers::add_to_simplex(simplex, count_s, support);
 
-            //printf("adding to simplex support: %f %f %f\n", support.x, support.y, support.z);
             if (Collision_Helpers::next_simplex(simplex, count_s, direction))
             {
-                return true;
+                is_colliding = true;
+                break;
             }
         }
-    }
 
-    void get_face_normals(const std::vector<vec3>& polytope, const std::vector<size_t>& faces, size_t& min_face, std::vector<vec4>& normals)
-    {
-        float  minDistance = FLT_MAX;
-    
-        for (size_t i = 0; i < faces.size(); i += 3) 
+        if (cache)
         {
-            vec3 a = polytope[faces[i    ]];
-            vec3 b = polytope[faces[i + 1]];
-            vec3 c = polytope[faces[i + 2]];
-    
-            vec3 normal = (b-a).cross(c-a).normalized();
-            float distance = normal.dot(a);
-    
-            if (distance < 0) 
+            if (is_colliding)
             {
-                normal   *= -1;
-                distance *= -1;
+                cache->count = 4;
+                cache->is_separated = false;
+                for (int32 i = 0; i < 4; ++i)
+                {
+                    cache->vertices_a[i] = simplex[i].vertex_a;
+                    cache->vertices_b[i] = simplex[i].vertex_b;
+                }
             }
-    
-            normals.emplace_back(normal, distance);
-    
-            if (distance < minDistance) 
+            else
             {
-                min_face = i / 3;
-                minDistance = distance;
+                cache->count = 1;
+                cache->is_separated = true;
+                cache->separating_axis = direction;
+                cache->vertices_a[0] = a.last_vertex;
+                cache->vertices_b[0] = b.last_vertex;
             }
         }
-    }
 
-    void add_edge_if_unique(std::vector<std::pair<size_t, size_t>>& edges, const std::vector<size_t>& faces, size_t a, size_t b)
-    {
-        auto reverse = std::find(                       //      0--<--3
-            edges.begin(),                              //     / \ B /   A: 2-0
-            edges.end(),                                //    / A \ /    B: 0-2
-            std::make_pair(faces[b], faces[a]) //   1-->--2
-        );
-    
-        if (reverse != edges.end()) {
-            edges.erase(reverse);
-        }
-    
-        else {
-            edges.emplace_back(faces[a], faces[b]);
-        }
+        return is_colliding;
     }
 
-    // Expanding polytope algorithm - https://winter.dev/articles/epa-algorithm
-    bool epa(const vec3 (&vertices_a)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count_a, const vec3& p_a, const quat& o_a,
-        const vec3 (&vertices_b)[CONVEX_HULL_MAX_NUM_VERTICES], int32 count_b, const vec3& p_b, const quat& o_b, 
-        const vec3 (&simplex)[4], Collision_Result& result)
+    struct Epa_Face
     {
-        std::vector<vec3> polytope = { simplex[0], simplex[1], simplex[2], simplex[3] };
-        std::vector<size_t> faces = {
-            0, 1, 2,
-            0, 3, 1,
-            0, 2, 3,
-            1, 3, 2
-        };
+        uint16 points[3];
+        vec3 normal;
+        // Of the face's plane from the origin
+        float distance;
+        bool is_removed;
+    };
+
+    struct Epa_Edge
+    {
+        uint16 from, to;
+    };
 
-        std::vector<vec4> normals;
-        size_t min_face;
-        get_face_normals(polytope, faces, min_face, normals);
+    // Distance first, so the heap orders by it
+    struct Epa_Face_Entry
+    {
+        float distance;
+        uint16 face;
 
-        vec3 min_normal;
-        float min_distance = FLT_MAX;
-        vec3 support;
+        bool operator>(const Epa_Face_Entry& other) const { return distance > other.distance; }
+    };
 
-        while (min_distance == FLT_MAX)
+    // Fixed size, everything lives on the stack. Faces are only ever appended and the heap drops
+    // removed ones when they come up, which bounds the faces by the points that can be added
+    struct Epa_Polytope
+    {
+        Simplex_Point points[max_epa_points];
+        int32 point_count { 0 };
+        Epa_Face faces[max_epa_faces];
+        int32 face_count { 0 };
+        Epa_Face_Entry heap[max_epa_faces];
+        int32 heap_count { 0 };
+        // The polytope only grows, this stays inside it
+        vec3 inside_point;
+
+        // Wound so its normal points out, edges shared by two faces run opposite ways in them
+        bool add_face(uint16 p0, uint16 p1, uint16 p2)
         {
-            min_normal = normals[min_face].xyz;
-            min_distance = normals[min_face].w;
-            
-            vec3 support = Collision_Helpers::support(vertices_a, count_a, p_a, o_a, vertices_b, count_b, p_b, o_b, min_normal);
-            float support_distance = min_normal.dot(support);
-
-            if (abs(support_distance - min_distance) > 0.001f)
+            if (face_count == max_epa_faces)
             {
-                min_distance = FLT_MAX;
+                return false;
+            }
 
-                std::vector<std::pair<size_t, size_t>> unique_edges;
-                for (size_t i = 0; i < normals.size(); i++)
-                {
-                    if (Collision_Helpers::same_direction(normals[i].xyz, support))
-                    {
-                        size_t f = i * 3;
+            Epa_Face& face = faces[face_count];
+            face = { { p0, p1, p2 }, vec3::zero_vector, FLT_MAX, false };
 
-                        Collision_Helpers::add_edge_if_unique(unique_edges, faces, f,     f + 1);
-                        Collision_Helpers::add_edge_if_unique(unique_edges, faces, f + 1, f + 2);
-                        Collision_Helpers::add_edge_if_unique(unique_edges, faces, f + 2, f    );
+            const vec3& a = points[p0].point;
+            vec3 normal = (points[p1].point - a).cross(points[p2].point - a);
+            const float length_squared = normal.length_squared();
+            if (length_squared > 1e-12f)
+            {
+                normal /= sqrtf(length_squared);
+                if (normal.dot(a - inside_point) < 0.0f)
+                {
+                    normal = -normal;
+                    std::swap(face.points[1], face.points[2]);
+                }
+                face.normal = normal;
+                face.distance = normal.dot(a);
 
-                        faces[f + 2] = faces.back(); faces.pop_back();
-                        faces[f + 1] = faces.back(); faces.pop_back();
-                        faces[f    ] = faces.back(); faces.pop_back();
+                heap[heap_count++] = { face.distance, static_cast<uint16>(face_count) };
+                std::push_heap(heap, heap + heap_count, std::greater<Epa_Face_Entry>());
+            }
+            // A sliver has no normal to expand along, it's kept for the edges but never picked
 
-                        normals[i] = normals.back(); // pop-erase
-                        normals.pop_back();
+            face_count++;
+            return true;
+        }
 
-                        i--;
-                    }
-                }
-            
-                std::vector<size_t> new_faces;
-                for (auto [edge_1, edge_2] : unique_edges) 
+        // -1 once every face is gone
+        int32 pop_closest_face()
+        {
+            while (heap_count > 0)
+            {
+                std::pop_heap(heap, heap + heap_count, std::greater<Epa_Face_Entry>());
+                const uint16 face = heap[--heap_count].face;
+                if (!faces[face].is_removed)
                 {
-                    new_faces.push_back(edge_1);
-                    new_faces.push_back(edge_2);
-                    new_faces.push_back(polytope.size());
+                    return face;
                 }
+            }
+            return -1;
+        }
+    };
 
-                polytope.push_back(support);
+    // An edge seen from both sides is inside the removed patch, only the horizon is left at the end
+    bool add_horizon_edge(Epa_Edge (&edges)[max_epa_horizon_edges], int32& count, uint16 from, uint16 to)
+    {
+        for (int32 i = 0; i < count; ++i)
+        {
+            if (edges[i].from == to && edges[i].to == from)
+            {
+                edges[i] = edges[--count];
+                return true;
+            }
+        }
 
-                std::vector<vec4> new_normals;
-                size_t new_min_face;
-                get_face_normals(polytope, new_faces, new_min_face, new_normals);
+        if (count == max_epa_horizon_edges)
+        {
+            return false;
+        }
+        edges[count++] = { from, to };
+        return true;
+    }
+
+    // Where the origin projects onto the face, in the face's points
+    vec3 get_barycentric(const Epa_Polytope& polytope, const Epa_Face& face)
+    {
+        const vec3 a = polytope.points[face.points[0]].point;
+        const vec3 ab = polytope.points[face.points[1]].point - a;
+        const vec3 ac = polytope.points[face.points[2]].point - a;
+        const vec3 ap = face.normal * face.distance - a;
+
+        const float d00 = ab.dot(ab);
+        const float d01 = ab.dot(ac);
+        const float d11 = ac.dot(ac);
+        const float d20 = ap.dot(ab);
+        const float d21 = ap.dot(ac);
+        const float denominator = d00 * d11 - d01 * d01;
+        if (fabs(denominator) < 1e-12f)
+        {
+            return vec3(1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f);
+        }
+
+        const float v = (d11 * d20 - d01 * d21) / denominator;
+        const float w = (d00 * d21 - d01 * d20) / denominator;
+        return vec3(1.0f - v - w, v, w);
+    }
 
-                float best_distance = FLT_MAX;
-                for (size_t i = 0; i < normals.size(); i++) 
+    // Expanding polytope algorithm - https://winter.dev/articles/epa-algorithm
+    // Grows GJK's tetrahedron towards the face of the Minkowski difference closest to the origin,
+    // that face's normal and distance are the contact normal and penetration.
+    // Runs out of room or iterations on very round shapes, the closest face so far is used then
+    bool epa(Convex_Support& a, Convex_Support& b, const Simplex_Point (&simplex)[4], Collision_Result& result)
+    {
+        Epa_Polytope polytope;
+        polytope.inside_point = vec3::zero_vector;
+        for (int32 i = 0; i < 4; ++i)
+        {
+            polytope.points[i] = simplex[i];
+            polytope.inside_point += simplex[i].point * 0.25f;
+        }
+        polytope.point_count = 4;
+
+        polytope.add_face(0, 1, 2);
+        polytope.add_face(0, 3, 1);
+        polytope.add_face(0, 2, 3);
+        polytope.add_face(1, 3, 2);
+
+        Epa_Edge horizon[max_epa_horizon_edges];
+        int32 closest_face = polytope.pop_closest_face();
+        for (int32 iteration = 0; closest_face >= 0 && iteration < max_epa_iterations; ++iteration)
+        {
+            const Epa_Face& face = polytope.faces[closest_face];
+            const Simplex_Point support = Collision_Helpers::support(a, b, face.normal);
+            if (support.point.dot(face.normal) - face.distance < epa_tolerance || polytope.point_count == max_epa_points)
+            {
+                break;
+            }
+
+            const uint16 new_point = static_cast<uint16>(polytope.point_count++);
+            polytope.points[new_point] = support;
+
+            // Every face the new point sees goes, their outline gets filled in with faces to the new point
+            int32 horizon_count = 0;
+            bool has_room = true;
+            for (int32 i = 0; i < polytope.face_count && has_room; ++i)
+            {
+                Epa_Face& other = polytope.faces[i];
+                if (other.is_removed || other.normal.dot(support.point - polytope.points[other.points[0]].point) <= 0.0f)
                 {
-                    if (normals[i].w < best_distance) 
-                    {
-                        best_distance = normals[i].w;
-                        min_face = i;
-                    }
+                    continue;
                 }
-                
-                for (size_t i = 0; i < new_normals.size(); i++) 
+
+                other.is_removed = true;
+                for (int32 k = 0; k < 3 && has_room; ++k)
                 {
-                    if (new_normals[i].w < best_distance) 
-                    {
-                        best_distance = new_normals[i].w;
-                        min_face = i + normals.size();
-                    }
+                    has_room = add_horizon_edge(horizon, horizon_count, other.points[k], other.points[(k + 1) % 3]);
                 }
-     
-                faces  .insert(faces  .end(), new_faces  .begin(), new_faces  .end());
-                normals.insert(normals.end(), new_normals.begin(), new_normals.end());          
             }
+
+            for (int32 i = 0; i < horizon_count && has_room; ++i)
+            {
+                has_room = polytope.add_face(horizon[i].from, horizon[i].to, new_point);
+            }
+
+            if (!has_room)
+            {
+                // The patch is left half done, the face found before it is as good as it gets
+                break;
+            }
+
+            closest_face = polytope.pop_closest_face();
         }
 
-        result.normal = min_normal;
-        result.penetration = min_distance;
-        result.contact_point = support - min_normal * min_distance * 0.5f;
+        if (closest_face < 0)
+        {
+            return false;
+        }
+
+        const Epa_Face& face = polytope.faces[closest_face];
+        result.normal = face.normal;
+        result.penetration = face.distance;
+
+        // The same weights over the hull a points that made the face give the deepest point of a
+        const vec3 weights = get_barycentric(polytope, face);
+        result.contact_point = a.get_vertex(polytope.points[face.points[0]].vertex_a) * weights.x
+            + a.get_vertex(polytope.points[face.points[1]].vertex_a) * weights.y
+            + a.get_vertex(polytope.points[face.points[2]].vertex_a) * weights.z;
 
         return true;
     }
+
+    // GJK for whether they touch, EPA for how deep
+    bool gjk_epa(Convex_Support& a, Convex_Support& b, const vec3& initial_direction, Collision_Result& result)
+    {
+        Simplex_Point simplex[4];
+        if (!gjk(a, b, initial_direction, result.gjk_cache, simplex))
+        {
+            return false;
+        }
+
+        return epa(a, b, simplex, result);
+    }
+
+    Convex_Support get_query_support(const Collider& collider, const vec3& p, const quat& o)
+    {
+        if (collider.type == Collider::Convex_Hull)
+        {
+            return Convex_Support(Convex_Hull_Pool::get().get_hull(collider.convex_hull), p, o);
+        }
+
+        assert(collider.type == Collider::Cylinder);
+        return Convex_Support(collider.shape.cylinder.radius, collider.shape.cylinder.height * 0.5f, p, o);
+    }
+
+    bool overlaps_bounds(const Collider& collider, const vec3& p, const quat& o, const AABB& bounds)
+    {
+        Convex_Support shape = get_query_support(collider, p, o);
+        Convex_Support box(bounds.get_half_extents(), bounds.get_center(), quat::zero_quat);
+
+        Simplex_Point simplex[4];
+        return gjk(shape, box, box.position - shape.position, nullptr, simplex);
+    }
+
+    bool overlaps_sphere(const Collider& collider, const vec3& p, const quat& o, const vec3& center, float radius)
+    {
+        Convex_Support shape = get_query_support(collider, p, o);
+        Convex_Support sphere(radius, center);
+
+        Simplex_Point simplex[4];
+        return gjk(shape, sphere, center - shape.position, nullptr, simplex);
+    }
+
+    // Sutherland-Hodgman against a single plane, keeps the part where normal.dot(p) <= offset.
+    // Each plane adds at most one point
+    int32 clip_polygon(const vec3* points, int32 count, const vec3& normal, float offset, vec3* out_points)
+    {
+        int32 out_count = 0;
+        for (int32 i = 0; i < count; ++i)
+        {
+            const vec3& from = points[i];
+            const vec3& to = points[(i + 1) % count];
+            const float from_distance = normal.dot(from) - offset;
+            const float to_distance = normal.dot(to) - offset;
+
+            if (from_distance <= 0.0f)
+            {
+                out_points[out_count++] = from;
+            }
+            if ((from_distance <= 0.0f) != (to_distance <= 0.0f))
+            {
+                out_points[out_count++] = from + (to - from) * (from_distance / (from_distance - to_distance));
+            }
+        }
+        return out_count;
+    }
+
+    // The deepest point, the one furthest from it, then the two that add the most area around them
+    int32 reduce_contacts(const vec3* points, const float* depths, int32 count, const vec3& normal, int32 (&out_indices)[4])
+    {
+        if (count <= 4)
+        {
+            for (int32 i = 0; i < count; ++i)
+            {
+                out_indices[i] = i;
+            }
+            return count;
+        }
+
+        int32 first = 0;
+        for (int32 i = 1; i < count; ++i)
+        {
+            first = depths[i] > depths[first] ? i : first;
+        }
+
+        int32 second = first == 0 ? 1 : 0;
+        for (int32 i = 0; i < count; ++i)
+        {
+            if ((points[i] - points[first]).length_squared() > (points[second] - points[first]).length_squared())
+            {
+                second = i;
+            }
+        }
+
+        auto signed_area = [&](int32 a, int32 b, const vec3& p) {
+            return (points[b] - points[a]).cross(p - points[a]).dot(normal);
+        };
+
+        int32 third = -1;
+        float third_area = 0.0f;
+        for (int32 i = 0; i < count; ++i)
+        {
+            const float area = fabs(signed_area(first, second, points[i]));
+            if (i != first && i != second && (third < 0 || area > third_area))
+            {
+                third = i;
+                third_area = area;
+            }
+        }
+
+        // Outside the triangle is where an edge's area goes negative, the most negative adds the most
+        const float winding = signed_area(first, second, points[third]) < 0.0f ? -1.0f : 1.0f;
+        int32 fourth = -1;
+        float fourth_area = 0.0f;
+        for (int32 i = 0; i < count; ++i)
+        {
+            if (i == first || i == second || i == third)
+            {
+                continue;
+            }
+
+            const float area = std::min(winding * signed_area(first, second, points[i]),
+                std::min(winding * signed_area(second, third, points[i]), winding * signed_area(third, first, points[i])));
+            if (fourth < 0 || area < fourth_area)
+            {
+                fourth = i;
+                fourth_area = area;
+            }
+        }
+
+        out_indices[0] = first;
+        out_indices[1] = second;
+        out_indices[2] = third;
+        out_indices[3] = fourth;
+        return 4;
+    }
 };
 
 namespace Collision_Test_Function
@@ -1020,8 +1421,205 @@ namespace Collision_Test_Function
         assert(a.type == Collider::Box);
         assert(b.type == Collider::Box);
 
-        assert(false);
-        return false;
+        const mat4 rot_a = o_a.to_mat4();
+        const mat4 rot_b = o_b.to_mat4();
+        const vec3 axes_a[3] = { rot_a[0].xyz.normalized(), rot_a[1].xyz.normalized(), rot_a[2].xyz.normalized() };
+        const vec3 axes_b[3] = { rot_b[0].xyz.normalized(), rot_b[1].xyz.normalized(), rot_b[2].xyz.normalized() };
+        const vec3 extents_a = a.shape.bounding_box.get_half_extents();
+        const vec3 extents_b = b.shape.bounding_box.get_half_extents();
+        const vec3 delta = p_b - p_a;
+
+        // Step 1: Separating axes, the 3 + 3 face normals and the 9 edge pairs.
+        // Face axes are tested first and the others only take over when clearly shallower,
+        // so resting boxes keep a face manifold instead of flickering to an edge
+        float min_penetration = FLT_MAX;
+        vec3 best_axis = vec3::zero_vector;
+        int32 best_index = -1;
+
+        auto test_axis = [&](const vec3& axis, int32 index) -> bool
+        {
+            float radius_a = 0.0f;
+            float radius_b = 0.0f;
+            for (int32 i = 0; i < 3; ++i)
+            {
+                radius_a += extents_a[i] * fabs(axes_a[i].dot(axis));
+                radius_b += extents_b[i] * fabs(axes_b[i].dot(axis));
+            }
+
+            const float distance = delta.dot(axis);
+            const float penetration = radius_a + radius_b - fabs(distance);
+            if (penetration < 0.0f)
+            {
+                return false;
+            }
+
+            const bool same_kind = (index < 3 ? 0 : index < 6 ? 1 : 2) == (best_index < 3 ? 0 : best_index < 6 ? 1 : 2);
+            const bool is_better = same_kind ? penetration < min_penetration : penetration < min_penetration * 0.95f - 0.01f;
+            if (best_index < 0 || is_better)
+            {
+                min_penetration = penetration;
+                best_axis = distance < 0.0f ? -axis : axis;
+                best_index = index;
+            }
+            return true;
+        };
+
+        for (int32 i = 0; i < 3; ++i)
+        {
+            if (!test_axis(axes_a[i], i))
+            {
+                return false;
+            }
+        }
+
+        for (int32 i = 0; i < 3; ++i)
+        {
+            if (!test_axis(axes_b[i], 3 + i))
+            {
+                return false;
+            }
+        }
+
+        for (int32 i = 0; i < 3; ++i)
+        {
+            for (int32 j = 0; j < 3; ++j)
+            {
+                // Parallel edges, the face axes already cover that direction
+                const vec3 axis = axes_a[i].cross(axes_b[j]);
+                const float length = axis.length();
+                if (length < 1e-5f)
+                {
+                    continue;
+                }
+
+                if (!test_axis(axis / length, 6 + i * 3 + j))
+                {
+                    return false;
+                }
+            }
+        }
+
+        result.normal = best_axis;
+        result.penetration = min_penetration;
+
+        // Step 2a: Edge against edge, one point between the two closest edges
+        if (best_index >= 6)
+        {
+            const int32 edge_a = (best_index - 6) / 3;
+            const int32 edge_b = (best_index - 6) % 3;
+
+            vec3 center_a = p_a;
+            vec3 center_b = p_b;
+            for (int32 i = 0; i < 3; ++i)
+            {
+                if (i != edge_a)
+                {
+                    center_a += axes_a[i] * (axes_a[i].dot(best_axis) > 0.0f ? extents_a[i] : -extents_a[i]);
+                }
+                if (i != edge_b)
+                {
+                    center_b += axes_b[i] * (axes_b[i].dot(best_axis) < 0.0f ? extents_b[i] : -extents_b[i]);
+                }
+            }
+
+            vec3 closest_a, closest_b;
+            Collision_Helpers::closest_point_on_two_segments(
+                center_a - axes_a[edge_a] * extents_a[edge_a], center_a + axes_a[edge_a] * extents_a[edge_a],
+                center_b - axes_b[edge_b] * extents_b[edge_b], center_b + axes_b[edge_b] * extents_b[edge_b],
+                closest_a, closest_b);
+
+            result.contact_point = (closest_a + closest_b) * 0.5f;
+            result.contact_points[0] = result.contact_point;
+            result.contact_count = 1;
+            return true;
+        }
+
+        // Step 2b: Face against face. The reference face belongs to the box whose axis won,
+        // the incident face is the other box's face pointing most against it
+        const bool reference_is_a = best_index < 3;
+        const vec3* reference_axes = reference_is_a ? axes_a : axes_b;
+        const vec3* incident_axes = reference_is_a ? axes_b : axes_a;
+        const vec3 reference_extents = reference_is_a ? extents_a : extents_b;
+        const vec3 incident_extents = reference_is_a ? extents_b : extents_a;
+        const vec3& reference_position = reference_is_a ? p_a : p_b;
+        const vec3& incident_position = reference_is_a ? p_b : p_a;
+        const vec3 reference_normal = reference_is_a ? best_axis : -best_axis;
+        const int32 reference_axis = best_index % 3;
+
+        int32 incident_axis = 0;
+        for (int32 i = 1; i < 3; ++i)
+        {
+            if (fabs(incident_axes[i].dot(reference_normal)) > fabs(incident_axes[incident_axis].dot(reference_normal)))
+            {
+                incident_axis = i;
+            }
+        }
+
+        const vec3 incident_normal = incident_axes[incident_axis].dot(reference_normal) > 0.0f
+            ? -incident_axes[incident_axis] : incident_axes[incident_axis];
+        const vec3 incident_center = incident_position + incident_normal * incident_extents[incident_axis];
+        const int32 u = (incident_axis + 1) % 3;
+        const int32 v = (incident_axis + 2) % 3;
+        const vec3 incident_u = incident_axes[u] * incident_extents[u];
+        const vec3 incident_v = incident_axes[v] * incident_extents[v];
+
+        // Every clipping plane adds at most one point, 4 + 4
+        vec3 polygon[8] = {
+            incident_center + incident_u + incident_v,
+            incident_center - incident_u + incident_v,
+            incident_center - incident_u - incident_v,
+            incident_center + incident_u - incident_v,
+        };
+        vec3 clipped[8];
+        int32 count = 4;
+
+        for (int32 side = 1; side < 3 && count > 0; ++side)
+        {
+            const int32 i = (reference_axis + side) % 3;
+            const vec3& axis = reference_axes[i];
+            const float center = axis.dot(reference_position);
+
+            count = Collision_Helpers::clip_polygon(polygon, count, axis, center + reference_extents[i], clipped);
+            count = Collision_Helpers::clip_polygon(clipped, count, -axis, -center + reference_extents[i], polygon);
+        }
+
+        // Step 3: Keep what's below the reference face, halfway between the two surfaces
+        const float reference_offset = reference_normal.dot(reference_position) + reference_extents[reference_axis];
+        vec3 points[8];
+        float depths[8];
+        int32 point_count = 0;
+        for (int32 i = 0; i < count; ++i)
+        {
+            const float depth = reference_offset - reference_normal.dot(polygon[i]);
+            if (depth >= 0.0f)
+            {
+                points[point_count] = polygon[i] + reference_normal * (depth * 0.5f);
+                depths[point_count] = depth;
+                ++point_count;
+            }
+        }
+
+        // Clipping lost everything to round off, the axes still say they overlap
+        if (point_count == 0)
+        {
+            result.contact_point = incident_center + reference_normal * (min_penetration * 0.5f);
+            result.contact_points[0] = result.contact_point;
+            result.contact_count = 1;
+            return true;
+        }
+
+        int32 indices[4];
+        result.contact_count = Collision_Helpers::reduce_contacts(points, depths, point_count, reference_normal, indices);
+
+        result.contact_point = vec3::zero_vector;
+        for (int32 i = 0; i < result.contact_count; ++i)
+        {
+            result.contact_points[i] = points[indices[i]];
+            result.contact_point += points[indices[i]];
+        }
+        result.contact_point = result.contact_point / static_cast<float>(result.contact_count);
+
+        return true;
     }
 
     bool box_convex(const Collider& a, const vec3& p_a, const quat& o_a, const Collider& b, const vec3& p_b, const quat& o_b, Collision_Result& result)
@@ -1031,8 +1629,10 @@ namespace Collision_Test_Function
         assert(a.type == Collider::Box);
         assert(b.type == Collider::Convex_Hull);
 
-        assert(false);
-        return false;
+        Collision_Helpers::Convex_Support support_a(a.shape.bounding_box.get_half_extents(), p_a, o_a);
+        Collision_Helpers::Convex_Support support_b(Convex_Hull_Pool::get().get_hull(b.convex_hull), p_b, o_b);
+
+        return Collision_Helpers::gjk_epa(support_a, support_b, p_b - p_a, result);
     }
 
     bool convex_sphere(const Collider& a, const vec3& p_a, const quat& o_a, const Collider& b, const vec3& p_b, const quat& o_b, Collision_Result& result)
@@ -1107,22 +1707,12 @@ namespace Collision_Test_Function
         assert(a.type == Collider::Convex_Hull);
         assert(b.type == Collider::Convex_Hull);
 
-        const int32 count_a = a.shape.convex_hull.count;
-        const vec3 (&vertices_a)[CONVEX_HULL_MAX_NUM_VERTICES] = a.shape.convex_hull.vertices;
-        
-        const int32 count_b = b.shape.convex_hull.count;
-        const vec3 (&vertices_b)[CONVEX_HULL_MAX_NUM_VERTICES] = b.shape.convex_hull.vertices;
-
-        vec3 simplex[4];
+        Collision_Helpers::Convex_Support support_a(Convex_Hull_Pool::get().get_hull(a.convex_hull), p_a, o_a);
+        Collision_Helpers::Convex_Support support_b(Convex_Hull_Pool::get().get_hull(b.convex_hull), p_b, o_b);
 
         AABB combined_bounds = a.bounds;
         combined_bounds.expand(b.bounds);
 
-        if (!Collision_Helpers::gjk(vertices_a, count_a, p_a, o_a, vertices_b, count_b, p_b, o_b, combined_bounds.max, simplex))
-        {
-            return false;
-        }
-
-        return Collision_Helpers::epa(vertices_a, count_a, p_a, o_a, vertices_b, count_b, p_b, o_b, simplex, result);
+        return Collision_Helpers::gjk_epa(support_a, support_b, combined_bounds.max, result);
     }
 }
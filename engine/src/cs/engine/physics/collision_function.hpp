@@ -11,6 +11,20 @@
 
 struct Collider;
 struct Collision_Result;
+
+// What the last GJK run of a pair ended with, the pair's next run starts from there
+struct Gjk_Cache
+{
+    // Hull vertices behind the last simplex, a tetrahedron around the origin if the pair
+    // was touching, otherwise only the last support. 0 before the first run
+    int32 vertices_a[4];
+    int32 vertices_b[4];
+    int32 count { 0 };
+    // The direction GJK gave up in, nothing of a - b reached past the origin along it
+    vec3 separating_axis { vec3::zero_vector };
+    bool is_separated { false };
+};
+
 namespace Collision_Test_Function
 {
     typedef bool (*Definition)(const Collider& a, const vec3& p_a, const quat& o_a, const Collider& b, const vec3& p_b, const quat& o_b, Collision_Result& result);
@@ -45,4 +59,7 @@ namespace Collision_Test_Function
 namespace Collision_Helpers
 {
     mat4 inertia_tensor(const Collider& collider, const float mass);
+    // Boolean GJK of a cylinder or hull collider against a world aligned box or a sphere, for scene queries
+    bool overlaps_bounds(const Collider& collider, const vec3& p, const quat& o, const AABB& bounds);
+    bool overlaps_sphere(const Collider& collider, const vec3& p, const quat& o, const vec3& center, float radius);
 };
@@ -0,0 +1,465 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/engine/physics/physics_body_store.hpp"
+#include "cs/math/simd.hpp"
+
+#include <cmath>
+
+namespace
+{
+    void clamp_length(vec3& v, float max_length)
+    {
+        const float length_squared = v.length_squared();
+        if (length_squared > max_length * max_length)
+        {
+            v *= max_length / sqrtf(length_squared);
+        }
+    }
+
+#ifdef CS_SSE2
+    struct Quat_Lanes
+    {
+        __m128 x, y, z, w;
+    };
+
+    Quat_Lanes load_quats(const quat* q)
+    {
+        const float* data = reinterpret_cast<const float*>(q);
+        Quat_Lanes lanes {
+            _mm_loadu_ps(data), _mm_loadu_ps(data + 4), _mm_loadu_ps(data + 8), _mm_loadu_ps(data + 12)
+        };
+        _MM_TRANSPOSE4_PS(lanes.x, lanes.y, lanes.z, lanes.w);
+        return lanes;
+    }
+
+    void store_quats(quat* q, Quat_Lanes lanes)
+    {
+        float* data = reinterpret_cast<float*>(q);
+        _MM_TRANSPOSE4_PS(lanes.x, lanes.y, lanes.z, lanes.w);
+        _mm_storeu_ps(data, lanes.x);
+        _mm_storeu_ps(data + 4, lanes.y);
+        _mm_storeu_ps(data + 8, lanes.z);
+        _mm_storeu_ps(data + 12, lanes.w);
+    }
+
+    __m128 select(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    Vec3_Lanes select(__m128 mask, const Vec3_Lanes& a, const Vec3_Lanes& b)
+    {
+        return { select(mask, a.x, b.x), select(mask, a.y, b.y), select(mask, a.z, b.z) };
+    }
+
+    Vec3_Lanes mul_add(const Vec3_Lanes& a, const Vec3_Lanes& b, __m128 s)
+    {
+        return { _mm_add_ps(a.x, _mm_mul_ps(b.x, s)), _mm_add_ps(a.y, _mm_mul_ps(b.y, s)), _mm_add_ps(a.z, _mm_mul_ps(b.z, s)) };
+    }
+
+    Vec3_Lanes mul(const Vec3_Lanes& a, __m128 s)
+    {
+        return { _mm_mul_ps(a.x, s), _mm_mul_ps(a.y, s), _mm_mul_ps(a.z, s) };
+    }
+
+    __m128 dot(const Vec3_Lanes& a, const Vec3_Lanes& b)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+    }
+
+    Vec3_Lanes clamp_length(const Vec3_Lanes& v, __m128 max_length)
+    {
+        const __m128 length_squared = dot(v, v);
+        const __m128 too_fast = _mm_cmpgt_ps(length_squared, _mm_mul_ps(max_length, max_length));
+        if (_mm_movemask_ps(too_fast) == 0)
+        {
+            return v;
+        }
+
+        return select(too_fast, mul(v, _mm_div_ps(max_length, _mm_sqrt_ps(length_squared))), v);
+    }
+
+    __m128 load_mask(const bool* flags)
+    {
+        return _mm_castsi128_ps(_mm_setr_epi32(-int32(flags[0]), -int32(flags[1]), -int32(flags[2]), -int32(flags[3])));
+    }
+
+    __m128 load_type_mask(const Physics_Body_Type::Type* types, Physics_Body_Type::Type type)
+    {
+        return _mm_castsi128_ps(_mm_setr_epi32(-int32(types[0] == type), -int32(types[1] == type), -int32(types[2] == type), -int32(types[3] == type)));
+    }
+
+    // Same matrix as quat::to_mat4, rotation[column][row]
+    void get_rotations(const Quat_Lanes& q, __m128 (&out_rotation)[3][3])
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+
+        const __m128 xx = _mm_mul_ps(q.x, q.x);
+        const __m128 yy = _mm_mul_ps(q.y, q.y);
+        const __m128 zz = _mm_mul_ps(q.z, q.z);
+        const __m128 xy = _mm_mul_ps(q.x, q.y);
+        const __m128 xz = _mm_mul_ps(q.x, q.z);
+        const __m128 yz = _mm_mul_ps(q.y, q.z);
+        const __m128 wx = _mm_mul_ps(q.w, q.x);
+        const __m128 wy = _mm_mul_ps(q.w, q.y);
+        const __m128 wz = _mm_mul_ps(q.w, q.z);
+
+        out_rotation[0][0] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz)));
+        out_rotation[1][0] = _mm_mul_ps(two, _mm_add_ps(xy, wz));
+        out_rotation[2][0] = _mm_mul_ps(two, _mm_sub_ps(xz, wy));
+
+        out_rotation[0][1] = _mm_mul_ps(two, _mm_sub_ps(xy, wz));
+        out_rotation[1][1] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz)));
+        out_rotation[2][1] = _mm_mul_ps(two, _mm_add_ps(yz, wx));
+
+        out_rotation[0][2] = _mm_mul_ps(two, _mm_add_ps(xz, wy));
+        out_rotation[1][2] = _mm_mul_ps(two, _mm_sub_ps(yz, wx));
+        out_rotation[2][2] = _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy)));
+    }
+
+    // matrix * v, or its transpose
+    Vec3_Lanes mul(const __m128 (&matrix)[3][3], const Vec3_Lanes& v, bool transposed)
+    {
+        __m128 result[3];
+        for (int32 row = 0; row < 3; ++row)
+        {
+            const __m128 a = transposed ? matrix[row][0] : matrix[0][row];
+            const __m128 b = transposed ? matrix[row][1] : matrix[1][row];
+            const __m128 c = transposed ? matrix[row][2] : matrix[2][row];
+            result[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, v.x), _mm_mul_ps(b, v.y)), _mm_mul_ps(c, v.z));
+        }
+        return { result[0], result[1], result[2] };
+    }
+#endif
+}
+
+int64 Physics_Body_Store::add()
+{
+    types.push_back(Physics_Body_Type::None);
+
+    positions.push_back(vec3::zero_vector);
+    orientations.push_back(quat::zero_quat);
+
+    linear_velocities.push_back(vec3::zero_vector);
+    angular_velocities.push_back(vec3::zero_vector);
+    accumulated_forces.push_back(vec3::zero_vector);
+    accumulated_torques.push_back(vec3::zero_vector);
+
+    inverse_masses.push_back(1.0f);
+    inverse_inertia_tensors.push_back(mat4(1.0f));
+
+    linear_dampings.push_back(0.001f);
+    angular_dampings.push_back(0.01f);
+    max_linear_velocities.push_back(FLT_MAX);
+    max_angular_velocities.push_back(FLT_MAX);
+
+    awake.push_back(true);
+    sleep_timers.push_back(0.0f);
+    sleep_time_thresholds.push_back(2.0f);
+    sleep_linear_velocity_thresholds.push_back(0.1f);
+    sleep_angular_velocity_thresholds.push_back(0.1f);
+
+    dirty.push_back(false);
+
+    return size() - 1;
+}
+
+void Physics_Body_Store::swap_remove(int64 index)
+{
+    types.swap_remove(index);
+
+    positions.swap_remove(index);
+    orientations.swap_remove(index);
+
+    linear_velocities.swap_remove(index);
+    angular_velocities.swap_remove(index);
+    accumulated_forces.swap_remove(index);
+    accumulated_torques.swap_remove(index);
+
+    inverse_masses.swap_remove(index);
+    inverse_inertia_tensors.swap_remove(index);
+
+    linear_dampings.swap_remove(index);
+    angular_dampings.swap_remove(index);
+    max_linear_velocities.swap_remove(index);
+    max_angular_velocities.swap_remove(index);
+
+    awake.swap_remove(index);
+    sleep_timers.swap_remove(index);
+    sleep_time_thresholds.swap_remove(index);
+    sleep_linear_velocity_thresholds.swap_remove(index);
+    sleep_angular_velocity_thresholds.swap_remove(index);
+
+    dirty.swap_remove(index);
+}
+
+void Physics_Body_Store::clear()
+{
+    types.clear();
+
+    positions.clear();
+    orientations.clear();
+
+    linear_velocities.clear();
+    angular_velocities.clear();
+    accumulated_forces.clear();
+    accumulated_torques.clear();
+
+    inverse_masses.clear();
+    inverse_inertia_tensors.clear();
+
+    linear_dampings.clear();
+    angular_dampings.clear();
+    max_linear_velocities.clear();
+    max_angular_velocities.clear();
+
+    awake.clear();
+    sleep_timers.clear();
+    sleep_time_thresholds.clear();
+    sleep_linear_velocity_thresholds.clear();
+    sleep_angular_velocity_thresholds.clear();
+
+    dirty.clear();
+}
+
+void Physics_Body_Store::integrate_velocities(float dt, int64 begin, int64 end)
+{
+    assert(begin >= 0 && end <= size());
+
+    int64 index = begin;
+
+#ifdef CS_SSE2
+    const __m128 dt_lanes = _mm_set1_ps(dt);
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    for (; index + 4 <= end; index += 4)
+    {
+        const __m128 is_awake = load_mask(&awake[index]);
+        if (_mm_movemask_ps(is_awake) == 0)
+        {
+            continue;
+        }
+
+        const __m128 is_integrated = _mm_and_ps(is_awake, load_type_mask(&types[index], Physics_Body_Type::Dynamic));
+        if (_mm_movemask_ps(is_integrated) != 0)
+        {
+            const Vec3_Lanes linear_velocity = load_vec3s(&linear_velocities[index]);
+            Vec3_Lanes new_linear_velocity = mul_add(linear_velocity, load_vec3s(&accumulated_forces[index]), dt_lanes);
+            new_linear_velocity = mul(new_linear_velocity, _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(dt_lanes, _mm_loadu_ps(&linear_dampings[index])))));
+            new_linear_velocity = clamp_length(new_linear_velocity, _mm_loadu_ps(&max_linear_velocities[index]));
+            store_vec3s(&linear_velocities[index], select(is_integrated, new_linear_velocity, linear_velocity));
+
+            // Torque goes into the body's frame, through the inertia and back out
+            __m128 rotation[3][3];
+            get_rotations(load_quats(&orientations[index]), rotation);
+
+            __m128 inverse_inertia[3][3];
+            for (int32 column = 0; column < 3; ++column)
+            {
+                for (int32 row = 0; row < 3; ++row)
+                {
+                    inverse_inertia[column][row] = _mm_setr_ps(
+                        inverse_inertia_tensors[index][column][row], inverse_inertia_tensors[index + 1][column][row],
+                        inverse_inertia_tensors[index + 2][column][row], inverse_inertia_tensors[index + 3][column][row]);
+                }
+            }
+
+            const Vec3_Lanes local_torque = mul(rotation, load_vec3s(&accumulated_torques[index]), true);
+            const Vec3_Lanes angular_acceleration = mul(rotation, mul(inverse_inertia, local_torque, false), false);
+
+            const Vec3_Lanes angular_velocity = load_vec3s(&angular_velocities[index]);
+            Vec3_Lanes new_angular_velocity = mul_add(angular_velocity, angular_acceleration, dt_lanes);
+            new_angular_velocity = mul(new_angular_velocity, _mm_div_ps(one, _mm_add_ps(one, _mm_mul_ps(dt_lanes, _mm_loadu_ps(&angular_dampings[index])))));
+            new_angular_velocity = clamp_length(new_angular_velocity, _mm_loadu_ps(&max_angular_velocities[index]));
+            store_vec3s(&angular_velocities[index], select(is_integrated, new_angular_velocity, angular_velocity));
+        }
+
+        const __m128 zero = _mm_setzero_ps();
+        const Vec3_Lanes zero_vectors { zero, zero, zero };
+        store_vec3s(&accumulated_forces[index], select(is_awake, zero_vectors, load_vec3s(&accumulated_forces[index])));
+        store_vec3s(&accumulated_torques[index], select(is_awake, zero_vectors, load_vec3s(&accumulated_torques[index])));
+    }
+#endif
+
+    for (; index < end; ++index)
+    {
+        _integrate_velocities(dt, index);
+    }
+}
+
+void Physics_Body_Store::integrate_transforms(float dt, int64 begin, int64 end, Dynamic_Array<uint32>& out_sleep_changes)
+{
+    assert(begin >= 0 && end <= size());
+
+    int64 index = begin;
+
+#ifdef CS_SSE2
+    const __m128 dt_lanes = _mm_set1_ps(dt);
+    const __m128 half_dt = _mm_set1_ps(dt * 0.5f);
+
+    for (; index + 4 <= end; index += 4)
+    {
+        const __m128 is_dynamic = load_type_mask(&types[index], Physics_Body_Type::Dynamic);
+        const int32 dynamic_bits = _mm_movemask_ps(is_dynamic);
+        if (dynamic_bits == 0)
+        {
+            continue;
+        }
+
+        const Vec3_Lanes linear_velocity = load_vec3s(&linear_velocities[index]);
+        const Vec3_Lanes angular_velocity = load_vec3s(&angular_velocities[index]);
+
+        const Vec3_Lanes position = load_vec3s(&positions[index]);
+        store_vec3s(&positions[index], select(is_dynamic, mul_add(position, linear_velocity, dt_lanes), position));
+
+        // orientation.mul(quat(angular_velocity * 0.5 * dt, 1)), normalized
+        const Quat_Lanes q = load_quats(&orientations[index]);
+        const Vec3_Lanes h = mul(angular_velocity, half_dt);
+        Quat_Lanes rotated {
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(h.x, q.w), q.x), _mm_sub_ps(_mm_mul_ps(q.y, h.z), _mm_mul_ps(q.z, h.y))),
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(h.y, q.w), q.y), _mm_sub_ps(_mm_mul_ps(q.z, h.x), _mm_mul_ps(q.x, h.z))),
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(h.z, q.w), q.z), _mm_sub_ps(_mm_mul_ps(q.x, h.y), _mm_mul_ps(q.y, h.x))),
+            _mm_sub_ps(q.w, dot({ q.x, q.y, q.z }, h))
+        };
+        const __m128 inverse_length = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_add_ps(
+            dot({ rotated.x, rotated.y, rotated.z }, { rotated.x, rotated.y, rotated.z }), _mm_mul_ps(rotated.w, rotated.w))));
+        rotated = {
+            select(is_dynamic, _mm_mul_ps(rotated.x, inverse_length), q.x),
+            select(is_dynamic, _mm_mul_ps(rotated.y, inverse_length), q.y),
+            select(is_dynamic, _mm_mul_ps(rotated.z, inverse_length), q.z),
+            select(is_dynamic, _mm_mul_ps(rotated.w, inverse_length), q.w)
+        };
+        store_quats(&orientations[index], rotated);
+
+        for (int32 lane = 0; lane < 4; ++lane)
+        {
+            if (dynamic_bits & (1 << lane))
+            {
+                dirty[index + lane] = true;
+            }
+        }
+
+        // Slow awake bodies count down to sleep, fast sleeping ones wake up
+        const __m128 linear_threshold = _mm_loadu_ps(&sleep_linear_velocity_thresholds[index]);
+        const __m128 angular_threshold = _mm_loadu_ps(&sleep_angular_velocity_thresholds[index]);
+        const __m128 is_moving = _mm_or_ps(
+            _mm_cmpgt_ps(dot(linear_velocity, linear_velocity), _mm_mul_ps(linear_threshold, linear_threshold)),
+            _mm_cmpgt_ps(dot(angular_velocity, angular_velocity), _mm_mul_ps(angular_threshold, angular_threshold)));
+
+        const __m128 is_awake = load_mask(&awake[index]);
+        const __m128 is_resting = _mm_and_ps(_mm_andnot_ps(is_moving, is_awake), is_dynamic);
+        const __m128 sleep_timer = _mm_add_ps(_mm_loadu_ps(&sleep_timers[index]), _mm_and_ps(is_resting, dt_lanes));
+        _mm_storeu_ps(&sleep_timers[index], sleep_timer);
+
+        const __m128 falls_asleep = _mm_and_ps(is_resting, _mm_cmpge_ps(sleep_timer, _mm_loadu_ps(&sleep_time_thresholds[index])));
+        const __m128 wakes_up = _mm_andnot_ps(is_awake, _mm_and_ps(is_moving, is_dynamic));
+        const int32 fall_bits = _mm_movemask_ps(falls_asleep);
+        const int32 wake_bits = _mm_movemask_ps(wakes_up);
+        if ((fall_bits | wake_bits) == 0)
+        {
+            continue;
+        }
+
+        for (int32 lane = 0; lane < 4; ++lane)
+        {
+            if (fall_bits & (1 << lane))
+            {
+                _fall_asleep(index + lane, out_sleep_changes);
+            }
+            else if (wake_bits & (1 << lane))
+            {
+                _wake_up(index + lane, out_sleep_changes);
+            }
+        }
+    }
+#endif
+
+    for (; index < end; ++index)
+    {
+        _integrate_transform(dt, index, out_sleep_changes);
+    }
+}
+
+void Physics_Body_Store::_integrate_velocities(float dt, int64 index)
+{
+    if (!awake[index])
+    {
+        return;
+    }
+
+    if (types[index] == Physics_Body_Type::Dynamic)
+    {
+        vec3& linear_velocity = linear_velocities[index];
+        linear_velocity += accumulated_forces[index] * dt;
+        linear_velocity *= 1.0f / (1.0f + dt * linear_dampings[index]);
+        clamp_length(linear_velocity, max_linear_velocities[index]);
+
+        const mat4 rotation = orientations[index].to_mat4();
+        const mat4& inverse_inertia = inverse_inertia_tensors[index];
+        const vec3& torque = accumulated_torques[index];
+        const vec3 local_torque(rotation[0].xyz.dot(torque), rotation[1].xyz.dot(torque), rotation[2].xyz.dot(torque));
+        const vec3 local_acceleration = inverse_inertia[0].xyz * local_torque.x + inverse_inertia[1].xyz * local_torque.y + inverse_inertia[2].xyz * local_torque.z;
+
+        vec3& angular_velocity = angular_velocities[index];
+        angular_velocity += (rotation[0].xyz * local_acceleration.x + rotation[1].xyz * local_acceleration.y + rotation[2].xyz * local_acceleration.z) * dt;
+        angular_velocity *= 1.0f / (1.0f + dt * angular_dampings[index]);
+        clamp_length(angular_velocity, max_angular_velocities[index]);
+    }
+
+    accumulated_forces[index] = vec3::zero_vector;
+    accumulated_torques[index] = vec3::zero_vector;
+}
+
+void Physics_Body_Store::_integrate_transform(float dt, int64 index, Dynamic_Array<uint32>& out_sleep_changes)
+{
+    if (types[index] != Physics_Body_Type::Dynamic)
+    {
+        return;
+    }
+
+    const vec3& linear_velocity = linear_velocities[index];
+    const vec3& angular_velocity = angular_velocities[index];
+
+    positions[index] += linear_velocity * dt;
+    orientations[index] = orientations[index].mul(quat(angular_velocity * 0.5f * dt, 1.0f));
+    dirty[index] = true;
+
+    const float linear_threshold = sleep_linear_velocity_thresholds[index];
+    const float angular_threshold = sleep_angular_velocity_thresholds[index];
+    if (linear_velocity.length_squared() > linear_threshold * linear_threshold ||
+        angular_velocity.length_squared() > angular_threshold * angular_threshold)
+    {
+        if (!awake[index])
+        {
+            _wake_up(index, out_sleep_changes);
+        }
+    }
+    else if (awake[index])
+    {
+        sleep_timers[index] += dt;
+        if (sleep_timers[index] >= sleep_time_thresholds[index])
+        {
+            _fall_asleep(index, out_sleep_changes);
+        }
+    }
+}
+
+void Physics_Body_Store::_wake_up(int64 index, Dynamic_Array<uint32>& out_sleep_changes)
+{
+    awake[index] = true;
+    sleep_timers[index] = 0.0f;
+    // Forces piled up while asleep don't count
+    accumulated_forces[index] = vec3::zero_vector;
+    accumulated_torques[index] = vec3::zero_vector;
+    out_sleep_changes.push_back(static_cast<uint32>(index));
+}
+
+void Physics_Body_Store::_fall_asleep(int64 index, Dynamic_Array<uint32>& out_sleep_changes)
+{
+    awake[index] = false;
+    linear_velocities[index] = vec3::zero_vector;
+    angular_velocities[index] = vec3::zero_vector;
+    out_sleep_changes.push_back(static_cast<uint32>(index));
+}
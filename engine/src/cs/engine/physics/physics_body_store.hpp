@@ -0,0 +1,84 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Per body state the step walks every time, one array per field.
+// Indexed like the bodies' Slot_Map values, adding and removing mirror its push and swap remove.
+// The integration kernels go over the arrays four bodies at a time, so a step only pulls in
+// the fields it reads instead of whole bodies with their colliders.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/math/math.hpp"
+#include "cs/containers/dynamic_array.hpp"
+
+namespace Physics_Body_Type
+{
+    enum Type : uint8
+    {
+        None,
+        // Static objects that won't change in shape, transform etc.
+        Static,
+        // Movable objects that are controlled by us
+        Kinematic,
+        // Movable objects that are controlled by the physics engine
+        Dynamic
+    };
+}
+
+class Physics_Body_Store
+{
+public:
+    Dynamic_Array<Physics_Body_Type::Type> types;
+
+    Dynamic_Array<vec3> positions;
+    Dynamic_Array<quat> orientations;
+
+    Dynamic_Array<vec3> linear_velocities;
+    Dynamic_Array<vec3> angular_velocities;
+    Dynamic_Array<vec3> accumulated_forces;
+    Dynamic_Array<vec3> accumulated_torques;
+
+    Dynamic_Array<float> inverse_masses;
+    // Only the rotation part is used
+    Dynamic_Array<mat4> inverse_inertia_tensors;
+
+    Dynamic_Array<float> linear_dampings;
+    Dynamic_Array<float> angular_dampings;
+    Dynamic_Array<float> max_linear_velocities;
+    Dynamic_Array<float> max_angular_velocities;
+
+    Dynamic_Array<bool> awake;
+    Dynamic_Array<float> sleep_timers;
+    Dynamic_Array<float> sleep_time_thresholds;
+    Dynamic_Array<float> sleep_linear_velocity_thresholds;
+    Dynamic_Array<float> sleep_angular_velocity_thresholds;
+
+    Dynamic_Array<bool> dirty;
+
+public:
+    int64 size() const { return types.size(); }
+
+    // Appends a body with the default state, returns its index
+    int64 add();
+    // The last body moves into index
+    void swap_remove(int64 index);
+    void clear();
+
+    // Awake dynamic bodies: forces and torques into velocities, then damping and clamping to
+    // the max velocities. Every awake body's forces and torques are cleared
+    void integrate_velocities(float dt, int64 begin, int64 end);
+
+    // Dynamic bodies: velocities into transforms, then the sleep checks. Appends the index of
+    // every body that fell asleep or woke up
+    void integrate_transforms(float dt, int64 begin, int64 end, Dynamic_Array<uint32>& out_sleep_changes);
+
+private:
+    // Scalar versions of the kernels, for what's left after the groups of four
+    void _integrate_velocities(float dt, int64 index);
+    void _integrate_transform(float dt, int64 index, Dynamic_Array<uint32>& out_sleep_changes);
+
+    void _wake_up(int64 index, Dynamic_Array<uint32>& out_sleep_changes);
+    void _fall_asleep(int64 index, Dynamic_Array<uint32>& out_sleep_changes);
+};
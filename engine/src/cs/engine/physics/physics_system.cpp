@@ -3,13 +3,37 @@
 
 #include "cs/engine/physics/physics_system.hpp"
 #include "cs/engine/renderer/renderer.hpp"
+#include "cs/engine/thread_pool.hpp"
 
-AABB Physics_Body::get_transformed_bounds() const
+#include <algorithm>
+
+namespace
 {
-    vec3 center = collider.bounds.get_center();
-    vec3 half_extents = collider.bounds.get_half_extents();
-    center += transform.position;
-    const mat4 rot = transform.orientation.to_mat4();
+    // Queries are cheap one by one, chunks need a few of them to be worth a worker
+    constexpr int64 query_chunk_size = 16;
+
+    // Point where three planes meet, false when two of them are parallel
+    bool intersect_planes(const vec4& a, const vec4& b, const vec4& c, vec3& out_point)
+    {
+        const vec3 b_cross_c = b.xyz.cross(c.xyz);
+        const float determinant = a.xyz.dot(b_cross_c);
+        if (fabs(determinant) < NEARLY_ZERO)
+        {
+            return false;
+        }
+
+        out_point = (b_cross_c * -a.w - c.xyz.cross(a.xyz) * b.w - a.xyz.cross(b.xyz) * c.w) / determinant;
+        return std::isfinite(out_point.x) && std::isfinite(out_point.y) && std::isfinite(out_point.z);
+    }
+}
+
+AABB Collider::get_transformed_bounds(const vec3& position, const quat& orientation) const
+{
+    const mat4 rot = orientation.to_mat4();
+    // Hulls can be off center in their own frame, the offset turns with them
+    const vec3 local_center = bounds.get_center();
+    const vec3 center = position + rot[0].xyz * local_center.x + rot[1].xyz * local_center.y + rot[2].xyz * local_center.z;
+    const vec3 half_extents = bounds.get_half_extents();
 
     vec3 new_half_extents(
         fabs(rot[0].x) * half_extents.x + fabs(rot[1].x) * half_extents.y + fabs(rot[2].x) * half_extents.z,
@@ -20,87 +44,47 @@ AABB Physics_Body::get_transformed_bounds() const
     return { center - new_half_extents, center + new_half_extents };
 }
 
-void Physics_Body::update_state(float dt)
+Physics_Body::Physics_Body(Physics_Body_Data& data, Physics_Body_Store& store, int64 index)
+    : id(data.id), type(store.types[index]),
+    center_of_mass(data.center_of_mass), inverse_inertia_tensor(store.inverse_inertia_tensors[index]),
+    inverse_mass(store.inverse_masses[index]), restitution(data.restitution), dynamic_friction(data.dynamic_friction),
+    transform{ store.positions[index], store.orientations[index] }, old_transform(data.old_transform),
+    max_linear_velocity(store.max_linear_velocities[index]), linear_damping(store.linear_dampings[index]),
+    accumulated_forces(store.accumulated_forces[index]), linear_velocity(store.linear_velocities[index]),
+    max_angular_velocity(store.max_angular_velocities[index]), angular_damping(store.angular_dampings[index]),
+    accumulated_torque(store.accumulated_torques[index]), angular_velocity(store.angular_velocities[index]),
+    is_awake(store.awake[index]), sleep_timer(store.sleep_timers[index]), sleep_time_threshold(store.sleep_time_thresholds[index]),
+    sleep_linear_velocity_threshold(store.sleep_linear_velocity_thresholds[index]),
+    sleep_angular_velocity_threshold(store.sleep_angular_velocity_thresholds[index]),
+    collider(data.collider), dirty(store.dirty[index])
 {
-    if (!is_awake)
-    {
-        return;
-    }
-
-    const float linear_v_sq = linear_velocity.length_squared();
-    const float angular_v_sq = angular_velocity.length_squared();
-
-    if (type == Dynamic)
-    {
-        linear_velocity += accumulated_forces * dt;
-        if (linear_v_sq > max_linear_velocity * max_linear_velocity)
-        {
-            linear_velocity = linear_velocity.normalize() * max_linear_velocity;
-        }
-
-        const mat4 rot = transform.orientation.to_mat4();
-        angular_velocity += (rot * inverse_inertia_tensor * rot.transposed()) * accumulated_torque * dt;
-        
-        if (angular_v_sq > max_angular_velocity * max_angular_velocity)
-        {
-            angular_velocity = angular_velocity.normalize() * max_angular_velocity;
-        }
-        //printf("%s %s\n", linear_velocity.to_string("lv").c_str(), angular_velocity.to_string("lv").c_str());
-    }
-    else if (type == Kinematic)
-    {
-        linear_velocity = (transform.position - old_transform.position) / dt;
-        const quat delta = transform.orientation.mul(old_transform.orientation.conjugate()).normalized();
-        const float theta = 2.0f * acosf(delta.w);
-        const float s2t = sinf(theta * 0.5f);
-        if (!is_nearly_equal(s2t, 0))
-        {
-            angular_velocity = (delta.v / s2t) * (theta / dt);
-        }
-        else
-        {
-            angular_velocity = vec3::zero_vector;
-        }
-        old_transform = transform;
-    }
+}
 
-    accumulated_forces = vec3::zero_vector;
-    accumulated_torque = vec3::zero_vector;
+AABB Physics_Body::get_transformed_bounds() const
+{
+    return collider.get_transformed_bounds(transform.position, transform.orientation);
 }
 
-void Physics_Body::update_transform_euler(float dt)
+void Physics_Body::update_kinematic_state(float dt)
 {
-    if (type != Dynamic)
+    if (type != Kinematic || !is_awake)
     {
         return;
     }
-    
-    transform.position += linear_velocity * dt;
-    transform.orientation = transform.orientation.mul(quat(angular_velocity * 0.5f * dt, 1.0f));
-    transform.orientation.normalize();
-
-    dirty = true;
 
-    const float linear_v_sq = linear_velocity.length_squared();
-    const float angular_v_sq = angular_velocity.length_squared();
-
-    if (linear_v_sq > (sleep_linear_velocity_threshold * sleep_linear_velocity_threshold) ||
-    angular_v_sq > (sleep_angular_velocity_threshold * sleep_angular_velocity_threshold) )
+    linear_velocity = (transform.position - old_transform.position) / dt;
+    const quat delta = transform.orientation.mul(old_transform.orientation.conjugate()).normalized();
+    const float theta = 2.0f * acosf(delta.w);
+    const float s2t = sinf(theta * 0.5f);
+    if (!is_nearly_equal(s2t, 0))
     {
-        wake_up();
+        angular_velocity = (delta.v / s2t) * (theta / dt);
     }
-    else if (is_awake)
+    else
     {
-        sleep_timer += dt;
-        //printf("sleep_timer: %f\n", sleep_timer);
-        if (sleep_timer >= sleep_time_threshold)
-        {
-            printf("%s is now asleep.\n", id.c_str());
-            is_awake = false;
-            linear_velocity = vec3::zero_vector;
-            angular_velocity = vec3::zero_vector;
-        }
+        angular_velocity = vec3::zero_vector;
     }
+    old_transform = { transform.position, transform.orientation };
 }
 
 void Physics_Body::wake_up()
@@ -173,23 +157,88 @@ Physics_System* Singleton<Physics_System>::_singleton { nullptr };
 void Physics_System::initialize()
 {
     _init_collision_functions();
+
+    if (!_broadphase)
+    {
+        set_broadphase(Broadphase_Type::Uniform_Grid);
+    }
 }
 
-Physics_Body& Physics_System::get_body(const Name_Id& in_id)
+void Physics_System::set_broadphase(Broadphase_Type::Type type)
 {
-    if (_id_to_index.find(in_id) != _id_to_index.end())
+    if (_broadphase && _broadphase->get_type() == type)
     {
-        return _bodies[_id_to_index[in_id]];
+        return;
     }
 
-    int64 new_index = _bodies.size();
-    _id_to_index[in_id] = new_index;
-    
-    Physics_Body body;
+    switch (type)
+    {
+    case Broadphase_Type::Uniform_Grid:
+        _broadphase = Shared_Ptr<Spatial_Hash_Grid>::create(1.50f);
+        break;
+    case Broadphase_Type::Hierarchical_Grid:
+        // Finest level matches the uniform grid, so small bodies behave the same in both
+        _broadphase = Shared_Ptr<Hierarchical_Hash_Grid>::create(1.50f);
+        break;
+    case Broadphase_Type::AABB_Tree:
+        _broadphase = Shared_Ptr<Dynamic_AABB_Tree>::create();
+        break;
+    case Broadphase_Type::Sweep_And_Prune:
+        _broadphase = Shared_Ptr<Sweep_And_Prune>::create();
+        break;
+    default:
+        printf("Unknown broadphase type %d\n", type);
+        return;
+    }
+
+    _broadphase->set_thread_pool(Thread_Pool::get_ptr());
+    _broadphase_collision_pairs.clear();
+}
+
+Physics_Body Physics_System::get_body(const Name_Id& in_id)
+{
+    return _get_body_at(_bodies.get_index(get_body_handle(in_id)));
+}
+
+Physics_Body_Handle Physics_System::get_body_handle(const Name_Id& in_id)
+{
+    Physics_Body_Handle handle;
+    if (_id_to_handle.find(in_id, handle))
+    {
+        return handle;
+    }
+
+    Physics_Body_Data body;
     body.id = in_id;
 
-    _bodies.push_back(body);
-    return _bodies[new_index];
+    handle = _bodies.insert(body);
+    _body_store.add();
+    _id_to_handle.insert(in_id, handle);
+    return handle;
+}
+
+Physics_Body Physics_System::get_body(const Physics_Body_Handle& handle)
+{
+    return _get_body_at(_bodies.get_index(handle));
+}
+
+bool Physics_System::remove_body(const Physics_Body_Handle& handle)
+{
+    Physics_Body_Data* body = _bodies.find(handle);
+    if (body == nullptr)
+    {
+        return false;
+    }
+
+    // The last body moves into the removed one's index, it's added back under that index on the next update
+    const uint32 index = static_cast<uint32>(_bodies.get_index(handle));
+    const uint32 last_index = static_cast<uint32>(_bodies.size() - 1);
+    _broadphase->remove(index);
+    _broadphase->remove(last_index);
+
+    _id_to_handle.erase(body->id);
+    _body_store.swap_remove(index);
+    return _bodies.remove(handle);
 }
 
 void Physics_System::update(float dt)
@@ -206,6 +255,267 @@ void Physics_System::render_physics_bodies()
     Shared_Ptr<Renderer_Backend> renderer_backend = Renderer::get().backend;
 }
 
+template<typename Function>
+int64 Physics_System::_run_query_chunks(int64 count, bool in_parallel, const Function& function)
+{
+    Thread_Pool* thread_pool = in_parallel ? Thread_Pool::get_ptr() : nullptr;
+    const int64 chunk_count = thread_pool ? thread_pool->get_chunk_count(count, query_chunk_size) : (count > 0 ? 1 : 0);
+
+    if (_query_scratch.size() < chunk_count)
+    {
+        _query_scratch.resize(chunk_count);
+    }
+    for (int64 chunk = 0; chunk < chunk_count; ++chunk)
+    {
+        _query_scratch[chunk].overlap_hits.clear();
+    }
+
+    if (thread_pool)
+    {
+        thread_pool->parallel_for(count, query_chunk_size, [&](int64 begin, int64 end, int64 chunk){
+            function(begin, end, _query_scratch[chunk]);
+        });
+    }
+    else if (chunk_count > 0)
+    {
+        function(0, count, _query_scratch[0]);
+    }
+
+    return chunk_count;
+}
+
+void Physics_System::raycast_batch(const Dynamic_Array<Ray>& rays, Dynamic_Array<Raycast_Hit>& out_hits, bool in_parallel)
+{
+    PROFILE_FUNCTION()
+
+    out_hits.clear();
+    out_hits.resize(rays.size());
+    if (!_broadphase)
+    {
+        return;
+    }
+
+    _run_query_chunks(rays.size(), in_parallel, [&](int64 begin, int64 end, Query_Scratch& scratch){
+        for (int64 i = begin; i < end; ++i)
+        {
+            _raycast(rays[i], scratch, out_hits[i]);
+        }
+    });
+}
+
+bool Physics_System::raycast(const Ray& ray, Raycast_Hit& out_hit)
+{
+    out_hit = Raycast_Hit();
+    if (!_broadphase)
+    {
+        return false;
+    }
+
+    if (_query_scratch.size() == 0)
+    {
+        _query_scratch.resize(1);
+    }
+    return _raycast(ray, _query_scratch[0], out_hit);
+}
+
+void Physics_System::overlap_sphere_batch(const Dynamic_Array<Sphere_Query>& spheres, Dynamic_Array<Overlap_Hit>& out_hits, bool in_parallel)
+{
+    PROFILE_FUNCTION()
+
+    out_hits.clear();
+    if (!_broadphase)
+    {
+        return;
+    }
+
+    const int64 chunk_count = _run_query_chunks(spheres.size(), in_parallel, [&](int64 begin, int64 end, Query_Scratch& scratch){
+        for (int64 i = begin; i < end; ++i)
+        {
+            const Sphere_Query& sphere = spheres[i];
+            const vec3 radius(sphere.radius, sphere.radius, sphere.radius);
+
+            scratch.candidates.clear();
+            _broadphase->get_potential_collisions(Broadphase::invalid_id, AABB(sphere.center - radius, sphere.center + radius), scratch.candidates);
+            _remove_unknown_candidates(scratch.candidates);
+
+            for (uint32 id : scratch.candidates)
+            {
+                const Collider& collider = _bodies.get_at(id).collider;
+                if (Scene_Query_Function::overlaps_sphere(collider, _body_store.positions[id], _body_store.orientations[id], sphere))
+                {
+                    scratch.overlap_hits.push_back({ static_cast<int32>(i), _bodies.get_handle(id) });
+                }
+            }
+        }
+    });
+
+    _gather_overlap_hits(chunk_count, out_hits);
+}
+
+void Physics_System::overlap_aabb_batch(const Dynamic_Array<AABB>& boxes, Dynamic_Array<Overlap_Hit>& out_hits, bool in_parallel)
+{
+    PROFILE_FUNCTION()
+
+    out_hits.clear();
+    if (!_broadphase)
+    {
+        return;
+    }
+
+    const int64 chunk_count = _run_query_chunks(boxes.size(), in_parallel, [&](int64 begin, int64 end, Query_Scratch& scratch){
+        for (int64 i = begin; i < end; ++i)
+        {
+            scratch.candidates.clear();
+            _broadphase->get_potential_collisions(Broadphase::invalid_id, boxes[i], scratch.candidates);
+            _remove_unknown_candidates(scratch.candidates);
+
+            for (uint32 id : scratch.candidates)
+            {
+                const Collider& collider = _bodies.get_at(id).collider;
+                if (Scene_Query_Function::overlaps_aabb(collider, _body_store.positions[id], _body_store.orientations[id], _body_bounds[id], boxes[i]))
+                {
+                    scratch.overlap_hits.push_back({ static_cast<int32>(i), _bodies.get_handle(id) });
+                }
+            }
+        }
+    });
+
+    _gather_overlap_hits(chunk_count, out_hits);
+}
+
+void Physics_System::overlap_frustum(const vec4 (&planes)[6], Dynamic_Array<Physics_Body_Handle>& out_bodies)
+{
+    PROFILE_FUNCTION()
+
+    out_bodies.clear();
+    if (!_broadphase)
+    {
+        return;
+    }
+
+    if (_query_scratch.size() == 0)
+    {
+        _query_scratch.resize(1);
+    }
+    Dynamic_Array<uint32>& candidates = _query_scratch[0].candidates;
+    candidates.clear();
+
+    // The broadphase gets the box around the frustum's corners, an infinite far plane
+    // leaves no corners to box, so then every body is a candidate
+    AABB frustum_bounds;
+    bool has_bounds = true;
+    for (int32 corner = 0; corner < 8; ++corner)
+    {
+        vec3 point;
+        has_bounds = intersect_planes(planes[corner & 1], planes[2 + ((corner >> 1) & 1)], planes[4 + (corner >> 2)], point);
+        if (!has_bounds)
+        {
+            break;
+        }
+
+        if (corner == 0)
+        {
+            frustum_bounds = AABB(point, point);
+        }
+        frustum_bounds.expand(point);
+    }
+
+    if (has_bounds)
+    {
+        _broadphase->get_potential_collisions(Broadphase::invalid_id, frustum_bounds, candidates);
+        _remove_unknown_candidates(candidates);
+    }
+    else
+    {
+        const int64 body_count = std::min(_bodies.size(), _body_bounds.size());
+        candidates.reserve(body_count);
+        for (int64 i = 0; i < body_count; ++i)
+        {
+            candidates.push_back(static_cast<uint32>(i));
+        }
+    }
+
+    for (uint32 id : candidates)
+    {
+        if (Scene_Query_Function::overlaps_frustum(_body_bounds[id], planes))
+        {
+            out_bodies.push_back(_bodies.get_handle(id));
+        }
+    }
+}
+
+void Physics_System::_gather_overlap_hits(int64 chunk_count, Dynamic_Array<Overlap_Hit>& out_hits) const
+{
+    // Chunks cover the queries in order, so appending them in chunk order keeps the batch order
+    int64 hit_count = 0;
+    for (int64 chunk = 0; chunk < chunk_count; ++chunk)
+    {
+        hit_count += _query_scratch[chunk].overlap_hits.size();
+    }
+
+    out_hits.reserve(hit_count);
+    for (int64 chunk = 0; chunk < chunk_count; ++chunk)
+    {
+        for (const Overlap_Hit& hit : _query_scratch[chunk].overlap_hits)
+        {
+            out_hits.push_back(hit);
+        }
+    }
+}
+
+void Physics_System::_remove_unknown_candidates(Dynamic_Array<uint32>& candidates) const
+{
+    // Bodies added since the last update aren't in the broadphase, ids past the bounds can
+    // only be left over from removals
+    const uint32 body_count = static_cast<uint32>(std::min(_bodies.size(), _body_bounds.size()));
+    int64 kept = 0;
+    for (uint32 id : candidates)
+    {
+        if (id < body_count)
+        {
+            candidates[kept++] = id;
+        }
+    }
+    candidates.resize(kept);
+}
+
+bool Physics_System::_raycast(const Ray& ray, Query_Scratch& scratch, Raycast_Hit& out_hit) const
+{
+    scratch.candidates.clear();
+    scratch.bounds_hits.clear();
+
+    _broadphase->raycast(ray.origin, ray.direction, ray.max_distance, scratch.candidates);
+    _remove_unknown_candidates(scratch.candidates);
+    Scene_Query_Function::raycast_bounds(ray, _body_bounds.begin(), scratch.candidates.begin(), scratch.candidates.size(), scratch.bounds_hits);
+
+    // Nearest boxes first, once a box starts past the closest hit nothing after it can be closer
+    std::sort(scratch.bounds_hits.begin(), scratch.bounds_hits.end(), [](const Ray_Bounds_Hit& a, const Ray_Bounds_Hit& b){
+        return a.distance < b.distance || (a.distance == b.distance && a.id < b.id);
+    });
+
+    for (const Ray_Bounds_Hit& bounds_hit : scratch.bounds_hits)
+    {
+        if (bounds_hit.distance > out_hit.distance)
+        {
+            break;
+        }
+
+        const Collider& collider = _bodies.get_at(bounds_hit.id).collider;
+        float distance;
+        vec3 normal;
+        if (Scene_Query_Function::raycast(collider, _body_store.positions[bounds_hit.id], _body_store.orientations[bounds_hit.id], ray, distance, normal) &&
+            distance < out_hit.distance)
+        {
+            out_hit.body = _bodies.get_handle(bounds_hit.id);
+            out_hit.distance = distance;
+            out_hit.point = ray.origin + ray.direction * distance;
+            out_hit.normal = normal;
+        }
+    }
+
+    return out_hit.body.is_valid();
+}
+
 void Physics_System::_init_collision_functions()
 {
     _collision_functions[Collider::Sphere][Collider::Sphere] = Collision_Test_Function::sphere_sphere;
@@ -233,24 +543,45 @@ void Physics_System::_init_collision_functions()
     _collision_functions[Collider::Convex_Hull][Collider::Cylinder] = Collision_Test_Function::convex_cylinder;
     _collision_functions[Collider::Convex_Hull][Collider::Box] = Collision_Test_Function::convex_box;
     _collision_functions[Collider::Convex_Hull][Collider::Convex_Hull] = Collision_Test_Function::convex_convex;
+
+    _collision_uses_gjk_cache[Collider::Box][Collider::Convex_Hull] = true;
+    _collision_uses_gjk_cache[Collider::Convex_Hull][Collider::Box] = true;
+    _collision_uses_gjk_cache[Collider::Convex_Hull][Collider::Convex_Hull] = true;
 }
 
 void Physics_System::_execute_broadphase(float dt)
 {
     PROFILE_FUNCTION()
 
-    //TODO: paralelize
-    for (Physics_Body& body : _bodies)
-    {
-        if (body.is_awake)
+    const int64 body_count = _bodies.size();
+    _body_bounds.resize(body_count);
+
+    // Bodies only touch themselves here, so they're integrated in chunks on the workers
+    const auto integrate = [&](int64 begin, int64 end, int64){
+        _body_store.integrate_velocities(dt, begin, end);
+
+        for (int64 i = begin; i < end; ++i)
         {
-            body.update_state(dt);
+            if (_body_store.types[i] == Physics_Body::Kinematic)
+            {
+                _get_body_at(i).update_kinematic_state(dt);
+            }
+
+            _body_bounds[i] = _bodies.get_at(i).collider.get_transformed_bounds(_body_store.positions[i], _body_store.orientations[i]);
         }
+    };
 
-        _hash_grid.update(body.id, body.get_transformed_bounds());
+    if (Thread_Pool* thread_pool = Thread_Pool::get_ptr())
+    {
+        thread_pool->parallel_for(body_count, 128, integrate);
+    }
+    else
+    {
+        integrate(0, body_count, 0);
     }
 
-    _hash_grid.sweep_and_prune_cells(_broadphase_collision_pairs);
+    _broadphase->update_all(_body_bounds.begin(), body_count);
+    _broadphase->find_pairs(_broadphase_collision_pairs);
 }
 
 void Physics_System::_execute_narrowphase(float dt)
@@ -259,19 +590,19 @@ void Physics_System::_execute_narrowphase(float dt)
 
     _narrowphase_collisions.clear();
 
-    for (const Pair<Name_Id, Name_Id>& collision_pair : _broadphase_collision_pairs)
+    for (const Pair<uint32, uint32>& collision_pair : _broadphase_collision_pairs)
     {
-        const int64 this_index = _id_to_index[collision_pair.a];
-        Physics_Body& this_body = _bodies[this_index];
-        const int64 other_index = _id_to_index[collision_pair.b];
-        Physics_Body& other_body = _bodies[other_index];
-
-        if (!this_body.is_awake && !other_body.is_awake)
+        const int64 this_index = collision_pair.a;
+        const int64 other_index = collision_pair.b;
+        if (!_body_store.awake[this_index] && !_body_store.awake[other_index])
         {
             continue;
         }
 
-        Collision_Test_Function::Definition f = _collision_functions[this_body.collider.type][other_body.collider.type];
+        const Collider& this_collider = _bodies.get_at(this_index).collider;
+        const Collider& other_collider = _bodies.get_at(other_index).collider;
+
+        Collision_Test_Function::Definition f = _collision_functions[this_collider.type][other_collider.type];
         if (f == nullptr)
         {
             printf("Can't find collision test function for given collider types.\n");
@@ -281,39 +612,88 @@ void Physics_System::_execute_narrowphase(float dt)
         Collision_Result result;
         result.a_index = (int32)this_index;
         result.b_index = (int32)other_index;
-        if (f(this_body.collider, this_body.transform.position, this_body.transform.orientation, 
-            other_body.collider, other_body.transform.position, other_body.transform.orientation, 
+        if (_collision_uses_gjk_cache[this_collider.type][other_collider.type])
+        {
+            result.gjk_cache = _get_gjk_cache(this_index, this_collider, other_index, other_collider);
+        }
+
+        if (f(this_collider, _body_store.positions[this_index], _body_store.orientations[this_index], 
+            other_collider, _body_store.positions[other_index], _body_store.orientations[other_index], 
             result))
         {
-            _narrowphase_collisions[collision_pair.a].push_back(result);
+            result.gjk_cache = nullptr;
+            _narrowphase_collisions.push_back(result);
         }
     }
+
+    _remove_stale_gjk_caches();
+}
+
+Gjk_Cache* Physics_System::_get_gjk_cache(int64 a_index, const Collider& a_collider, int64 b_index, const Collider& b_collider)
+{
+    const Physics_Body_Handle body_a = _bodies.get_handle(a_index);
+    const Physics_Body_Handle body_b = _bodies.get_handle(b_index);
+
+    Gjk_Cache_Entry& entry = _gjk_caches.find_or_add(make_unordered_pair_key(body_a.index, body_b.index));
+    if (!(entry.body_a == body_a) || !(entry.body_b == body_b) ||
+        entry.type_a != a_collider.type || entry.type_b != b_collider.type ||
+        !(entry.hull_a == a_collider.convex_hull) || !(entry.hull_b == b_collider.convex_hull))
+    {
+        entry.cache = Gjk_Cache();
+        entry.body_a = body_a;
+        entry.body_b = body_b;
+        entry.type_a = a_collider.type;
+        entry.type_b = b_collider.type;
+        entry.hull_a = a_collider.convex_hull;
+        entry.hull_b = b_collider.convex_hull;
+    }
+
+    entry.last_step = _step_index;
+    return &entry.cache;
+}
+
+void Physics_System::_remove_stale_gjk_caches()
+{
+    _stale_gjk_caches.clear();
+    for (const auto& [key, entry] : _gjk_caches)
+    {
+        if (entry.last_step != _step_index)
+        {
+            _stale_gjk_caches.push_back(key);
+        }
+    }
+
+    for (uint64 key : _stale_gjk_caches)
+    {
+        _gjk_caches.erase(key);
+    }
+
+    _step_index++;
 }
 
 void Physics_System::_resolve_collisions(float dt)
 {
     PROFILE_FUNCTION()
     
-    for (const auto& collision_pairs : _narrowphase_collisions)
+    for (const Collision_Result& collision : _narrowphase_collisions)
     {
-        for (const Collision_Result& collision : collision_pairs.second)
+        if (!_body_store.awake[collision.a_index] && !_body_store.awake[collision.b_index])
         {
-            Physics_Body& this_body =  _bodies[collision.a_index];
-            Physics_Body& other_body = _bodies[collision.b_index];
+            continue;
+        }
 
-            if (!this_body.is_awake && !other_body.is_awake)
-            {
-                continue;
-            }
+        Physics_Body this_body = _get_body_at(collision.a_index);
+        Physics_Body other_body = _get_body_at(collision.b_index);
 
-            _resolve_collision(this_body, other_body, collision);
-            _position_correction(this_body, other_body, collision);
-        }
+        _resolve_collision(this_body, other_body, collision);
+        _position_correction(this_body, other_body, collision);
     }
 
-    for (Physics_Body& body : _bodies)
+    _sleep_changes.clear();
+    _body_store.integrate_transforms(dt, 0, _body_store.size(), _sleep_changes);
+    for (uint32 index : _sleep_changes)
     {
-        body.update_transform_euler(dt);
+        printf("%s is now %s.\n", _bodies.get_at(index).id.c_str(), _body_store.awake[index] ? "awake" : "asleep");
     }
 }
 
@@ -328,7 +708,7 @@ void Physics_System::_resolve_collision(Physics_Body& a, Physics_Body& b, const
     const vec3 v_relative = v_a - v_b;
     const float v_normal = v_relative.dot(collision.normal);
 
-    //printf("a:%s->b:%s v_normal %f\n", a.id.str, b.id.str, v_normal);
+    //printf("a:%s->b:%s v_normal %f\n", a.id.c_str(), b.id.c_str(), v_normal);
 
     // No changes needed as the bodies are separating.
     if (v_normal < 0) return;
@@ -346,7 +726,7 @@ void Physics_System::_resolve_collision(Physics_Body& a, Physics_Body& b, const
     const float denominator = total_inverse_mass + angular_term;
     const float j = -(1 + restitution) * v_normal / denominator;
 
-    //printf("a:%s->b:%s j:%f\n", a.id.str, b.id.str, j);
+    //printf("a:%s->b:%s j:%f\n", a.id.c_str(), b.id.c_str(), j);
     if (fabs(j) > 0.1)
     {
         a.wake_up();
@@ -6,10 +6,21 @@
 #include "cs/cs.hpp"
 #include "cs/math/math.hpp"
 #include "cs/containers/dynamic_array.hpp"
+#include "cs/containers/slot_map.hpp"
 #include "cs/containers/spatial_hash_grid.hpp"
+#include "cs/containers/hierarchical_hash_grid.hpp"
+#include "cs/containers/dynamic_aabb_tree.hpp"
+#include "cs/containers/sweep_and_prune.hpp"
+#include "cs/containers/concurrent_hash_map.hpp"
+#include "cs/containers/flat_hash_map.hpp"
 #include "cs/name_id.hpp"
 #include "cs/engine/profiling/profiler.hpp"
 #include "cs/engine/physics/collision_function.hpp"
+#include "cs/engine/physics/broadphase.hpp"
+#include "cs/engine/physics/scene_query.hpp"
+#include "cs/engine/physics/physics_body_store.hpp"
+#include "cs/engine/resource/physics_resources.hpp"
+#include "cs/memory/shared_ptr.hpp"
 
 #include <unordered_map>
 
@@ -24,14 +35,6 @@ struct Capsule_Shape
     float length;
 };
 
-#define CONVEX_HULL_MAX_NUM_VERTICES 512
-struct Convex_Hull_Shape
-{
-    int32 count;
-    vec3 vertices[CONVEX_HULL_MAX_NUM_VERTICES];
-    float volume;
-};
-
 struct Collider
 {
     enum Type
@@ -54,66 +57,92 @@ struct Collider
             float height;
         } cylinder;
         AABB bounding_box;
-        Convex_Hull_Shape convex_hull;
     } shape;
+    // Only used by Convex_Hull, the geometry is shared through the Convex_Hull_Pool
+    Convex_Hull_Handle convex_hull;
     AABB bounds;
+
+    AABB get_transformed_bounds(const vec3& position, const quat& orientation) const;
 };
 
-struct Physics_Body
+// A body's transform, as Physics_Body_Data keeps it between steps
+struct Physics_Body_Transform
 {
-    enum Type
-    {
-        None,
-        // Static objects that won't change in shape, transform etc.
-        Static,
-        // Movable objects that are controlled by us
-        Kinematic,
-        // Movable objects that are controlled by the physics engine
-        Dynamic
-    };
+    vec3 position { vec3::zero_vector };
+    quat orientation { quat::zero_quat };
+};
 
+// The parts of a body the step doesn't walk through every time, the rest is in Physics_Body_Store
+struct Physics_Body_Data
+{
     Name_Id id;
-    Type type { None };
 
     vec3 center_of_mass { vec3::zero_vector };
-    mat4 inverse_inertia_tensor { mat4(1.0f) };
-
-    float inverse_mass { 1.0f };
     // 0 -> inelastic, 1 -> perfect elastic
     float restitution { 0.5f };
     float dynamic_friction { 0.2f };
 
+    // Where a kinematic body was on the last step, its velocities come from the difference
+    Physics_Body_Transform old_transform;
+
+    Collider collider;
+};
+
+// View of one body, its fields are references into Physics_Body_Data and Physics_Body_Store.
+// Only valid until the next body is added or removed, keep a Physics_Body_Handle instead
+struct Physics_Body
+{
+    using Type = Physics_Body_Type::Type;
+    static constexpr Type None = Physics_Body_Type::None;
+    static constexpr Type Static = Physics_Body_Type::Static;
+    static constexpr Type Kinematic = Physics_Body_Type::Kinematic;
+    static constexpr Type Dynamic = Physics_Body_Type::Dynamic;
+
     struct Transform
     {
-        vec3 position { vec3::zero_vector };
-        quat orientation { quat::zero_quat };
-    } transform, old_transform;
-
-    float max_linear_velocity = FLT_MAX;
-    float linear_damping { 0.001f };
-    vec3 accumulated_forces { vec3::zero_vector };
-    vec3 linear_velocity { vec3::zero_vector };
-
-    float max_angular_velocity = FLT_MAX;
-    float angular_damping { 0.01f };
-    vec3 accumulated_torque { vec3::zero_vector };
-    vec3 angular_velocity { vec3::zero_vector };
-
-    bool is_awake { true };
-    float sleep_timer { 0.0f };
-    float sleep_time_threshold { 2.0f };
-    float sleep_linear_velocity_threshold { 0.1f };
-    float sleep_angular_velocity_threshold { 0.1f };
+        vec3& position;
+        quat& orientation;
+    };
 
-    Collider collider;
+    Physics_Body(Physics_Body_Data& data, Physics_Body_Store& store, int64 index);
+
+    Name_Id& id;
+    Type& type;
+
+    vec3& center_of_mass;
+    mat4& inverse_inertia_tensor;
+
+    float& inverse_mass;
+    float& restitution;
+    float& dynamic_friction;
+
+    Transform transform;
+    Physics_Body_Transform& old_transform;
 
-    bool dirty;
+    float& max_linear_velocity;
+    float& linear_damping;
+    vec3& accumulated_forces;
+    vec3& linear_velocity;
+
+    float& max_angular_velocity;
+    float& angular_damping;
+    vec3& accumulated_torque;
+    vec3& angular_velocity;
+
+    bool& is_awake;
+    float& sleep_timer;
+    float& sleep_time_threshold;
+    float& sleep_linear_velocity_threshold;
+    float& sleep_angular_velocity_threshold;
+
+    Collider& collider;
+
+    bool& dirty;
 
     AABB get_transformed_bounds() const;
 
-    void update_state(float dt);
-    
-    void update_transform_euler(float dt);
+    // Integration of dynamic bodies is done by Physics_Body_Store's kernels
+    void update_kinematic_state(float dt);
 
     void wake_up();
 
@@ -125,43 +154,144 @@ struct Physics_Body
     void apply_impulse_at_offset(const vec3& impulse, const vec3& force_offset);
 };
 
+// Stays valid while other bodies are added and removed
+using Physics_Body_Handle = Slot_Map_Handle<Physics_Body_Data>;
+
 struct Collision_Result
 {
+    // Dense body indices, only valid during the step that produced them
     int32 a_index { -1 }, b_index { -1 };
+    // The pair's cache if it has one, set before the test and only valid during it
+    Gjk_Cache* gjk_cache { nullptr };
     vec3 normal { vec3::zero_vector };
     // World space
     vec3 contact_point { vec3::zero_vector };
     float penetration { 0.0f };
+    // When faces touch there can be up to four points, contact_point is their average then.
+    // Tests that only find one point leave contact_count at 0
+    vec3 contact_points[4];
+    int32 contact_count { 0 };
+};
+
+struct Raycast_Hit
+{
+    // Invalid when the ray hit nothing
+    Physics_Body_Handle body;
+    float distance { FLT_MAX };
+    vec3 point { vec3::zero_vector };
+    vec3 normal { vec3::zero_vector };
+};
+
+struct Overlap_Hit
+{
+    // Index of the query in its batch
+    int32 query_index;
+    Physics_Body_Handle body;
 };
 
 class Physics_System : public Singleton<Physics_System>
 {
 public:
-    Physics_Body& get_body(const Name_Id& in_id);
+    // Creates the body if there's none with this id yet
+    Physics_Body get_body(const Name_Id& in_id);
+    Physics_Body_Handle get_body_handle(const Name_Id& in_id);
+    // False if the body was removed
+    bool contains_body(const Physics_Body_Handle& handle) const { return _bodies.contains(handle); }
+    // The body has to be there, check with contains_body
+    Physics_Body get_body(const Physics_Body_Handle& handle);
+    bool remove_body(const Physics_Body_Handle& handle);
 
     void initialize();
     void update(float dt);
 
+    // Bodies are put into the new broadphase on the next update
+    void set_broadphase(Broadphase_Type::Type type);
+    Broadphase_Type::Type get_broadphase_type() const { return _broadphase->get_type(); }
+
     void render_physics_bodies();
 
+    // Scene queries. Candidates come from the broadphase as of the last update, the exact tests
+    // use the bodies' current transforms. Batches are split over the thread pool unless
+    // in_parallel is false, the results are the same either way
+
+    // out_hits[i] is the closest hit of rays[i]
+    void raycast_batch(const Dynamic_Array<Ray>& rays, Dynamic_Array<Raycast_Hit>& out_hits, bool in_parallel = true);
+    bool raycast(const Ray& ray, Raycast_Hit& out_hit);
+    // Grouped by query in batch order, bodies in index order within a query
+    void overlap_sphere_batch(const Dynamic_Array<Sphere_Query>& spheres, Dynamic_Array<Overlap_Hit>& out_hits, bool in_parallel = true);
+    void overlap_aabb_batch(const Dynamic_Array<AABB>& boxes, Dynamic_Array<Overlap_Hit>& out_hits, bool in_parallel = true);
+    // Bodies whose bounds are at least partly inside. Planes point inwards, in the order
+    // left, right, bottom, top, near, far
+    void overlap_frustum(const vec4 (&planes)[6], Dynamic_Array<Physics_Body_Handle>& out_bodies);
+
 private:
-    Dynamic_Array<Physics_Body> _bodies;
-    std::unordered_map<Name_Id, int64> _id_to_index;
+    Slot_Map<Physics_Body_Data> _bodies;
+    // Indexed like _bodies' values
+    Physics_Body_Store _body_store;
+    // Filled by the transform integration
+    Dynamic_Array<uint32> _sleep_changes;
+    // Read from worker threads during the physics update
+    Concurrent_Hash_Map<Name_Id, Physics_Body_Handle> _id_to_handle;
 
-    Spatial_Hash_Grid _hash_grid = Spatial_Hash_Grid(1.50f);
+    Shared_Ptr<Broadphase> _broadphase;
 
     void _init_collision_functions();
 
     
-    Dynamic_Array<Pair<Name_Id, Name_Id>> _broadphase_collision_pairs;
+    // Indexed like the bodies, filled in parallel before the broadphase update
+    Dynamic_Array<AABB> _body_bounds;
+    // Dense body indices, the grid is keyed by them too
+    Dynamic_Array<Pair<uint32, uint32>> _broadphase_collision_pairs;
     // std::unordered_map<uint32, Dynamic_Array<Name_Id>> _broadphase_collisions;
-    std::unordered_map<Name_Id, Dynamic_Array<Collision_Result>> _narrowphase_collisions;
+    // Kept between steps, so it only allocates when the contact count grows
+    Dynamic_Array<Collision_Result> _narrowphase_collisions;
+
+    struct Gjk_Cache_Entry
+    {
+        Gjk_Cache cache;
+        // Slots get reused and pairs can come in the other way around, either starts the cache over
+        Physics_Body_Handle body_a, body_b;
+        // The cached vertex indices only mean something for the shapes they came from,
+        // a body that switched collider starts the cache over too
+        Collider::Type type_a { Collider::TYPE_COUNT }, type_b { Collider::TYPE_COUNT };
+        Convex_Hull_Handle hull_a, hull_b;
+        uint32 last_step { 0 };
+    };
+    // Pairs with a hull, keyed by their bodies' slot indices. Pairs the narrowphase
+    // didn't see in a step are dropped after it
+    Flat_Hash_Map<uint64, Gjk_Cache_Entry> _gjk_caches;
+    Dynamic_Array<uint64> _stale_gjk_caches;
+    uint32 _step_index { 0 };
+
+    // One per query chunk, kept between queries
+    struct Query_Scratch
+    {
+        Dynamic_Array<uint32> candidates;
+        Dynamic_Array<Ray_Bounds_Hit> bounds_hits;
+        Dynamic_Array<Overlap_Hit> overlap_hits;
+    };
+    Dynamic_Array<Query_Scratch> _query_scratch;
+
+    // Runs function(begin, end, scratch) over the queries, returns how many chunks it used
+    template<typename Function>
+    int64 _run_query_chunks(int64 count, bool in_parallel, const Function& function);
+    void _gather_overlap_hits(int64 chunk_count, Dynamic_Array<Overlap_Hit>& out_hits) const;
+    // Drops ids of bodies the broadphase hasn't seen yet
+    void _remove_unknown_candidates(Dynamic_Array<uint32>& candidates) const;
+    bool _raycast(const Ray& ray, Query_Scratch& scratch, Raycast_Hit& out_hit) const;
+
+    Physics_Body _get_body_at(int64 index) { return Physics_Body(_bodies.get_at(index), _body_store, index); }
 
     void _execute_broadphase(float dt);
     void _execute_narrowphase(float dt);
+    // Creates the pair's cache on its first test
+    Gjk_Cache* _get_gjk_cache(int64 a_index, const Collider& a_collider, int64 b_index, const Collider& b_collider);
+    void _remove_stale_gjk_caches();
     void _resolve_collisions(float dt);
     void _resolve_collision(Physics_Body& a, Physics_Body& b, const Collision_Result& collision);
     void _position_correction(Physics_Body& a, Physics_Body& b, const Collision_Result& collision);
     Collision_Test_Function::Definition _collision_functions[Collider::TYPE_COUNT][Collider::TYPE_COUNT];
+    // Set for the type pairs whose test runs GJK, only those get a Gjk_Cache
+    bool _collision_uses_gjk_cache[Collider::TYPE_COUNT][Collider::TYPE_COUNT] {};
 
 };
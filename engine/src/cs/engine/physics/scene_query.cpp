@@ -0,0 +1,623 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/engine/physics/scene_query.hpp"
+#include "cs/engine/physics/physics_system.hpp"
+#include "cs/engine/physics/collision_function.hpp"
+
+#include <algorithm>
+
+#if defined(CS_SSE2)
+    #include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Box in the collider's frame, centered on center
+    struct Oriented_Box
+    {
+        vec3 center;
+        vec3 axes[3];
+        vec3 half_extents;
+    };
+
+    // Same axes the bounds and the box collision tests take from the orientation
+    void get_axes(const quat& o, vec3 (&out_axes)[3])
+    {
+        const mat4 rotation = o.to_mat4();
+        out_axes[0] = rotation[0].xyz;
+        out_axes[1] = rotation[1].xyz;
+        out_axes[2] = rotation[2].xyz;
+    }
+
+    vec3 to_local(const vec3 (&axes)[3], const vec3& v)
+    {
+        return vec3(v.dot(axes[0]), v.dot(axes[1]), v.dot(axes[2]));
+    }
+
+    vec3 to_world(const vec3 (&axes)[3], const vec3& v)
+    {
+        return axes[0] * v.x + axes[1] * v.y + axes[2] * v.z;
+    }
+
+    // The frame the shape is tested in. Hulls don't get one, rays are clipped by their faces
+    // and overlaps go through GJK
+    Oriented_Box get_oriented_box(const Collider& collider, const vec3& p, const quat& o)
+    {
+        assert(collider.type != Collider::Convex_Hull);
+
+        Oriented_Box box;
+        get_axes(o, box.axes);
+        switch (collider.type)
+        {
+        case Collider::Capsule:
+            box.center = p;
+            box.half_extents = vec3(collider.shape.capsule.radius, collider.shape.capsule.radius,
+                collider.shape.capsule.length * 0.5f + collider.shape.capsule.radius);
+            break;
+        case Collider::Cylinder:
+            box.center = p;
+            box.half_extents = vec3(collider.shape.cylinder.radius, collider.shape.cylinder.radius, collider.shape.cylinder.height * 0.5f);
+            break;
+        default:
+            box.center = p;
+            box.half_extents = collider.shape.bounding_box.get_half_extents();
+            break;
+        }
+        return box;
+    }
+
+    // Clips the ray by every face plane, in the hull's frame
+    bool ray_hull(const Convex_Hull_Resource& hull, const vec3& origin, const vec3& direction, float max_distance, float& out_distance, vec3& out_normal)
+    {
+        float t_enter = 0.0f;
+        float t_exit = max_distance;
+        int64 enter_face = -1;
+        for (int64 face = 0; face < hull.face_planes.size(); ++face)
+        {
+            const vec4& plane = hull.face_planes[face];
+            const float along_normal = plane.xyz.dot(direction);
+            // Positive behind the plane
+            const float depth = plane.w - plane.xyz.dot(origin);
+            if (fabs(along_normal) < NEARLY_ZERO)
+            {
+                if (depth < 0.0f)
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            const float t = depth / along_normal;
+            if (along_normal < 0.0f)
+            {
+                if (t > t_enter)
+                {
+                    t_enter = t;
+                    enter_face = face;
+                }
+            }
+            else
+            {
+                t_exit = std::min(t_exit, t);
+            }
+
+            if (t_enter > t_exit)
+            {
+                return false;
+            }
+        }
+
+        out_distance = t_enter;
+        out_normal = enter_face == -1 ? -direction : hull.face_planes[enter_face].xyz;
+        return true;
+    }
+
+    bool ray_hits_bounds(const AABB& bounds, const vec3& origin, const vec3& inverse_direction, float max_distance, float& out_distance)
+    {
+        float t_enter = 0.0f;
+        float t_exit = max_distance;
+        for (int32 axis = 0; axis < 3; ++axis)
+        {
+            const float t_a = (bounds.min[axis] - origin[axis]) * inverse_direction[axis];
+            const float t_b = (bounds.max[axis] - origin[axis]) * inverse_direction[axis];
+            // NaN from a ray lying in a slab plane drops out of max/min this way round
+            t_enter = std::max(t_enter, std::min(t_a, t_b));
+            t_exit = std::min(t_exit, std::max(t_a, t_b));
+        }
+
+        out_distance = t_enter;
+        return t_enter <= t_exit;
+    }
+
+    // Local ray against a box centered on the origin
+    bool ray_box(const vec3& origin, const vec3& direction, const vec3& half_extents, float max_distance, float& out_distance, vec3& out_normal)
+    {
+        float t_enter = 0.0f;
+        float t_exit = max_distance;
+        int32 enter_axis = -1;
+        for (int32 axis = 0; axis < 3; ++axis)
+        {
+            if (fabs(direction[axis]) < NEARLY_ZERO)
+            {
+                if (origin[axis] < -half_extents[axis] || origin[axis] > half_extents[axis])
+                {
+                    return false;
+                }
+                continue;
+            }
+
+            const float inverse_direction = 1.0f / direction[axis];
+            float t_near = (-half_extents[axis] - origin[axis]) * inverse_direction;
+            float t_far = (half_extents[axis] - origin[axis]) * inverse_direction;
+            if (t_near > t_far)
+            {
+                std::swap(t_near, t_far);
+            }
+
+            if (t_near > t_enter)
+            {
+                t_enter = t_near;
+                enter_axis = axis;
+            }
+            t_exit = std::min(t_exit, t_far);
+            if (t_enter > t_exit)
+            {
+                return false;
+            }
+        }
+
+        out_distance = t_enter;
+        out_normal = -direction;
+        if (enter_axis != -1)
+        {
+            out_normal = vec3::zero_vector;
+            out_normal[enter_axis] = direction[enter_axis] > 0.0f ? -1.0f : 1.0f;
+        }
+        return true;
+    }
+
+    // Local ray against the side of a cylinder around z, only where |z| <= half_height
+    bool ray_cylinder_side(const vec3& origin, const vec3& direction, float radius, float half_height, float max_distance, float& out_distance, vec3& out_normal)
+    {
+        const float a = direction.x * direction.x + direction.y * direction.y;
+        if (a < NEARLY_ZERO)
+        {
+            return false;
+        }
+
+        const float b = origin.x * direction.x + origin.y * direction.y;
+        const float c = origin.x * origin.x + origin.y * origin.y - radius * radius;
+        const float discriminant = b * b - a * c;
+        if (discriminant < 0.0f)
+        {
+            return false;
+        }
+
+        const float t = (-b - sqrtf(discriminant)) / a;
+        if (t < 0.0f || t > max_distance)
+        {
+            return false;
+        }
+
+        const vec3 point = origin + direction * t;
+        if (fabs(point.z) > half_height)
+        {
+            return false;
+        }
+
+        out_distance = t;
+        out_normal = vec3(point.x, point.y, 0.0f) / radius;
+        return true;
+    }
+
+    bool ray_sphere(const vec3& origin, const vec3& direction, const vec3& center, float radius, float max_distance, float& out_distance, vec3& out_normal)
+    {
+        const vec3 offset = origin - center;
+        const float b = offset.dot(direction);
+        const float c = offset.dot(offset) - radius * radius;
+        if (c <= 0.0f)
+        {
+            out_distance = 0.0f;
+            out_normal = -direction;
+            return true;
+        }
+
+        // Outside and pointing away
+        if (b > 0.0f)
+        {
+            return false;
+        }
+
+        const float discriminant = b * b - c;
+        if (discriminant < 0.0f)
+        {
+            return false;
+        }
+
+        const float t = -b - sqrtf(discriminant);
+        if (t > max_distance)
+        {
+            return false;
+        }
+
+        out_distance = t;
+        out_normal = (origin + direction * t - center) / radius;
+        return true;
+    }
+
+    bool ray_capsule(const vec3& origin, const vec3& direction, float radius, float half_length, float max_distance, float& out_distance, vec3& out_normal)
+    {
+        const float closest_z = clamp(origin.z, -half_length, half_length);
+        if ((origin - vec3(0.0f, 0.0f, closest_z)).length_squared() <= radius * radius)
+        {
+            out_distance = 0.0f;
+            out_normal = -direction;
+            return true;
+        }
+
+        bool hit = ray_cylinder_side(origin, direction, radius, half_length, max_distance, out_distance, out_normal);
+        for (float cap_z : { -half_length, half_length })
+        {
+            float cap_distance;
+            vec3 cap_normal;
+            const float max_cap_distance = hit ? out_distance : max_distance;
+            if (ray_sphere(origin, direction, vec3(0.0f, 0.0f, cap_z), radius, max_cap_distance, cap_distance, cap_normal))
+            {
+                out_distance = cap_distance;
+                out_normal = cap_normal;
+                hit = true;
+            }
+        }
+        return hit;
+    }
+
+    bool ray_cylinder(const vec3& origin, const vec3& direction, float radius, float half_height, float max_distance, float& out_distance, vec3& out_normal)
+    {
+        if (fabs(origin.z) <= half_height && origin.x * origin.x + origin.y * origin.y <= radius * radius)
+        {
+            out_distance = 0.0f;
+            out_normal = -direction;
+            return true;
+        }
+
+        if (ray_cylinder_side(origin, direction, radius, half_height, max_distance, out_distance, out_normal))
+        {
+            return true;
+        }
+
+        // Missed the side, so it can only come in through the cap facing it
+        if (fabs(direction.z) < NEARLY_ZERO)
+        {
+            return false;
+        }
+
+        const float cap_z = direction.z > 0.0f ? -half_height : half_height;
+        const float t = (cap_z - origin.z) / direction.z;
+        if (t < 0.0f || t > max_distance)
+        {
+            return false;
+        }
+
+        const vec3 point = origin + direction * t;
+        if (point.x * point.x + point.y * point.y > radius * radius)
+        {
+            return false;
+        }
+
+        out_distance = t;
+        out_normal = vec3(0.0f, 0.0f, direction.z > 0.0f ? -1.0f : 1.0f);
+        return true;
+    }
+
+    float distance_squared_to_bounds(const vec3& point, const AABB& bounds)
+    {
+        float distance_squared = 0.0f;
+        for (int32 axis = 0; axis < 3; ++axis)
+        {
+            const float clamped = clamp(point[axis], bounds.min[axis], bounds.max[axis]);
+            distance_squared += (point[axis] - clamped) * (point[axis] - clamped);
+        }
+        return distance_squared;
+    }
+
+    // Separating axis test, the box's three axes, the oriented box's three and the nine cross products
+    bool oriented_box_overlaps_bounds(const Oriented_Box& oriented_box, const AABB& bounds)
+    {
+        const vec3 box_half_extents = bounds.get_half_extents();
+        const vec3 offset = oriented_box.center - bounds.get_center();
+
+        // rotation[i][j] is the oriented box's axis j along world axis i
+        float rotation[3][3];
+        float abs_rotation[3][3];
+        for (int32 i = 0; i < 3; ++i)
+        {
+            for (int32 j = 0; j < 3; ++j)
+            {
+                rotation[i][j] = oriented_box.axes[j][i];
+                // Parallel edges make the cross product axes zero, keep them from separating anything
+                abs_rotation[i][j] = fabs(rotation[i][j]) + EPSILON;
+            }
+        }
+
+        const vec3& half_extents = oriented_box.half_extents;
+        for (int32 i = 0; i < 3; ++i)
+        {
+            const float radius = half_extents[0] * abs_rotation[i][0] + half_extents[1] * abs_rotation[i][1] + half_extents[2] * abs_rotation[i][2];
+            if (fabs(offset[i]) > box_half_extents[i] + radius)
+            {
+                return false;
+            }
+        }
+
+        for (int32 j = 0; j < 3; ++j)
+        {
+            const float radius = box_half_extents[0] * abs_rotation[0][j] + box_half_extents[1] * abs_rotation[1][j] + box_half_extents[2] * abs_rotation[2][j];
+            const float distance = offset[0] * rotation[0][j] + offset[1] * rotation[1][j] + offset[2] * rotation[2][j];
+            if (fabs(distance) > half_extents[j] + radius)
+            {
+                return false;
+            }
+        }
+
+        for (int32 i = 0; i < 3; ++i)
+        {
+            const int32 i1 = (i + 1) % 3;
+            const int32 i2 = (i + 2) % 3;
+            for (int32 j = 0; j < 3; ++j)
+            {
+                const int32 j1 = (j + 1) % 3;
+                const int32 j2 = (j + 2) % 3;
+                const float box_radius = box_half_extents[i1] * abs_rotation[i2][j] + box_half_extents[i2] * abs_rotation[i1][j];
+                const float radius = half_extents[j1] * abs_rotation[i][j2] + half_extents[j2] * abs_rotation[i][j1];
+                const float distance = offset[i2] * rotation[i1][j] - offset[i1] * rotation[i2][j];
+                if (fabs(distance) > box_radius + radius)
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // Distance to a box is convex along a segment, so a ternary search finds the closest point
+    float segment_distance_squared_to_bounds(const vec3& start, const vec3& end, const AABB& bounds)
+    {
+        float low = 0.0f;
+        float high = 1.0f;
+        for (int32 iteration = 0; iteration < 24; ++iteration)
+        {
+            const float a = low + (high - low) / 3.0f;
+            const float b = high - (high - low) / 3.0f;
+            if (distance_squared_to_bounds(start + (end - start) * a, bounds) < distance_squared_to_bounds(start + (end - start) * b, bounds))
+            {
+                high = b;
+            }
+            else
+            {
+                low = a;
+            }
+        }
+
+        return distance_squared_to_bounds(start + (end - start) * ((low + high) * 0.5f), bounds);
+    }
+}
+
+namespace Scene_Query_Function
+{
+    int32 raycast_bounds(const Ray& ray, const AABB* bounds, const uint32* ids, int64 count, Dynamic_Array<Ray_Bounds_Hit>& out_hits)
+    {
+        const int64 previous_size = out_hits.size();
+        const vec3 inverse_direction(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+        int64 i = 0;
+#if defined(CS_SSE2)
+        const __m128 origin[3] = { _mm_set1_ps(ray.origin.x), _mm_set1_ps(ray.origin.y), _mm_set1_ps(ray.origin.z) };
+        const __m128 inverse[3] = { _mm_set1_ps(inverse_direction.x), _mm_set1_ps(inverse_direction.y), _mm_set1_ps(inverse_direction.z) };
+        const __m128 max_distance = _mm_set1_ps(ray.max_distance);
+
+        for (; i + 4 <= count; i += 4)
+        {
+            const AABB& b0 = bounds[ids[i]];
+            const AABB& b1 = bounds[ids[i + 1]];
+            const AABB& b2 = bounds[ids[i + 2]];
+            const AABB& b3 = bounds[ids[i + 3]];
+
+            __m128 t_enter = _mm_setzero_ps();
+            __m128 t_exit = max_distance;
+            for (int32 axis = 0; axis < 3; ++axis)
+            {
+                const __m128 box_min = _mm_setr_ps(b0.min[axis], b1.min[axis], b2.min[axis], b3.min[axis]);
+                const __m128 box_max = _mm_setr_ps(b0.max[axis], b1.max[axis], b2.max[axis], b3.max[axis]);
+                const __m128 t_a = _mm_mul_ps(_mm_sub_ps(box_min, origin[axis]), inverse[axis]);
+                const __m128 t_b = _mm_mul_ps(_mm_sub_ps(box_max, origin[axis]), inverse[axis]);
+                // max/min return the second operand on NaN, so the running values stay
+                t_enter = _mm_max_ps(_mm_min_ps(t_a, t_b), t_enter);
+                t_exit = _mm_min_ps(_mm_max_ps(t_a, t_b), t_exit);
+            }
+
+            const int32 hit_mask = _mm_movemask_ps(_mm_cmple_ps(t_enter, t_exit));
+            if (hit_mask == 0)
+            {
+                continue;
+            }
+
+            alignas(16) float distances[4];
+            _mm_store_ps(distances, t_enter);
+            for (int32 lane = 0; lane < 4; ++lane)
+            {
+                if (hit_mask & (1 << lane))
+                {
+                    out_hits.push_back({ distances[lane], ids[i + lane] });
+                }
+            }
+        }
+#endif
+
+        for (; i < count; ++i)
+        {
+            float distance;
+            if (ray_hits_bounds(bounds[ids[i]], ray.origin, inverse_direction, ray.max_distance, distance))
+            {
+                out_hits.push_back({ distance, ids[i] });
+            }
+        }
+
+        return static_cast<int32>(out_hits.size() - previous_size);
+    }
+
+    bool raycast(const Collider& collider, const vec3& p, const quat& o, const Ray& ray, float& out_distance, vec3& out_normal)
+    {
+        if (collider.type == Collider::Sphere)
+        {
+            return ray_sphere(ray.origin, ray.direction, p, collider.shape.sphere.radius, ray.max_distance, out_distance, out_normal);
+        }
+
+        // The rest is tested in the collider's frame, rotating keeps the distances
+        if (collider.type == Collider::Convex_Hull)
+        {
+            vec3 axes[3];
+            get_axes(o, axes);
+
+            vec3 normal;
+            const Convex_Hull_Resource& hull = Convex_Hull_Pool::get().get_hull(collider.convex_hull);
+            if (!ray_hull(hull, to_local(axes, ray.origin - p), to_local(axes, ray.direction), ray.max_distance, out_distance, normal))
+            {
+                return false;
+            }
+
+            out_normal = to_world(axes, normal);
+            return true;
+        }
+
+        const Oriented_Box box = get_oriented_box(collider, p, o);
+        const vec3 origin = to_local(box.axes, ray.origin - box.center);
+        const vec3 direction = to_local(box.axes, ray.direction);
+
+        vec3 normal;
+        bool hit = false;
+        switch (collider.type)
+        {
+        case Collider::Capsule:
+            hit = ray_capsule(origin, direction, collider.shape.capsule.radius, collider.shape.capsule.length * 0.5f, ray.max_distance, out_distance, normal);
+            break;
+        case Collider::Cylinder:
+            hit = ray_cylinder(origin, direction, collider.shape.cylinder.radius, collider.shape.cylinder.height * 0.5f, ray.max_distance, out_distance, normal);
+            break;
+        default:
+            hit = ray_box(origin, direction, box.half_extents, ray.max_distance, out_distance, normal);
+            break;
+        }
+
+        if (hit)
+        {
+            out_normal = to_world(box.axes, normal);
+        }
+        return hit;
+    }
+
+    bool overlaps_sphere(const Collider& collider, const vec3& p, const quat& o, const Sphere_Query& sphere)
+    {
+        if (collider.type == Collider::Sphere)
+        {
+            const float radius = collider.shape.sphere.radius + sphere.radius;
+            return (sphere.center - p).length_squared() <= radius * radius;
+        }
+
+        if (collider.type == Collider::Convex_Hull)
+        {
+            return Collision_Helpers::overlaps_sphere(collider, p, o, sphere.center, sphere.radius);
+        }
+
+        const Oriented_Box box = get_oriented_box(collider, p, o);
+        const vec3 center = to_local(box.axes, sphere.center - box.center);
+
+        // Closest point of the shape to the sphere's center, in the collider's frame
+        vec3 closest;
+        float radius = sphere.radius;
+        switch (collider.type)
+        {
+        case Collider::Capsule:
+        {
+            const float half_length = collider.shape.capsule.length * 0.5f;
+            closest = vec3(0.0f, 0.0f, clamp(center.z, -half_length, half_length));
+            radius += collider.shape.capsule.radius;
+            break;
+        }
+        case Collider::Cylinder:
+        {
+            const float cylinder_radius = collider.shape.cylinder.radius;
+            closest = vec3(center.x, center.y, clamp(center.z, -box.half_extents.z, box.half_extents.z));
+            const float radial_squared = center.x * center.x + center.y * center.y;
+            if (radial_squared > cylinder_radius * cylinder_radius)
+            {
+                const float scale = cylinder_radius / sqrtf(radial_squared);
+                closest.x *= scale;
+                closest.y *= scale;
+            }
+            break;
+        }
+        default:
+            closest = vec3(
+                clamp(center.x, -box.half_extents.x, box.half_extents.x),
+                clamp(center.y, -box.half_extents.y, box.half_extents.y),
+                clamp(center.z, -box.half_extents.z, box.half_extents.z));
+            break;
+        }
+
+        return (center - closest).length_squared() <= radius * radius;
+    }
+
+    bool overlaps_aabb(const Collider& collider, const vec3& p, const quat& o, const AABB& world_bounds, const AABB& box)
+    {
+        switch (collider.type)
+        {
+        case Collider::Sphere:
+        {
+            const float radius = collider.shape.sphere.radius;
+            return distance_squared_to_bounds(p, box) <= radius * radius;
+        }
+        case Collider::Capsule:
+        {
+            vec3 axes[3];
+            get_axes(o, axes);
+            const float radius = collider.shape.capsule.radius;
+            const vec3 half_segment = axes[2] * (collider.shape.capsule.length * 0.5f);
+            return segment_distance_squared_to_bounds(p - half_segment, p + half_segment, box) <= radius * radius;
+        }
+        default:
+            // A box that covers the world bounds covers the shape, no need for the axes
+            if (box.min.x <= world_bounds.min.x && box.min.y <= world_bounds.min.y && box.min.z <= world_bounds.min.z &&
+                box.max.x >= world_bounds.max.x && box.max.y >= world_bounds.max.y && box.max.z >= world_bounds.max.z)
+            {
+                return true;
+            }
+
+            if (collider.type == Collider::Box)
+            {
+                return oriented_box_overlaps_bounds(get_oriented_box(collider, p, o), box);
+            }
+            return Collision_Helpers::overlaps_bounds(collider, p, o, box);
+        }
+    }
+
+    bool overlaps_frustum(const AABB& bounds, const vec4 (&planes)[6])
+    {
+        for (const vec4& plane : planes)
+        {
+            // The corner furthest along the plane normal
+            const vec3 corner(
+                plane.x >= 0.0f ? bounds.max.x : bounds.min.x,
+                plane.y >= 0.0f ? bounds.max.y : bounds.min.y,
+                plane.z >= 0.0f ? bounds.max.z : bounds.min.z);
+
+            if (plane.xyz.dot(corner) + plane.w < 0.0f)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,57 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Ray and overlap tests for scene queries.
+// Broadphase candidates first go through raycast_bounds, a slab test four boxes at a time,
+// and only the boxes it lets through get the exact test against their collider.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/math/math.hpp"
+#include "cs/containers/dynamic_array.hpp"
+
+struct Collider;
+
+struct Ray
+{
+    vec3 origin { vec3::zero_vector };
+    // Normalized, distances are measured along it
+    vec3 direction { vec3::forward_vector };
+    float max_distance { FLT_MAX };
+};
+
+struct Sphere_Query
+{
+    vec3 center { vec3::zero_vector };
+    float radius { 0.0f };
+};
+
+struct Ray_Bounds_Hit
+{
+    // Where the ray enters the box, 0 if it starts inside
+    float distance;
+    uint32 id;
+};
+
+namespace Scene_Query_Function
+{
+    // Slab tests of the ray against bounds[ids[i]], appends every box hit within max_distance,
+    // in ids order, returns how many were added
+    int32 raycast_bounds(const Ray& ray, const AABB* bounds, const uint32* ids, int64 count, Dynamic_Array<Ray_Bounds_Hit>& out_hits);
+
+    // Collider placed at p with orientation o. A ray starting inside hits at distance 0,
+    // with the normal against the ray
+    bool raycast(const Collider& collider, const vec3& p, const quat& o, const Ray& ray, float& out_distance, vec3& out_normal);
+
+    bool overlaps_sphere(const Collider& collider, const vec3& p, const quat& o, const Sphere_Query& sphere);
+
+    // world_bounds is the collider's box in world space, only used to accept boxes covering all of it.
+    // Exact for every shape, cylinders and hulls go through Collision_Helpers::overlaps_bounds' GJK
+    bool overlaps_aabb(const Collider& collider, const vec3& p, const quat& o, const AABB& world_bounds, const AABB& box);
+
+    // Planes point inwards, dot(plane.xyz, point) + plane.w >= 0 is inside.
+    // Boxes only partly inside count, boxes outside near a corner can count too
+    bool overlaps_frustum(const AABB& bounds, const vec4 (&planes)[6]);
+}
@@ -57,7 +57,7 @@ void Profiler::write_to_chrometracing_json(const std::string& filename)
     std::ofstream file(filename);
     file << "{ \"traceEvents\": [\n";
     for (int32 i = 0; i < _entries.size(); ++i) {
-        file << "  { \"name\": \"" << _entries[i].name.str << "\", "
+        file << "  { \"name\": \"" << _entries[i].name.c_str() << "\", "
             << "\"ph\": \"" << _entries[i].phase << "\", "
             << "\"ts\": " << _entries[i].timestamp << ", "
             << "\"pid\": 0, "
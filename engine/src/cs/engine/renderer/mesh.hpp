@@ -11,6 +11,8 @@ struct Instance_Data
 	mat4 instance_matrix;
 };
 
+DECLARE_TRIVIALLY_RELOCATABLE(Instance_Data)
+
 class Mesh
 {
 public:
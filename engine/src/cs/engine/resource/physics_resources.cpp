@@ -0,0 +1,444 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/engine/resource/physics_resources.hpp"
+#include "cs/math/simd.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace
+{
+    struct Hull_Face
+    {
+        uint32 vertices[3];
+        vec3 normal;
+        float distance;
+    };
+
+    struct Directed_Edge
+    {
+        uint32 from, to;
+        uint32 face;
+    };
+
+    // Oriented so that inside_point is behind it
+    Hull_Face make_face(const vec3* points, uint32 a, uint32 b, uint32 c, const vec3& inside_point)
+    {
+        Hull_Face face { { a, b, c } };
+        face.normal = (points[b] - points[a]).cross(points[c] - points[a]).normalized();
+        if (face.normal.dot(inside_point - points[a]) > 0.0f)
+        {
+            std::swap(face.vertices[1], face.vertices[2]);
+            face.normal = -face.normal;
+        }
+        face.distance = face.normal.dot(points[a]);
+        return face;
+    }
+
+    // Incremental hull, every point outside the current hull replaces the faces it sees with
+    // a fan from the horizon to itself
+    bool build_hull_faces(const vec3* points, int32 count, Dynamic_Array<Hull_Face>& out_faces)
+    {
+        if (count < 4)
+        {
+            return false;
+        }
+
+        AABB point_bounds(points[0], points[0]);
+        for (int32 i = 1; i < count; ++i)
+        {
+            point_bounds.expand(points[i]);
+        }
+        const vec3 size = point_bounds.max - point_bounds.min;
+        const float epsilon = std::max(size.x, std::max(size.y, size.z)) * 1e-5f;
+
+        // Starting tetrahedron from the extreme points
+        uint32 initial[4] = { 0, 0, 0, 0 };
+        float best = -1.0f;
+        for (int32 axis = 0; axis < 3; ++axis)
+        {
+            uint32 min_index = 0, max_index = 0;
+            for (int32 i = 1; i < count; ++i)
+            {
+                min_index = points[i][axis] < points[min_index][axis] ? i : min_index;
+                max_index = points[i][axis] > points[max_index][axis] ? i : max_index;
+            }
+
+            const float distance = (points[max_index] - points[min_index]).length_squared();
+            if (distance > best)
+            {
+                best = distance;
+                initial[0] = min_index;
+                initial[1] = max_index;
+            }
+        }
+
+        const vec3 line = (points[initial[1]] - points[initial[0]]).normalized();
+        best = epsilon;
+        for (int32 i = 0; i < count; ++i)
+        {
+            const vec3 offset = points[i] - points[initial[0]];
+            const float distance = (offset - line * offset.dot(line)).length();
+            if (distance > best)
+            {
+                best = distance;
+                initial[2] = i;
+            }
+        }
+        if (best == epsilon)
+        {
+            return false;
+        }
+
+        const vec3 plane_normal = (points[initial[1]] - points[initial[0]]).cross(points[initial[2]] - points[initial[0]]).normalized();
+        best = epsilon;
+        for (int32 i = 0; i < count; ++i)
+        {
+            const float distance = fabs(plane_normal.dot(points[i] - points[initial[0]]));
+            if (distance > best)
+            {
+                best = distance;
+                initial[3] = i;
+            }
+        }
+        if (best == epsilon)
+        {
+            return false;
+        }
+
+        const vec3 inside_point = (points[initial[0]] + points[initial[1]] + points[initial[2]] + points[initial[3]]) * 0.25f;
+        out_faces.clear();
+        out_faces.push_back(make_face(points, initial[0], initial[1], initial[2], inside_point));
+        out_faces.push_back(make_face(points, initial[0], initial[1], initial[3], inside_point));
+        out_faces.push_back(make_face(points, initial[0], initial[2], initial[3], inside_point));
+        out_faces.push_back(make_face(points, initial[1], initial[2], initial[3], inside_point));
+
+        Dynamic_Array<uint32> visible_faces;
+        Dynamic_Array<Directed_Edge> horizon;
+        for (int32 i = 0; i < count; ++i)
+        {
+            const vec3& point = points[i];
+
+            visible_faces.clear();
+            for (int64 face = 0; face < out_faces.size(); ++face)
+            {
+                if (out_faces[face].normal.dot(point) - out_faces[face].distance > epsilon)
+                {
+                    visible_faces.push_back(static_cast<uint32>(face));
+                }
+            }
+
+            if (visible_faces.size() == 0)
+            {
+                continue;
+            }
+
+            // Edges of the visible faces whose twin belongs to a face that stays
+            horizon.clear();
+            for (uint32 face : visible_faces)
+            {
+                for (int32 k = 0; k < 3; ++k)
+                {
+                    const uint32 from = out_faces[face].vertices[k];
+                    const uint32 to = out_faces[face].vertices[(k + 1) % 3];
+
+                    bool is_shared = false;
+                    for (uint32 other_face : visible_faces)
+                    {
+                        const uint32 (&other)[3] = out_faces[other_face].vertices;
+                        for (int32 j = 0; j < 3 && !is_shared; ++j)
+                        {
+                            is_shared = other[j] == to && other[(j + 1) % 3] == from;
+                        }
+                    }
+
+                    if (!is_shared)
+                    {
+                        horizon.push_back({ from, to, face });
+                    }
+                }
+            }
+
+            // Highest index first, so swap removing doesn't move a face that's still to go
+            std::sort(visible_faces.begin(), visible_faces.end(), [](uint32 a, uint32 b) { return a > b; });
+            for (uint32 face : visible_faces)
+            {
+                out_faces.swap_remove(face);
+            }
+
+            for (const Directed_Edge& edge : horizon)
+            {
+                out_faces.push_back(make_face(points, edge.from, edge.to, static_cast<uint32>(i), inside_point));
+            }
+        }
+
+        return true;
+    }
+}
+
+bool Convex_Hull_Resource::initialize_from_points(const vec3* points, int32 count)
+{
+    Dynamic_Array<Hull_Face> faces;
+    if (!build_hull_faces(points, count, faces))
+    {
+        return false;
+    }
+
+    // Only the points the faces use are kept
+    Dynamic_Array<uint32> remap;
+    remap.resize(count, 0xFFFFFFFF);
+    vertices.clear();
+    for (Hull_Face& face : faces)
+    {
+        for (uint32& vertex : face.vertices)
+        {
+            if (remap[vertex] == 0xFFFFFFFF)
+            {
+                remap[vertex] = static_cast<uint32>(vertices.size());
+                vertices.push_back(points[vertex]);
+            }
+            vertex = remap[vertex];
+        }
+    }
+    assert(vertices.size() <= max_vertices);
+
+    face_indices.clear();
+    face_planes.clear();
+    face_indices.reserve(faces.size() * 3);
+    face_planes.reserve(faces.size());
+    for (const Hull_Face& face : faces)
+    {
+        face_indices.push_back(static_cast<uint16>(face.vertices[0]));
+        face_indices.push_back(static_cast<uint16>(face.vertices[1]));
+        face_indices.push_back(static_cast<uint16>(face.vertices[2]));
+        face_planes.push_back(vec4(face.normal, face.distance));
+    }
+
+    // Every edge shows up once in each direction, sorting by the undirected edge puts the two next to each other
+    Dynamic_Array<Directed_Edge> directed_edges;
+    directed_edges.reserve(faces.size() * 3);
+    for (int64 face = 0; face < faces.size(); ++face)
+    {
+        for (int32 k = 0; k < 3; ++k)
+        {
+            directed_edges.push_back({ faces[face].vertices[k], faces[face].vertices[(k + 1) % 3], static_cast<uint32>(face) });
+        }
+    }
+    std::sort(directed_edges.begin(), directed_edges.end(), [](const Directed_Edge& a, const Directed_Edge& b) {
+        const uint64 a_key = (static_cast<uint64>(std::min(a.from, a.to)) << 32) | std::max(a.from, a.to);
+        const uint64 b_key = (static_cast<uint64>(std::min(b.from, b.to)) << 32) | std::max(b.from, b.to);
+        return a_key < b_key || (a_key == b_key && a.from < b.from);
+    });
+
+    edges.clear();
+    edges.reserve(directed_edges.size() / 2);
+    for (int64 i = 0; i + 1 < directed_edges.size(); i += 2)
+    {
+        // The one going from the smaller index sorts first
+        const Directed_Edge& forward = directed_edges[i];
+        const Directed_Edge& backward = directed_edges[i + 1];
+        assert(forward.from == backward.to && forward.to == backward.from);
+        edges.push_back({ { static_cast<uint16>(forward.from), static_cast<uint16>(forward.to) },
+            { static_cast<uint16>(forward.face), static_cast<uint16>(backward.face) } });
+    }
+
+    vertex_neighbour_offsets.clear();
+    vertex_neighbour_offsets.resize(vertices.size() + 1, 0);
+    for (const Edge& edge : edges)
+    {
+        vertex_neighbour_offsets[edge.vertices[0] + 1]++;
+        vertex_neighbour_offsets[edge.vertices[1] + 1]++;
+    }
+    for (int64 i = 1; i < vertex_neighbour_offsets.size(); ++i)
+    {
+        vertex_neighbour_offsets[i] += vertex_neighbour_offsets[i - 1];
+    }
+
+    vertex_neighbours.resize(edges.size() * 2);
+    Dynamic_Array<uint32> fill(vertex_neighbour_offsets);
+    for (const Edge& edge : edges)
+    {
+        vertex_neighbours[fill[edge.vertices[0]]++] = edge.vertices[1];
+        vertex_neighbours[fill[edge.vertices[1]]++] = edge.vertices[0];
+    }
+
+    bounds = AABB(vertices[0], vertices[0]);
+    for (const vec3& vertex : vertices)
+    {
+        bounds.expand(vertex);
+    }
+
+    // Tetrahedra from a point inside to every face. Their covariances add up to the hull's,
+    // the inertia tensor follows from that
+    const vec3 origin = bounds.get_center();
+    float covariance[3][3] = {};
+    vec3 weighted_center = vec3::zero_vector;
+    volume = 0.0f;
+    for (const Hull_Face& face : faces)
+    {
+        const vec3 a = vertices[face.vertices[0]] - origin;
+        const vec3 b = vertices[face.vertices[1]] - origin;
+        const vec3 c = vertices[face.vertices[2]] - origin;
+        const float determinant = a.dot(b.cross(c));
+
+        volume += determinant / 6.0f;
+        weighted_center += (a + b + c) * (determinant / 24.0f);
+
+        const vec3 sum = a + b + c;
+        for (int32 row = 0; row < 3; ++row)
+        {
+            for (int32 column = 0; column < 3; ++column)
+            {
+                covariance[row][column] += determinant / 120.0f *
+                    (a[row] * a[column] + b[row] * b[column] + c[row] * c[column] + sum[row] * sum[column]);
+            }
+        }
+    }
+    assert(volume > 0.0f);
+
+    const vec3 center = weighted_center / volume;
+    center_of_mass = origin + center;
+
+    // Moved to the center of mass and scaled down to a mass of 1
+    for (int32 row = 0; row < 3; ++row)
+    {
+        for (int32 column = 0; column < 3; ++column)
+        {
+            covariance[row][column] = covariance[row][column] / volume - center[row] * center[column];
+        }
+    }
+
+    const float trace = covariance[0][0] + covariance[1][1] + covariance[2][2];
+    inertia_tensor = mat4(1.0f);
+    for (int32 column = 0; column < 3; ++column)
+    {
+        for (int32 row = 0; row < 3; ++row)
+        {
+            inertia_tensor[column][row] = (row == column ? trace : 0.0f) - covariance[row][column];
+        }
+    }
+
+    return true;
+}
+
+int32 Convex_Hull_Resource::find_support_vertex(const vec3& direction, int32 start_vertex) const
+{
+    if (vertices.size() < climbing_min_vertices)
+    {
+        return find_support_vertex_linear(direction);
+    }
+
+    return find_support_vertex_climbing(direction, start_vertex);
+}
+
+int32 Convex_Hull_Resource::find_support_vertex_linear(const vec3& direction) const
+{
+    const int32 count = static_cast<int32>(vertices.size());
+    int32 best_index = 0;
+    float best_distance = -FLT_MAX;
+    int32 v = 0;
+
+#ifdef CS_SSE2
+    if (count >= 4)
+    {
+        const __m128 direction_x = _mm_set1_ps(direction.x);
+        const __m128 direction_y = _mm_set1_ps(direction.y);
+        const __m128 direction_z = _mm_set1_ps(direction.z);
+
+        // Each lane keeps the best of every fourth vertex
+        __m128 best_distances = _mm_set1_ps(-FLT_MAX);
+        __m128i best_indices = _mm_setzero_si128();
+        __m128i indices = _mm_setr_epi32(0, 1, 2, 3);
+        const __m128i step = _mm_set1_epi32(4);
+
+        for (; v + 4 <= count; v += 4)
+        {
+            const Vec3_Lanes lanes = load_vec3s(&vertices[v]);
+            const __m128 distances = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lanes.x, direction_x), _mm_mul_ps(lanes.y, direction_y)), _mm_mul_ps(lanes.z, direction_z));
+
+            const __m128 is_further = _mm_cmpgt_ps(distances, best_distances);
+            best_distances = _mm_max_ps(distances, best_distances);
+            best_indices = _mm_or_si128(_mm_and_si128(_mm_castps_si128(is_further), indices),
+                _mm_andnot_si128(_mm_castps_si128(is_further), best_indices));
+            indices = _mm_add_epi32(indices, step);
+        }
+
+        alignas(16) float lane_distances[4];
+        alignas(16) int32 lane_indices[4];
+        _mm_store_ps(lane_distances, best_distances);
+        _mm_store_si128(reinterpret_cast<__m128i*>(lane_indices), best_indices);
+        for (int32 lane = 0; lane < 4; ++lane)
+        {
+            // Ties go to the lower index, like the scalar scan
+            if (lane_distances[lane] > best_distance || (lane_distances[lane] == best_distance && lane_indices[lane] < best_index))
+            {
+                best_distance = lane_distances[lane];
+                best_index = lane_indices[lane];
+            }
+        }
+    }
+#endif
+
+    for (; v < count; ++v)
+    {
+        const float distance = vertices[v].dot(direction);
+        if (distance > best_distance)
+        {
+            best_distance = distance;
+            best_index = v;
+        }
+    }
+
+    return best_index;
+}
+
+int32 Convex_Hull_Resource::find_support_vertex_climbing(const vec3& direction, int32 start_vertex) const
+{
+    assert(start_vertex >= 0 && start_vertex < vertices.size());
+
+    int32 current = start_vertex;
+    float current_distance = vertices[current].dot(direction);
+    while (true)
+    {
+        // Steepest neighbour, every step is strictly further so it can't go around in circles
+        int32 next = current;
+        for (uint32 i = vertex_neighbour_offsets[current]; i < vertex_neighbour_offsets[current + 1]; ++i)
+        {
+            const int32 neighbour = vertex_neighbours[i];
+            const float distance = vertices[neighbour].dot(direction);
+            if (distance > current_distance)
+            {
+                current_distance = distance;
+                next = neighbour;
+            }
+        }
+
+        if (next == current)
+        {
+            return current;
+        }
+        current = next;
+    }
+}
+
+template<>
+Convex_Hull_Pool* Singleton<Convex_Hull_Pool>::_singleton { nullptr };
+
+Convex_Hull_Handle Convex_Hull_Pool::create_hull(const Name_Id& name, const vec3* points, int32 count)
+{
+    Convex_Hull_Resource hull;
+    hull.name = name;
+    if (!hull.initialize_from_points(points, count))
+    {
+        printf("Convex hull %s has no volume\n", name.c_str());
+        return Convex_Hull_Handle();
+    }
+
+    return _hulls.insert(std::move(hull));
+}
+
+bool Convex_Hull_Pool::remove_hull(const Convex_Hull_Handle& handle)
+{
+    return _hulls.remove(handle);
+}
@@ -0,0 +1,86 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Convex hull geometry shared between colliders.
+// Colliders only keep a Convex_Hull_Handle, the vertices and everything derived from them
+// are built once when the hull is added to the Convex_Hull_Pool and don't change after.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/math/math.hpp"
+#include "cs/engine/resource.hpp"
+#include "cs/containers/dynamic_array.hpp"
+#include "cs/containers/slot_map.hpp"
+
+class Convex_Hull_Resource : public Resource
+{
+public:
+    // Faces are triangles, so 16 bits are enough for their indices too
+    static constexpr int32 max_vertices = 1 << 15;
+    // Below this a linear scan is cheaper than climbing the neighbours
+    static constexpr int32 climbing_min_vertices = 64;
+
+    struct Edge
+    {
+        // Smaller index first
+        uint16 vertices[2];
+        // Face on the left going from vertices[0] to vertices[1], then the one on the right
+        uint16 faces[2];
+    };
+
+    // In the collider's frame
+    Dynamic_Array<vec3> vertices;
+    // Three per face, counter clockwise seen from outside
+    Dynamic_Array<uint16> face_indices;
+    // Outward normal in xyz, plane's distance from the origin in w
+    Dynamic_Array<vec4> face_planes;
+    Dynamic_Array<Edge> edges;
+    // Neighbours of vertex i are vertex_neighbours[vertex_neighbour_offsets[i]] up to
+    // vertex_neighbours[vertex_neighbour_offsets[i + 1]]
+    Dynamic_Array<uint32> vertex_neighbour_offsets;
+    Dynamic_Array<uint16> vertex_neighbours;
+
+    AABB bounds { AABB::empty_box };
+    float volume { 0.0f };
+    vec3 center_of_mass { vec3::zero_vector };
+    // Around center_of_mass, for a mass of 1
+    mat4 inertia_tensor { mat4(1.0f) };
+
+public:
+    int32 get_face_count() const { return static_cast<int32>(face_planes.size()); }
+
+    // Keeps only the points on the hull. False if they don't span a volume
+    bool initialize_from_points(const vec3* points, int32 count);
+
+    // Index of the vertex furthest along direction, in the hull's frame.
+    // start_vertex is only a hint, the closer it is to the answer the less climbing there is
+    int32 find_support_vertex(const vec3& direction, int32 start_vertex = 0) const;
+    // Every vertex, four at a time where there's SSE2
+    int32 find_support_vertex_linear(const vec3& direction) const;
+    // Walks to the neighbour furthest along direction until none is further.
+    // On a convex hull the first vertex without one is the furthest of all
+    int32 find_support_vertex_climbing(const vec3& direction, int32 start_vertex) const;
+};
+
+using Convex_Hull_Handle = Slot_Map_Handle<Convex_Hull_Resource>;
+
+// Hulls are only added and removed between physics steps, the steps read them from the workers
+class Convex_Hull_Pool : public Singleton<Convex_Hull_Pool>
+{
+public:
+    // Invalid handle if the points don't make a hull
+    Convex_Hull_Handle create_hull(const Name_Id& name, const vec3* points, int32 count);
+    // Colliders still using it are left with a dangling handle
+    bool remove_hull(const Convex_Hull_Handle& handle);
+
+    // nullptr if it was removed
+    const Convex_Hull_Resource* find_hull(const Convex_Hull_Handle& handle) const { return _hulls.find(handle); }
+    const Convex_Hull_Resource& get_hull(const Convex_Hull_Handle& handle) const { return _hulls[handle]; }
+
+    int64 size() const { return _hulls.size(); }
+
+private:
+    Slot_Map<Convex_Hull_Resource> _hulls;
+};
@@ -61,6 +61,8 @@ struct Vertex_Data
 	vec4 vertex_color { vec4::one_vector };
 };
 
+DECLARE_TRIVIALLY_RELOCATABLE(Vertex_Data)
+
 class Material_Resource;
 struct Submesh_Data
 {
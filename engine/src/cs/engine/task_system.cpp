@@ -3,6 +3,7 @@
 
 #include "cs/engine/task_system.hpp"
 #include "cs/engine/profiling/profiler.hpp"
+#include "cs/memory/frame_allocator.hpp"
 
 Task::Task(const Task::Job &job)
     : _job(job)
@@ -50,8 +51,8 @@ void Task::_submit_to_thread_pool()
     _job();
     _has_executed = true;
     
-    Dynamic_Array<Shared_Ptr<Task>> referencers_to_execute;
-    for (Weak_Ptr<Task> weak_referencer : _references)
+    Frame_Array<Shared_Ptr<Task>> referencers_to_execute;
+    for (const Weak_Ptr<Task>& weak_referencer : _references)
     {
         Shared_Ptr<Task> shared_referencer = weak_referencer.lock();
         if (!shared_referencer)
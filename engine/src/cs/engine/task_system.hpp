@@ -7,6 +7,8 @@
 #include "cs/engine/event.hpp"
 #include "cs/memory/weak_ptr.hpp"
 #include "cs/containers/dynamic_array.hpp"
+#include "cs/containers/small_array.hpp"
+#include "cs/containers/ring_buffer.hpp"
 #include "cs/engine/thread_pool.hpp"
 
 #include <atomic>
@@ -37,14 +39,16 @@ public:
 
 protected:
     Job _job;
-    Dynamic_Array<Shared_Ptr<Task>> _dependencies;
-    Dynamic_Array<Weak_Ptr<Task>> _references;
+    Small_Array<Shared_Ptr<Task>, 4> _dependencies;
+    Small_Array<Weak_Ptr<Task>, 4> _references;
     std::atomic<int32> _unfinished_dependencies { 0 };
     bool _has_executed { false };
 
     void _submit_to_thread_pool();
 };
 
+DECLARE_SHARED_PTR_POOL(Task)
+
 class Task_Graph
 {
 public:
@@ -58,5 +62,5 @@ private:
     Dynamic_Array<Shared_Ptr<Task>> _tasks;
     std::mutex _queue_mutex;
     std::condition_variable _condition;
-    std::queue<Shared_Ptr<Task>> _task_queue;
+    Ring_Buffer<Shared_Ptr<Task>> _task_queue;
 };
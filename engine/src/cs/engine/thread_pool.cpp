@@ -19,7 +19,6 @@ Thread_Pool* Singleton<Thread_Pool>::_singleton { nullptr };
 #include "cs/containers/dynamic_array.hpp"
 #include "cs/engine/task_system.hpp"
 
-#include <queue>
 #include <mutex>
 #include <thread>
 #include <functional>
@@ -56,23 +55,25 @@ Thread_Pool::~Thread_Pool()
     }
 }
 
-void Thread_Pool::submit(const Dynamic_Array<Shared_Ptr<Task>>& tasks)
+void Thread_Pool::submit(const Shared_Ptr<Task>* tasks, int64 count)
 {
     if (_num_threads == 0)
     {
-        for (const Shared_Ptr<Task>& task : tasks)
+        for (int64 i = 0; i < count; ++i)
         {
-            task->execute_on_this_thread();
+            tasks[i]->execute_on_this_thread();
         }
 
         return;
     }
 
+    _pending_tasks.fetch_add(count, std::memory_order_relaxed);
     {
         std::unique_lock<std::mutex> lock(_queue_mutex);
-        for (const Shared_Ptr<Task>& task : tasks)
+        _task_queue.reserve(_task_queue.size() + count);
+        for (int64 i = 0; i < count; ++i)
         {
-            _task_queue.push_back(task);
+            _task_queue.push_back(tasks[i]);
         }
     }
 
@@ -83,12 +84,97 @@ void Thread_Pool::wait_for_completion()
 {
     PROFILE_FUNCTION()
 
-    while (!_task_queue.empty())
+    // An empty queue only means the last tasks were picked up, not that they're done
+    std::unique_lock<std::mutex> lock(_queue_mutex);
+    _completion_condition.wait(lock, [this] { return _pending_tasks.load(std::memory_order_acquire) == 0; });
+}
+
+namespace
+{
+    struct Parallel_For_State
+    {
+        std::atomic<int64> next_chunk { 0 };
+        std::atomic<int64> finished_chunks { 0 };
+        int64 count { 0 };
+        int64 chunk_count { 0 };
+        // Only used while chunks are left, the caller outlives those
+        const Thread_Pool::Parallel_For_Function* function { nullptr };
+    };
+
+    void run_parallel_for_chunks(Parallel_For_State& state)
+    {
+        while (true)
+        {
+            const int64 chunk = state.next_chunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= state.chunk_count)
+            {
+                return;
+            }
+
+            const int64 begin = chunk * state.count / state.chunk_count;
+            const int64 end = (chunk + 1) * state.count / state.chunk_count;
+            (*state.function)(begin, end, chunk);
+
+            state.finished_chunks.fetch_add(1, std::memory_order_release);
+        }
+    }
+}
+
+void Thread_Pool::parallel_for(int64 count, int64 min_chunk_size, const Parallel_For_Function& function)
+{
+    const int64 chunk_count = get_chunk_count(count, min_chunk_size);
+    if (chunk_count == 0)
+    {
+        return;
+    }
+
+    if (chunk_count == 1 || _num_threads == 0)
+    {
+        for (int64 chunk = 0; chunk < chunk_count; ++chunk)
+        {
+            function(chunk * count / chunk_count, (chunk + 1) * count / chunk_count, chunk);
+        }
+        return;
+    }
+
+    // Helpers that start after every chunk was claimed just find nothing to do,
+    // the state is shared so they can still look at it after this returns
+    Shared_Ptr<Parallel_For_State> state = Shared_Ptr<Parallel_For_State>::create();
+    state->count = count;
+    state->chunk_count = chunk_count;
+    state->function = &function;
+
+    const int64 helper_count = chunk_count - 1 < _num_threads ? chunk_count - 1 : _num_threads;
+    Dynamic_Array<Shared_Ptr<Task>> helpers;
+    helpers.reserve(helper_count);
+    for (int64 i = 0; i < helper_count; ++i)
+    {
+        helpers.push_back(Shared_Ptr<Task>::create([state]() { run_parallel_for_chunks(*state); }));
+    }
+    submit(helpers);
+
+    run_parallel_for_chunks(*state);
+
+    // Only chunks already running elsewhere are left
+    while (state->finished_chunks.load(std::memory_order_acquire) < chunk_count)
     {
         std::this_thread::yield();
     }
 }
 
+int64 Thread_Pool::get_chunk_count(int64 count, int64 min_chunk_size) const
+{
+    if (count <= 0)
+    {
+        return 0;
+    }
+
+    // A few chunks per thread, so one slow chunk doesn't hold up the rest
+    const int64 max_chunks = (static_cast<int64>(_num_threads) + 1) * 4;
+    const int64 chunk_count = min_chunk_size > 0 ? count / min_chunk_size : count;
+    return clamp(chunk_count, static_cast<int64>(1), max_chunks);
+}
+
 void Thread_Pool::_thread_pool_worker()
 {
     PROFILE_FUNCTION()
@@ -110,12 +196,11 @@ void Thread_Pool::_thread_pool_worker()
                 return;
             }
 
-            current_task = _task_queue.front();
+            current_task = _task_queue.pop_front();
             if (current_task.is_valid())
             {
                 next_task = std::move(current_task->get_binding());
             }
-            _task_queue.pop_front();
         }
         
         //printf("--------- Thread %d: \n---------------\n", tid);
@@ -124,5 +209,12 @@ void Thread_Pool::_thread_pool_worker()
             next_task(); // Execute the task
         }
         //printf("--------------------------------------\n");
+
+        // Tasks submitted by this one were counted before it got here, so zero means all done
+        if (_pending_tasks.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::unique_lock<std::mutex> lock(_queue_mutex);
+            _completion_condition.notify_all();
+        }
     }
 }
@@ -10,8 +10,8 @@
 #include "cs/engine/singleton.hpp"
 #include "cs/engine/profiling/profiler.hpp"
 #include "cs/containers/dynamic_array.hpp"
+#include "cs/containers/ring_buffer.hpp"
 
-#include <queue>
 #include <mutex>
 #include <thread>
 #include <functional>
@@ -24,17 +24,38 @@ public:
     Thread_Pool(uint32 num_threads);
     ~Thread_Pool();
 
-    void submit(const Dynamic_Array<Shared_Ptr<Task>>& tasks);
+    void submit(const Shared_Ptr<Task>* tasks, int64 count);
+
+    template<typename Allocator>
+    void submit(const Dynamic_Array<Shared_Ptr<Task>, Allocator>& tasks)
+    {
+        submit(tasks.begin(), tasks.size());
+    }
+    // Returns once every submitted task, and every task they submitted, has finished
     void wait_for_completion();
 
+    using Parallel_For_Function = std::function<void(int64 begin, int64 end, int64 chunk_index)>;
+
+    // Splits [0, count) into chunks and runs them on the workers and the calling thread,
+    // returns once all of them are done. Chunks are at least min_chunk_size long (except
+    // when count is smaller). chunk_index is below get_chunk_count(count, min_chunk_size)
+    // and doesn't depend on which thread ran the chunk, so it can pick an output buffer
+    void parallel_for(int64 count, int64 min_chunk_size, const Parallel_For_Function& function);
+    int64 get_chunk_count(int64 count, int64 min_chunk_size) const;
+
+    uint32 get_num_threads() const { return _num_threads; }
+
 private:
     uint32 _num_threads;
     std::vector<std::thread> _workers; //TODO: Make own unique ptr
     // Dynamic_Array<std::thread> _workers; // TODO: introduce emplace resizing for std::thread/unique_ptr (deleted move and copy)
-    std::deque<Shared_Ptr<Task>> _task_queue;    //TODO: Make own queue container
+    Ring_Buffer<Shared_Ptr<Task>> _task_queue;
     std::mutex _queue_mutex;
     std::condition_variable _condition;
+    std::condition_variable _completion_condition;
     std::atomic<bool> _should_stop;
+    // Submitted and not finished yet, queued or running
+    std::atomic<int64> _pending_tasks { 0 };
 
 private:
     void _thread_pool_worker();
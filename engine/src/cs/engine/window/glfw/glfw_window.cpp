@@ -235,8 +235,8 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
         action == GLFW_PRESS ? 1.0f : 0.0f);
 }
 
-constexpr Name_Id mouse_pos_x_name("MOUSE_POS_X");
-constexpr Name_Id mouse_pos_y_name("MOUSE_POS_Y");
+CS_NAME_ID(mouse_pos_x_name, "MOUSE_POS_X")
+CS_NAME_ID(mouse_pos_y_name, "MOUSE_POS_Y")
 
 void cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
 {
@@ -249,8 +249,8 @@ void cursor_pos_callback(GLFWwindow* window, double xpos, double ypos)
     glfw_window->input_source.broadcast(mouse_pos_y_name, static_cast<float>(ypos) / static_cast<float>(height));
 }
 
-constexpr Name_Id mouse_scroll_x_name("MOUSE_SCROLL_X");
-constexpr Name_Id mouse_scroll_y_name("MOUSE_SCROLL_Y");
+CS_NAME_ID(mouse_scroll_x_name, "MOUSE_SCROLL_X")
+CS_NAME_ID(mouse_scroll_y_name, "MOUSE_SCROLL_Y")
 void scroll_callback(GLFWwindow* window, double scroll_x, double scroll_y)
 {
     GLFW_Window* glfw_window = static_cast<GLFW_Window*>(glfwGetWindowUserPointer(window));
@@ -7,6 +7,7 @@
 #pragma once
 
 #include "cs/cs.hpp"
+#include "cs/containers/slot_map.hpp"
 
 struct Component
 {
@@ -20,13 +21,9 @@ struct Component_Bucket
 	Type component_storage[N];
 };
 
+// Stays valid while other components are added and removed, goes stale when its own is removed
 template<typename Type>
-struct Component_Handle
-{
-	int64 index{-1};
-
-	bool is_valid() const { return index != -1; }
-};
+using Component_Handle = Slot_Map_Handle<Type>;
 
 template<int64 N, Derived<Component>...ComponentTypes>
 struct Component_Storage : private Component_Bucket<N, ComponentTypes>...
@@ -47,7 +44,7 @@ struct Component_Storage : private Component_Bucket<N, ComponentTypes>...
 template<typename Type>
 struct Dynamic_Component_Bucket
 {
-	Dynamic_Array<Type> component_storage;
+	Slot_Map<Type> component_storage;
 };
 
 template<Derived<Component>...ComponentTypes>
@@ -61,8 +58,8 @@ struct Dynamic_Component_Storage : private Dynamic_Component_Bucket<ComponentTyp
 	{
 		printf("Initializing Dynamic Component Storage with components: \n");
 		([&] {
-			Dynamic_Component_Bucket<ComponentTypes>::component_storage.reserve(N);
 			Dynamic_Component_Bucket<ComponentTypes>::component_storage.clear();
+			Dynamic_Component_Bucket<ComponentTypes>::component_storage.reserve(N);
 			printf("  \'%s\'\n", ComponentTypes::id.c_str());
 		}(), ...);
 	}
@@ -70,36 +67,52 @@ struct Dynamic_Component_Storage : private Dynamic_Component_Bucket<ComponentTyp
 	template<typename ComponentType>
 	Component_Handle<ComponentType> add()
 	{
-		Component_Handle<ComponentType> handle;
-		auto& array = get_array<ComponentType>();
-		handle.index = array.size();
-		array.push_back(ComponentType{});
-		return handle;
+		return get_components<ComponentType>().emplace();
 	}
 
 	template<typename ComponentType>
 	ComponentType& add(Component_Handle<ComponentType>& out_handle)
 	{
-		auto& array = get_array<ComponentType>();
-		out_handle.index = array.size();
-		array.push_back(ComponentType{});
-		return array[out_handle.index];
+		auto& components = get_components<ComponentType>();
+		out_handle = components.emplace();
+		return components[out_handle];
+	}
+
+	// Returns false if the handle was already stale
+	template<typename ComponentType>
+	bool remove(const Component_Handle<ComponentType>& handle)
+	{
+		return get_components<ComponentType>().remove(handle);
+	}
+
+	template<typename ComponentType>
+	bool contains(const Component_Handle<ComponentType>& handle) const
+	{
+		return Dynamic_Component_Bucket<ComponentType>::component_storage.contains(handle);
+	}
+
+	template<typename ComponentType>
+	ComponentType& get(const Component_Handle<ComponentType>& handle)
+	{
+		return Dynamic_Component_Bucket<ComponentType>::component_storage[handle];
 	}
 
+	// nullptr if the component was removed
 	template<typename ComponentType>
-	ComponentType& get(const Component_Handle<ComponentType>& index)
+	ComponentType* find(const Component_Handle<ComponentType>& handle)
 	{
-		return Dynamic_Component_Bucket<ComponentType>::component_storage[index.index];
+		return Dynamic_Component_Bucket<ComponentType>::component_storage.find(handle);
 	}
 
+	// By dense index, for iterating, which component sits where changes on remove
 	template<typename ComponentType>
 	ComponentType& get(int64 index)
 	{
-		return Dynamic_Component_Bucket<ComponentType>::component_storage[index];
+		return Dynamic_Component_Bucket<ComponentType>::component_storage.get_at(index);
 	}
 
 	template<typename ComponentType>
-	Dynamic_Array<ComponentType>& get_array()
+	Slot_Map<ComponentType>& get_components()
 	{
 		return Dynamic_Component_Bucket<ComponentType>::component_storage;
 	}
@@ -36,6 +36,8 @@ public:
     mat4 inverse() const;
 };
 
+DECLARE_TRIVIALLY_RELOCATABLE(mat4)
+
 mat4 translate(const mat4& other, const vec3& translation);
 mat4 rotate(const mat4& other, float angle, const vec3& rotation_axis);
 mat4 scale(const mat4& other, const vec3& scaling);
@@ -41,6 +41,8 @@ public:
     static fquat from_mat4(const mat4& m);
 };
 
+DECLARE_TRIVIALLY_RELOCATABLE(fquat)
+
 using quat = fquat;
 
 mat4 rotation(const fquat& rotation);
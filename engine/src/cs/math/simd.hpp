@@ -0,0 +1,58 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Four vec3s at a time, a register per component. The arrays stay interleaved in memory,
+// loading transposes x0 y0 z0 x1 ... into x0 x1 x2 x3 | y0 ... and storing transposes back.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/math/vec3.hpp"
+
+#if defined(CS_SSE2)
+#include <emmintrin.h>
+
+struct Vec3_Lanes
+{
+    __m128 x, y, z;
+};
+
+// Reads v[0] to v[3], 12 floats, no alignment needed
+inline Vec3_Lanes load_vec3s(const vec3* v)
+{
+    const float* data = reinterpret_cast<const float*>(v);
+    // x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3
+    const __m128 a = _mm_loadu_ps(data);
+    const __m128 b = _mm_loadu_ps(data + 4);
+    const __m128 c = _mm_loadu_ps(data + 8);
+
+    const __m128 x2_y2_z2_x3 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2));
+    const __m128 y0_y0_y1_y1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1));
+    const __m128 y2_y2_y3_y3 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3));
+    const __m128 z0_z0_z1_z1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2));
+    const __m128 z2_z2_z3_z3 = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0));
+
+    return {
+        _mm_shuffle_ps(a, x2_y2_z2_x3, _MM_SHUFFLE(3, 0, 3, 0)),
+        _mm_shuffle_ps(y0_y0_y1_y1, y2_y2_y3_y3, _MM_SHUFFLE(2, 0, 2, 0)),
+        _mm_shuffle_ps(z0_z0_z1_z1, z2_z2_z3_z3, _MM_SHUFFLE(2, 0, 2, 0))
+    };
+}
+
+inline void store_vec3s(vec3* v, const Vec3_Lanes& lanes)
+{
+    float* data = reinterpret_cast<float*>(v);
+    const __m128 x0_y0_x1_y1 = _mm_unpacklo_ps(lanes.x, lanes.y);
+    const __m128 x2_y2_x3_y3 = _mm_unpackhi_ps(lanes.x, lanes.y);
+
+    const __m128 z0_z0_x1_x1 = _mm_shuffle_ps(lanes.z, x0_y0_x1_y1, _MM_SHUFFLE(2, 2, 0, 0));
+    const __m128 y1_y1_z1_z1 = _mm_shuffle_ps(x0_y0_x1_y1, lanes.z, _MM_SHUFFLE(1, 1, 3, 3));
+    const __m128 z2_z2_x3_x3 = _mm_shuffle_ps(lanes.z, x2_y2_x3_y3, _MM_SHUFFLE(2, 2, 2, 2));
+    const __m128 y3_y3_z3_z3 = _mm_shuffle_ps(x2_y2_x3_y3, lanes.z, _MM_SHUFFLE(3, 3, 3, 3));
+
+    _mm_storeu_ps(data, _mm_shuffle_ps(x0_y0_x1_y1, z0_z0_x1_x1, _MM_SHUFFLE(2, 0, 1, 0)));
+    _mm_storeu_ps(data + 4, _mm_shuffle_ps(y1_y1_z1_z1, x2_y2_x3_y3, _MM_SHUFFLE(1, 0, 2, 0)));
+    _mm_storeu_ps(data + 8, _mm_shuffle_ps(z2_z2_x3_x3, y3_y3_z3_z3, _MM_SHUFFLE(2, 0, 2, 0)));
+}
+#endif //CS_SSE2
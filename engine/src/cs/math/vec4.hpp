@@ -62,6 +62,8 @@ public:
 
 };
 
+DECLARE_TRIVIALLY_RELOCATABLE(fvec4)
+
 using vec4 = fvec4;
 
 struct  ivec4
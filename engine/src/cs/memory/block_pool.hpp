@@ -0,0 +1,77 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Free list allocator for one block size. Grows in slabs and never gives memory
+// back, so types that are created and dropped all the time reuse the same blocks
+// instead of fragmenting the heap. Safe to allocate and free from any thread.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+
+#include <new>
+#include <mutex>
+
+template<int64 Block_Size, int64 Block_Alignment, int64 Blocks_Per_Slab = 64>
+class Block_Pool
+{
+public:
+    // Never destroyed, Shared_Ptrs held by statics can free their blocks after static destruction
+    static Block_Pool& get()
+    {
+        static Block_Pool* pool = new Block_Pool();
+        return *pool;
+    }
+
+    void* allocate()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_free_list == nullptr)
+        {
+            _add_slab();
+        }
+
+        Free_Block* block = _free_list;
+        _free_list = block->next;
+        return block;
+    }
+
+    void deallocate(void* ptr)
+    {
+        Free_Block* block = static_cast<Free_Block*>(ptr);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        block->next = _free_list;
+        _free_list = block;
+    }
+
+private:
+    struct Free_Block
+    {
+        Free_Block* next;
+    };
+
+    static constexpr int64 _alignment = Block_Alignment > alignof(Free_Block) ? Block_Alignment : alignof(Free_Block);
+    static constexpr int64 _size = Block_Size > static_cast<int64>(sizeof(Free_Block)) ? Block_Size : sizeof(Free_Block);
+    static constexpr int64 _stride = (_size + _alignment - 1) / _alignment * _alignment;
+
+    std::mutex _mutex;
+    Free_Block* _free_list { nullptr };
+
+private:
+    Block_Pool() = default;
+
+    void _add_slab()
+    {
+        unsigned char* slab = static_cast<unsigned char*>(::operator new(_stride * Blocks_Per_Slab, std::align_val_t(_alignment)));
+
+        for (int64 i = Blocks_Per_Slab - 1; i >= 0; --i)
+        {
+            Free_Block* block = reinterpret_cast<Free_Block*>(slab + i * _stride);
+            block->next = _free_list;
+            _free_list = block;
+        }
+    }
+};
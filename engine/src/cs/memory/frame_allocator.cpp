@@ -0,0 +1,124 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/memory/frame_allocator.hpp"
+
+#include <new>
+
+std::atomic<uint64> Frame_Allocator::_global_frame_index { 0 };
+
+Frame_Allocator::~Frame_Allocator()
+{
+    for (Arena& arena : _arenas)
+    {
+        _reset(arena);
+        ::operator delete(arena.current.memory);
+    }
+}
+
+void Frame_Allocator::begin_frame()
+{
+    _global_frame_index.fetch_add(1, std::memory_order_release);
+}
+
+uint64 Frame_Allocator::get_frame_index()
+{
+    return _global_frame_index.load(std::memory_order_acquire);
+}
+
+void* Frame_Allocator::allocate(int64 size, int64 alignment)
+{
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    Arena& arena = _get_arena();
+    Chunk* chunk = &arena.current;
+
+    uintptr_t address = reinterpret_cast<uintptr_t>(chunk->memory) + chunk->used;
+    uintptr_t aligned = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+
+    if (chunk->memory == nullptr || static_cast<int64>(aligned - address) + size > chunk->capacity - chunk->used)
+    {
+        _add_chunk(arena, size + alignment);
+
+        chunk = &arena.current;
+        address = reinterpret_cast<uintptr_t>(chunk->memory);
+        aligned = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+    }
+
+    chunk->used += static_cast<int64>(aligned - address) + size;
+    return reinterpret_cast<void*>(aligned);
+}
+
+int64 Frame_Allocator::get_used_bytes() const
+{
+    int64 used = 0;
+    for (const Arena& arena : _arenas)
+    {
+        used += arena.current.used;
+        for (const Chunk& chunk : arena.retired)
+        {
+            used += chunk.used;
+        }
+    }
+    return used;
+}
+
+int64 Frame_Allocator::get_reserved_bytes() const
+{
+    int64 reserved = 0;
+    for (const Arena& arena : _arenas)
+    {
+        reserved += arena.current.capacity;
+        for (const Chunk& chunk : arena.retired)
+        {
+            reserved += chunk.capacity;
+        }
+    }
+    return reserved;
+}
+
+Frame_Allocator::Arena& Frame_Allocator::_get_arena()
+{
+    // Lazily catch up with the engine's frame, the arena we switch to was last used
+    // two or more frames ago, so nothing in it can still be alive
+    const uint64 frame_index = _global_frame_index.load(std::memory_order_acquire);
+    Arena& arena = _arenas[frame_index & 1];
+
+    if (frame_index != _frame_index)
+    {
+        _frame_index = frame_index;
+        _reset(arena);
+    }
+
+    return arena;
+}
+
+void Frame_Allocator::_reset(Arena& arena)
+{
+    // The current chunk is the biggest one, it alone fits what the frame needed
+    for (const Chunk& chunk : arena.retired)
+    {
+        ::operator delete(chunk.memory);
+    }
+    arena.retired.clear();
+
+    arena.current.used = 0;
+}
+
+void Frame_Allocator::_add_chunk(Arena& arena, int64 min_size)
+{
+    int64 capacity = arena.current.capacity == 0 ? default_arena_size : arena.current.capacity * 2;
+    while (capacity < min_size)
+    {
+        capacity *= 2;
+    }
+
+    if (arena.current.memory)
+    {
+        arena.retired.push_back(arena.current);
+    }
+
+    arena.current.memory = static_cast<unsigned char*>(::operator new(capacity));
+    arena.current.capacity = capacity;
+    arena.current.used = 0;
+}
@@ -0,0 +1,115 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Per thread bump allocator for short lived, per frame data.
+// Every thread owns two arenas and alternates between them each frame, so memory
+// handed out in frame N stays valid until the end of frame N + 1. Freeing is a
+// no-op, the whole arena is reset when the thread first allocates two frames later.
+// If a frame outgrows its arena, extra chunks are chained and then dropped on reset,
+// keeping only the biggest, so a steady state frame doesn't touch the heap at all.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+#include "cs/engine/singleton.hpp"
+#include "cs/containers/dynamic_array.hpp"
+#include "cs/memory/memory_resource.hpp"
+
+#include <atomic>
+#include <cstddef>
+
+class Frame_Allocator : public TLS_Singleton<Frame_Allocator>
+{
+public:
+    static constexpr int64 default_arena_size = 256 * 1024;
+
+    Frame_Allocator() = default;
+    ~Frame_Allocator();
+
+    // Called by the engine at the top of every frame, on the main thread
+    static void begin_frame();
+    static uint64 get_frame_index();
+
+    void* allocate(int64 size, int64 alignment = alignof(std::max_align_t));
+    void deallocate(void* ptr, int64 size) {}
+
+    int64 get_used_bytes() const;
+    int64 get_reserved_bytes() const;
+
+private:
+    struct Chunk
+    {
+        unsigned char* memory { nullptr };
+        int64 capacity { 0 };
+        int64 used { 0 };
+    };
+
+    struct Arena
+    {
+        Chunk current;
+        // Chunks that ran out during the frame, freed on reset
+        Dynamic_Array<Chunk> retired;
+    };
+
+    Arena _arenas[2];
+    uint64 _frame_index { 0 };
+
+    static std::atomic<uint64> _global_frame_index;
+
+private:
+    Arena& _get_arena();
+    void _reset(Arena& arena);
+    void _add_chunk(Arena& arena, int64 min_size);
+};
+
+// STL style typed allocator over this thread's Frame_Allocator, for the containers.
+// Anything allocated with it must not be kept past the next frame.
+template<typename Type>
+class Frame_Allocator_T
+{
+public:
+    using value_type = Type;
+
+    Frame_Allocator_T() = default;
+
+    template<typename Other>
+    Frame_Allocator_T(const Frame_Allocator_T<Other>&) {}
+
+    Type* allocate(std::size_t count)
+    {
+        return static_cast<Type*>(Frame_Allocator::get().allocate(count * sizeof(Type), alignof(Type)));
+    }
+
+    void deallocate(Type* ptr, std::size_t count)
+    {
+        Frame_Allocator::get().deallocate(ptr, count * sizeof(Type));
+    }
+
+    template<typename Other>
+    bool operator==(const Frame_Allocator_T<Other>&) const { return true; }
+
+    template<typename Other>
+    bool operator!=(const Frame_Allocator_T<Other>&) const { return false; }
+};
+
+template<typename Type>
+using Frame_Array = Dynamic_Array<Type, Frame_Allocator_T<Type>>;
+
+// Same thing for containers taking a Resource_Allocator
+class Frame_Memory_Resource : public Memory_Resource
+{
+public:
+    void* allocate(int64 size, int64 alignment) override
+    {
+        return Frame_Allocator::get().allocate(size, alignment);
+    }
+
+    void deallocate(void* ptr, int64 size, int64 alignment) override {}
+
+    static Frame_Memory_Resource* get()
+    {
+        static Frame_Memory_Resource resource;
+        return &resource;
+    }
+};
@@ -0,0 +1,33 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/memory/memory_resource.hpp"
+
+#include <new>
+
+Memory_Resource* Memory_Resource::get_default()
+{
+    static Heap_Memory_Resource heap;
+    return &heap;
+}
+
+void* Heap_Memory_Resource::allocate(int64 size, int64 alignment)
+{
+    if (alignment > static_cast<int64>(alignof(std::max_align_t)))
+    {
+        return ::operator new(size, std::align_val_t(alignment));
+    }
+
+    return ::operator new(size);
+}
+
+void Heap_Memory_Resource::deallocate(void* ptr, int64 size, int64 alignment)
+{
+    if (alignment > static_cast<int64>(alignof(std::max_align_t)))
+    {
+        ::operator delete(ptr, std::align_val_t(alignment));
+        return;
+    }
+
+    ::operator delete(ptr);
+}
@@ -0,0 +1,99 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Polymorphic source of memory, so a container's storage can be placed in an arena,
+// pool or tracked heap picked at runtime instead of being baked into its type.
+// Resource_Allocator<T> is the stateful allocator containers take to use one.
+// Like std::pmr, a container keeps the resource it was created with: copy and move
+// assignment don't propagate it, moving between different resources moves elements.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+
+#include <cstddef>
+#include <type_traits>
+
+class Memory_Resource
+{
+public:
+    virtual ~Memory_Resource() = default;
+
+    virtual void* allocate(int64 size, int64 alignment) = 0;
+    virtual void deallocate(void* ptr, int64 size, int64 alignment) = 0;
+
+    // Memory from one can be freed through the other
+    virtual bool is_equal(const Memory_Resource& other) const { return this == &other; }
+
+    // Plain heap, used when no resource is given
+    static Memory_Resource* get_default();
+};
+
+class Heap_Memory_Resource : public Memory_Resource
+{
+public:
+    void* allocate(int64 size, int64 alignment) override;
+    void deallocate(void* ptr, int64 size, int64 alignment) override;
+};
+
+template<typename Type>
+class Resource_Allocator
+{
+public:
+    using value_type = Type;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::false_type;
+    using propagate_on_container_swap = std::false_type;
+    using is_always_equal = std::false_type;
+
+    Resource_Allocator()
+        : _resource(Memory_Resource::get_default())
+    {
+    }
+
+    Resource_Allocator(Memory_Resource* resource)
+        : _resource(resource)
+    {
+        assert(_resource);
+    }
+
+    template<typename Other>
+    Resource_Allocator(const Resource_Allocator<Other>& other)
+        : _resource(other.get_resource())
+    {
+    }
+
+    Type* allocate(std::size_t count)
+    {
+        return static_cast<Type*>(_resource->allocate(count * sizeof(Type), alignof(Type)));
+    }
+
+    void deallocate(Type* ptr, std::size_t count)
+    {
+        _resource->deallocate(ptr, count * sizeof(Type), alignof(Type));
+    }
+
+    // Copies of a container go back to the default resource, same as std::pmr
+    Resource_Allocator select_on_container_copy_construction() const
+    {
+        return Resource_Allocator();
+    }
+
+    Memory_Resource* get_resource() const { return _resource; }
+
+    template<typename Other>
+    bool operator==(const Resource_Allocator<Other>& other) const
+    {
+        return _resource == other.get_resource() || _resource->is_equal(*other.get_resource());
+    }
+
+    template<typename Other>
+    bool operator!=(const Resource_Allocator<Other>& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    Memory_Resource* _resource;
+};
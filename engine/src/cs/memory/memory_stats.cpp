@@ -0,0 +1,77 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+
+#include "cs/memory/memory_stats.hpp"
+
+#include <atomic>
+
+namespace
+{
+    struct Counters
+    {
+        std::atomic<int64> allocations { 0 };
+        std::atomic<int64> deallocations { 0 };
+        std::atomic<int64> live_bytes { 0 };
+        std::atomic<int64> peak_bytes { 0 };
+    };
+
+    Counters counters[Container_Family::COUNT];
+}
+
+void Memory_Stats::on_allocate(Container_Family::Type family, int64 bytes)
+{
+    Counters& family_counters = counters[family];
+    family_counters.allocations.fetch_add(1, std::memory_order_relaxed);
+
+    const int64 live = family_counters.live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    int64 peak = family_counters.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !family_counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+}
+
+void Memory_Stats::on_deallocate(Container_Family::Type family, int64 bytes)
+{
+    Counters& family_counters = counters[family];
+    family_counters.deallocations.fetch_add(1, std::memory_order_relaxed);
+    family_counters.live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+Memory_Stats::Snapshot Memory_Stats::get_snapshot(Container_Family::Type family)
+{
+    const Counters& family_counters = counters[family];
+
+    Snapshot snapshot;
+    snapshot.allocations = family_counters.allocations.load(std::memory_order_relaxed);
+    snapshot.deallocations = family_counters.deallocations.load(std::memory_order_relaxed);
+    snapshot.live_bytes = family_counters.live_bytes.load(std::memory_order_relaxed);
+    snapshot.peak_bytes = family_counters.peak_bytes.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+const char* Memory_Stats::get_family_name(Container_Family::Type family)
+{
+    switch (family)
+    {
+    case Container_Family::Dynamic_Array: return "Dynamic_Array";
+    case Container_Family::Small_Array: return "Small_Array";
+    case Container_Family::Ring_Buffer: return "Ring_Buffer";
+    case Container_Family::Hash_Map: return "Hash_Map";
+    case Container_Family::Flat_Hash_Map: return "Flat_Hash_Map";
+    default: return "Unknown";
+    }
+}
+
+void Memory_Stats::print()
+{
+#ifdef CS_WITH_MEMORY_TRACKING
+    printf("%-16s %12s %12s %14s %14s\n", "container", "allocs", "frees", "live bytes", "peak bytes");
+    for (uint8 family = 0; family < Container_Family::COUNT; ++family)
+    {
+        const Snapshot snapshot = get_snapshot(static_cast<Container_Family::Type>(family));
+        printf("%-16s %12lld %12lld %14lld %14lld\n", get_family_name(static_cast<Container_Family::Type>(family)),
+            (long long)snapshot.allocations, (long long)snapshot.deallocations,
+            (long long)snapshot.live_bytes, (long long)snapshot.peak_bytes);
+    }
+#else
+    printf("Memory tracking is disabled, build with CS_WITH_MEMORY_TRACKING.\n");
+#endif //CS_WITH_MEMORY_TRACKING
+}
@@ -0,0 +1,72 @@
+// CS Engine
+// Author: matija.martinec@protonmail.com
+//
+// Allocation counters per container family, for finding out who's hitting the heap.
+// Only collected with CS_WITH_MEMORY_TRACKING, otherwise the hooks compile away.
+//
+
+#pragma once
+
+#include "cs/cs.hpp"
+
+#include <memory>
+
+namespace Container_Family
+{
+    enum Type : uint8
+    {
+        Dynamic_Array,
+        Small_Array,
+        Ring_Buffer,
+        Hash_Map,
+        Flat_Hash_Map,
+        COUNT
+    };
+}
+
+class Memory_Stats
+{
+public:
+    struct Snapshot
+    {
+        int64 allocations { 0 };
+        int64 deallocations { 0 };
+        int64 live_bytes { 0 };
+        int64 peak_bytes { 0 };
+    };
+
+    static void on_allocate(Container_Family::Type family, int64 bytes);
+    static void on_deallocate(Container_Family::Type family, int64 bytes);
+
+    static Snapshot get_snapshot(Container_Family::Type family);
+    static const char* get_family_name(Container_Family::Type family);
+    static void print();
+};
+
+#ifdef CS_WITH_MEMORY_TRACKING
+    #define CS_TRACK_ALLOCATION(family, bytes) Memory_Stats::on_allocate(family, bytes);
+    #define CS_TRACK_DEALLOCATION(family, bytes) Memory_Stats::on_deallocate(family, bytes);
+#else
+    #define CS_TRACK_ALLOCATION(family, bytes)
+    #define CS_TRACK_DEALLOCATION(family, bytes)
+#endif //CS_WITH_MEMORY_TRACKING
+
+// Allocation through allocator_traits plus the tracking hook, used by all containers
+namespace Container_Memory
+{
+    template<typename Allocator>
+    typename std::allocator_traits<Allocator>::value_type* allocate(Allocator& allocator, int64 count, Container_Family::Type family)
+    {
+        using Traits = std::allocator_traits<Allocator>;
+        CS_TRACK_ALLOCATION(family, count * static_cast<int64>(sizeof(typename Traits::value_type)))
+        return Traits::allocate(allocator, count);
+    }
+
+    template<typename Allocator>
+    void deallocate(Allocator& allocator, typename std::allocator_traits<Allocator>::value_type* ptr, int64 count, Container_Family::Type family)
+    {
+        using Traits = std::allocator_traits<Allocator>;
+        CS_TRACK_DEALLOCATION(family, count * static_cast<int64>(sizeof(typename Traits::value_type)))
+        Traits::deallocate(allocator, ptr, count);
+    }
+}
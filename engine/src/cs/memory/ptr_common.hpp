@@ -4,9 +4,205 @@
 #pragma once
 
 #include "cs/cs.hpp"
+#include "cs/memory/block_pool.hpp"
 
+#include <new>
+#include <atomic>
+#include <utility>
+#include <type_traits>
+
+// How the counts are stored and changed, picked per pointer type.
+// Shared_Ptr uses the atomic one so pointers can be copied and dropped from any thread,
+// Local_Shared_Ptr the plain one for data that never leaves the thread that made it.
+struct Atomic_Ref_Count
+{
+    using Counter = std::atomic<int32>;
+
+    // A new reference is always made from an existing one, nothing to synchronize with
+    static void increment(Counter& count)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Release so our writes to the object happen before it's destroyed,
+    // acquire so the thread that destroys it sees everyone else's writes
+    static bool decrement(Counter& count)
+    {
+        return count.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    // Weak_Ptr::lock, must not bring a count that already hit zero back to life
+    static bool increment_if_not_zero(Counter& count)
+    {
+        int32 current = count.load(std::memory_order_relaxed);
+        while (current != 0)
+        {
+            if (count.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    static int32 load(const Counter& count)
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+};
+
+struct Local_Ref_Count
+{
+    using Counter = int32;
+
+    static void increment(Counter& count) { count += 1; }
+    static bool decrement(Counter& count) { return --count == 0; }
+
+    static bool increment_if_not_zero(Counter& count)
+    {
+        if (count == 0)
+        {
+            return false;
+        }
+
+        count += 1;
+        return true;
+    }
+
+    static int32 load(const Counter& count) { return count; }
+};
+
+// All strong references together hold one weak reference, so the block stays alive
+// while either kind of pointer exists and is freed by whoever drops the last weak one.
+// How the object is destroyed and the block freed depends on how they were allocated.
+template<typename Count_Policy>
 struct Ptr_Control_Block
 {
-    int32 strong_count = 1;
-    int32 weak_count = 0;
+    typename Count_Policy::Counter strong_count { 1 };
+    typename Count_Policy::Counter weak_count { 1 };
+
+    void (*destroy_object)(Ptr_Control_Block* block) = nullptr;
+    void (*free_block)(Ptr_Control_Block* block) = nullptr;
+
+    void add_strong() { Count_Policy::increment(strong_count); }
+    void add_weak() { Count_Policy::increment(weak_count); }
+
+    // False once the object is gone
+    bool try_add_strong() { return Count_Policy::increment_if_not_zero(strong_count); }
+
+    int32 get_strong_count() const { return Count_Policy::load(strong_count); }
+
+    void release_strong()
+    {
+        if (Count_Policy::decrement(strong_count))
+        {
+            destroy_object(this);
+            release_weak();
+        }
+    }
+
+    void release_weak()
+    {
+        if (Count_Policy::decrement(weak_count))
+        {
+            free_block(this);
+        }
+    }
+};
+
+// Types created often enough that their Shared_Ptr::create blocks come from a Block_Pool
+template<typename Type>
+struct Is_Shared_Ptr_Pooled : std::false_type {};
+
+#define DECLARE_SHARED_PTR_POOL(Type) \
+template<> \
+struct Is_Shared_Ptr_Pooled<Type> : std::true_type {};
+
+// For Shared_Ptr(Type*), owns an object allocated somewhere else
+template<typename Type, typename Count_Policy>
+struct Ptr_Separate_Control_Block : Ptr_Control_Block<Count_Policy>
+{
+    Type* object;
+
+    explicit Ptr_Separate_Control_Block(Type* in_object)
+        : object(in_object)
+    {
+        this->destroy_object = &_destroy_object;
+        this->free_block = &_free_block;
+    }
+
+private:
+    static void _destroy_object(Ptr_Control_Block<Count_Policy>* block)
+    {
+        Type* object = static_cast<Ptr_Separate_Control_Block*>(block)->object;
+#ifdef CS_SHARED_PTR_SHOULD_INVOKE_DESTRUCTOR
+        delete object;
+#else
+        free(object);
+#endif //CS_SHARED_PTR_SHOULD_INVOKE_DESTRUCTOR
+    }
+
+    static void _free_block(Ptr_Control_Block<Count_Policy>* block)
+    {
+        delete static_cast<Ptr_Separate_Control_Block*>(block);
+    }
+};
+
+// For Shared_Ptr::create, the object lives right after the counts in the same allocation
+template<typename Type, typename Count_Policy>
+struct Ptr_Inline_Control_Block : Ptr_Control_Block<Count_Policy>
+{
+    alignas(Type) unsigned char storage[sizeof(Type)];
+
+    Type* get_object() { return reinterpret_cast<Type*>(storage); }
+
+    template<typename... Args>
+    static Ptr_Inline_Control_Block* create(Args&&... args)
+    {
+        Ptr_Inline_Control_Block* block = new (_allocate()) Ptr_Inline_Control_Block();
+        new (block->storage) Type(std::forward<Args>(args)...);
+        return block;
+    }
+
+private:
+    Ptr_Inline_Control_Block()
+    {
+        this->destroy_object = &_destroy_object;
+        this->free_block = &_free_block;
+    }
+
+    static void* _allocate()
+    {
+        if constexpr (Is_Shared_Ptr_Pooled<Type>::value)
+        {
+            return Block_Pool<sizeof(Ptr_Inline_Control_Block), alignof(Ptr_Inline_Control_Block)>::get().allocate();
+        }
+        else
+        {
+            return ::operator new(sizeof(Ptr_Inline_Control_Block), std::align_val_t(alignof(Ptr_Inline_Control_Block)));
+        }
+    }
+
+    static void _destroy_object(Ptr_Control_Block<Count_Policy>* block)
+    {
+#ifdef CS_SHARED_PTR_SHOULD_INVOKE_DESTRUCTOR
+        static_cast<Ptr_Inline_Control_Block*>(block)->get_object()->~Type();
+#endif //CS_SHARED_PTR_SHOULD_INVOKE_DESTRUCTOR
+    }
+
+    static void _free_block(Ptr_Control_Block<Count_Policy>* block)
+    {
+        Ptr_Inline_Control_Block* inline_block = static_cast<Ptr_Inline_Control_Block*>(block);
+        inline_block->~Ptr_Inline_Control_Block();
+
+        if constexpr (Is_Shared_Ptr_Pooled<Type>::value)
+        {
+            Block_Pool<sizeof(Ptr_Inline_Control_Block), alignof(Ptr_Inline_Control_Block)>::get().deallocate(inline_block);
+        }
+        else
+        {
+            ::operator delete(inline_block, std::align_val_t(alignof(Ptr_Inline_Control_Block)));
+        }
+    }
 };
@@ -9,41 +9,53 @@
 #include <cstdint>
 #include <type_traits>
 
-template<typename Type>
+template<typename Type, typename Count_Policy = Atomic_Ref_Count>
 class Shared_Ptr;
-template<typename Type>
+template<typename Type, typename Count_Policy = Atomic_Ref_Count>
 class Weak_Ptr;
 
+// Single threaded variants, cheaper to copy but must never be shared between threads
 template<typename Type>
+using Local_Shared_Ptr = Shared_Ptr<Type, Local_Ref_Count>;
+template<typename Type>
+using Local_Weak_Ptr = Weak_Ptr<Type, Local_Ref_Count>;
+
+template<typename Type, typename Count_Policy = Atomic_Ref_Count>
 class Shared_From_This
 {
 protected:
-    mutable Weak_Ptr<Type> _weak_this;
+    mutable Weak_Ptr<Type, Count_Policy> _weak_this;
     
     ~Shared_From_This()
     {
         _weak_this.release();
     }
 
-    Shared_Ptr<Type> shared_from_this()
+    Shared_Ptr<Type, Count_Policy> shared_from_this()
     {
         return _weak_this.lock();
     }
 
-    template <typename Other_Type>
+    template <typename Other_Type, typename Other_Count_Policy>
     friend class Shared_Ptr;
 };
 
-template<typename Type>
+template<typename Type, typename Count_Policy>
 class Shared_Ptr
 {
+    using Control_Block = Ptr_Control_Block<Count_Policy>;
+
 public:
+    // One allocation for the counts and the object
     template<class... Args>
-    static Shared_Ptr<Type> create(Args ... args)
+    static Shared_Ptr<Type, Count_Policy> create(Args&&... args)
     {
-        Type* type_ptr = new Type(args...);
-        Shared_Ptr<Type> sp(type_ptr);
-        if constexpr (std::is_base_of<Shared_From_This<Type>, Type>::value) 
+        Ptr_Inline_Control_Block<Type, Count_Policy>* block = Ptr_Inline_Control_Block<Type, Count_Policy>::create(std::forward<Args>(args)...);
+
+        Shared_Ptr<Type, Count_Policy> sp;
+        sp._ptr = block->get_object();
+        sp._control_block = block;
+        if constexpr (std::is_base_of<Shared_From_This<Type, Count_Policy>, Type>::value) 
         {
             sp->_weak_this = sp;
         } 
@@ -58,21 +70,21 @@ public:
 
     explicit Shared_Ptr(Type* raw_other)
         : _ptr(raw_other),
-        _control_block(raw_other ? new Ptr_Control_Block : nullptr)
+        _control_block(raw_other ? new Ptr_Separate_Control_Block<Type, Count_Policy>(raw_other) : nullptr)
     {
     }
 
-    explicit Shared_Ptr(Type* raw_other, Ptr_Control_Block* control_block)
+    explicit Shared_Ptr(Type* raw_other, Control_Block* control_block)
         : _ptr(raw_other),
         _control_block(control_block)
     {
         if (_control_block != nullptr)
         {
-            _control_block->strong_count += 1;
+            _control_block->add_strong();
         }
     }
 
-    Shared_Ptr(const Shared_Ptr<Type>& other)
+    Shared_Ptr(const Shared_Ptr<Type, Count_Policy>& other)
         : _ptr(nullptr),
         _control_block(nullptr)
     {
@@ -80,18 +92,35 @@ public:
     }
 
     template <typename Other_Type>
-    Shared_Ptr(const Shared_Ptr<Other_Type>& other)
+    Shared_Ptr(const Shared_Ptr<Other_Type, Count_Policy>& other)
         : _ptr(nullptr),
         _control_block(nullptr)
     {
         initialize(other);
     }
 
-    Shared_Ptr<Type>& operator=(const Shared_Ptr<Type>& other)
+    Shared_Ptr(Shared_Ptr<Type, Count_Policy>&& other) noexcept
+        : _ptr(other._ptr),
+        _control_block(other._control_block)
+    {
+        other._ptr = nullptr;
+        other._control_block = nullptr;
+    }
+
+    template <typename Other_Type>
+    Shared_Ptr(Shared_Ptr<Other_Type, Count_Policy>&& other) noexcept
+        : _ptr(static_cast<Type*>(other._ptr)),
+        _control_block(other._control_block)
+    {
+        other._ptr = nullptr;
+        other._control_block = nullptr;
+    }
+
+    Shared_Ptr<Type, Count_Policy>& operator=(const Shared_Ptr<Type, Count_Policy>& other)
     {
         if (_ptr != other._ptr)
         {
-            Shared_Ptr<Type> other_shared_ptr(other);
+            Shared_Ptr<Type, Count_Policy> other_shared_ptr(other);
             swap(other_shared_ptr);
         }
 
@@ -99,17 +128,29 @@ public:
     }
 
     template <typename Other_Type>
-    Shared_Ptr<Type>& operator=(const Shared_Ptr<Other_Type>& other)
+    Shared_Ptr<Type, Count_Policy>& operator=(const Shared_Ptr<Other_Type, Count_Policy>& other)
     {
         if (_ptr != other._ptr)
         {
-            Shared_Ptr<Type> other_shared_ptr(other);
+            Shared_Ptr<Type, Count_Policy> other_shared_ptr(other);
             swap(other_shared_ptr);
         }
 
         return *this;
     }
 
+    Shared_Ptr<Type, Count_Policy>& operator=(Shared_Ptr<Type, Count_Policy>&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Shared_Ptr<Type, Count_Policy> moved(std::move(other));
+            swap(moved);
+        }
+
+        return *this;
+    }
+
+    // Safe to call more than once, the pointer is empty afterwards
     void release()
     {
         if (!_control_block)
@@ -117,25 +158,12 @@ public:
             return;
         }
 
-        // shared_from_this double delete guard
-        if (_control_block->strong_count == 1)
-        {
-#ifdef CS_SHARED_PTR_SHOULD_INVOKE_DESTRUCTOR
-            delete _ptr;
-#else
-            free(_ptr);
-#endif //CS_SHARED_PTR_SHOULD_INVOKE_DESTRUCTOR
-        }
+        // Clear first, destroying the object can reach back into this pointer
+        Control_Block* control_block = _control_block;
+        _ptr = nullptr;
+        _control_block = nullptr;
 
-        _control_block->strong_count -= 1;
-        
-        if (_control_block->strong_count == 0)
-        {
-            if (_control_block->weak_count == 0)
-            {
-                delete _control_block;
-            }
-        }
+        control_block->release_strong();
     }
 
     ~Shared_Ptr()
@@ -148,27 +176,27 @@ public:
     {
         if (_ptr != other)
         {
-            Shared_Ptr<Type> temp(other);
+            Shared_Ptr<Type, Count_Policy> temp(other);
             temp.swap(*this);
         }
     }
 
     template<typename Other_Type>
-    void reset(const Shared_Ptr<Other_Type> other)
+    void reset(const Shared_Ptr<Other_Type, Count_Policy> other)
     {
         if (_ptr != other._ptr)
         {
-            Shared_Ptr<Type> temp(other);
+            Shared_Ptr<Type, Count_Policy> temp(other);
             temp.swap(*this);
         }
     }
 
-    bool operator==(const Shared_Ptr<Type>& other) const
+    bool operator==(const Shared_Ptr<Type, Count_Policy>& other) const
     {
         return _ptr == other._ptr;
     }
 
-    bool operator!=(const Shared_Ptr<Type>& other) const
+    bool operator!=(const Shared_Ptr<Type, Count_Policy>& other) const
     {
         return _ptr != other._ptr;
     }
@@ -188,7 +216,7 @@ public:
         return *_ptr;
     }
 
-    bool is_valid() const { return _ptr != nullptr && _control_block && _control_block->strong_count > 0; }
+    bool is_valid() const { return _ptr != nullptr && _control_block && _control_block->get_strong_count() > 0; }
 
     operator bool() const
     {
@@ -196,23 +224,23 @@ public:
     }
 
 private:
-    void swap(Shared_Ptr<Type>& other)
+    void swap(Shared_Ptr<Type, Count_Policy>& other)
     {
         Type* temp_ptr = _ptr;
         _ptr = other._ptr;
         other._ptr = temp_ptr;
 
-        Ptr_Control_Block* temp_control_block = _control_block;
+        Control_Block* temp_control_block = _control_block;
         _control_block = other._control_block;
         other._control_block = temp_control_block;
     }
 
     template<typename Other_Type>
-    void initialize(const Shared_Ptr<Other_Type>& other)
+    void initialize(const Shared_Ptr<Other_Type, Count_Policy>& other)
     {
         if (other._control_block != nullptr)
         {
-            other._control_block->strong_count += 1;
+            other._control_block->add_strong();
             _ptr = static_cast<Type*>(other._ptr);
             _control_block = other._control_block;
         }
@@ -220,12 +248,12 @@ private:
 
 protected:
     Type *_ptr;
-    Ptr_Control_Block *_control_block;
+    Control_Block *_control_block;
 
 
-    template <typename Other_Type>
+    template <typename Other_Type, typename Other_Count_Policy>
     friend class Weak_Ptr;
 
-    template <typename Other_Type>
+    template <typename Other_Type, typename Other_Count_Policy>
     friend class Shared_Ptr;
 };
@@ -6,9 +6,11 @@
 #include "cs/cs.hpp"
 #include "shared_ptr.hpp"
 
-template<typename Type>
+template<typename Type, typename Count_Policy>
 class Weak_Ptr
 {
+    using Control_Block = Ptr_Control_Block<Count_Policy>;
+
 public:
     Weak_Ptr()
         : _ptr(nullptr),
@@ -16,14 +18,14 @@ public:
     {
     }
 
-    Weak_Ptr(const Weak_Ptr<Type>& other)
+    Weak_Ptr(const Weak_Ptr<Type, Count_Policy>& other)
         : _ptr(nullptr),
         _control_block(nullptr)
     {
         initialize(other);
     }
 
-    Weak_Ptr(const Shared_Ptr<Type>& other)
+    Weak_Ptr(const Shared_Ptr<Type, Count_Policy>& other)
         : _ptr(nullptr),
         _control_block(nullptr)
     {
@@ -31,7 +33,7 @@ public:
     }
 
     template <typename Other_Type>
-    Weak_Ptr(const Weak_Ptr<Other_Type>& other)
+    Weak_Ptr(const Weak_Ptr<Other_Type, Count_Policy>& other)
         : _ptr(nullptr),
         _control_block(nullptr)
     {
@@ -39,18 +41,18 @@ public:
     }
 
     template <typename Other_Type>
-    Weak_Ptr(const Shared_Ptr<Other_Type>& other)
+    Weak_Ptr(const Shared_Ptr<Other_Type, Count_Policy>& other)
         : _ptr(nullptr),
         _control_block(nullptr)
     {
         initialize(other);
     }
 
-    Weak_Ptr<Type>& operator=(const Weak_Ptr<Type>& other)
+    Weak_Ptr<Type, Count_Policy>& operator=(const Weak_Ptr<Type, Count_Policy>& other)
     {
         if (_ptr != other._ptr)
         {
-            Weak_Ptr<Type> other_shared_ptr(other);
+            Weak_Ptr<Type, Count_Policy> other_shared_ptr(other);
             swap(other_shared_ptr);
         }
 
@@ -58,17 +60,18 @@ public:
     }
     
     template <typename Other_Type>
-    Weak_Ptr<Type>& operator=(const Weak_Ptr<Other_Type>& other)
+    Weak_Ptr<Type, Count_Policy>& operator=(const Weak_Ptr<Other_Type, Count_Policy>& other)
     {
         if (_ptr != other._ptr)
         {
-            Weak_Ptr<Type> other_shared_ptr(other);
+            Weak_Ptr<Type, Count_Policy> other_shared_ptr(other);
             swap(other_shared_ptr);
         }
 
         return *this;
     }
 
+    // Safe to call more than once, the pointer is empty afterwards
     void release()
     {
         if (!_control_block)
@@ -76,12 +79,11 @@ public:
             return;
         }
 
-        _control_block->weak_count -= 1;
-        if (_control_block->strong_count == 0 && _control_block->weak_count == 0)
-        {
-            _control_block->weak_count -= 1;
-            delete _control_block;
-        }
+        Control_Block* control_block = _control_block;
+        _ptr = nullptr;
+        _control_block = nullptr;
+
+        control_block->release_weak();
     }
 
     ~Weak_Ptr()
@@ -94,42 +96,46 @@ public:
     {
         if (_ptr != other)
         {
-            Weak_Ptr<Type> temp(other);
+            Weak_Ptr<Type, Count_Policy> temp(other);
             temp.swap(*this);
         }
     }
 
     template<typename Other_Type>
-    void reset(const Weak_Ptr<Other_Type> other)
+    void reset(const Weak_Ptr<Other_Type, Count_Policy> other)
     {
         if (_ptr != other._ptr)
         {
-            Weak_Ptr<Type> temp(other);
+            Weak_Ptr<Type, Count_Policy> temp(other);
             temp.swap(*this);
         }
     }
 
-    Shared_Ptr<Type> lock() const
+    // Checking the count and then adding to it would race with the last Shared_Ptr going away,
+    // so the count is only bumped if it's still above zero
+    Shared_Ptr<Type, Count_Policy> lock() const
     {
-        if (!is_valid())
+        Shared_Ptr<Type, Count_Policy> locked;
+        if (_ptr != nullptr && _control_block && _control_block->try_add_strong())
         {
-            return Shared_Ptr<Type>();
+            locked._ptr = _ptr;
+            locked._control_block = _control_block;
         }
 
-        return Shared_Ptr<Type>(_ptr, _control_block);
+        return locked;
     }
 
-    bool operator==(const Weak_Ptr<Type>& other) const
+    bool operator==(const Weak_Ptr<Type, Count_Policy>& other) const
     {
         return _ptr == other._ptr;
     }
 
-    bool operator!=(const Weak_Ptr<Type>& other) const
+    bool operator!=(const Weak_Ptr<Type, Count_Policy>& other) const
     {
         return _ptr != other._ptr;
     }
 
-    bool is_valid() const { return _ptr != nullptr && _control_block && _control_block->strong_count > 0; }
+    bool is_valid() const { return _ptr != nullptr && _control_block && _control_block->get_strong_count() > 0; }
 
     operator bool() const
     {
@@ -137,45 +143,45 @@ public:
     }
 
 private:
-    void swap(Weak_Ptr<Type>& other)
+    void swap(Weak_Ptr<Type, Count_Policy>& other)
     {
         Type* temp_ptr = _ptr;
         _ptr = other._ptr;
         other._ptr = temp_ptr;
 
-        Ptr_Control_Block* temp_control_block = _control_block;
+        Control_Block* temp_control_block = _control_block;
         _control_block = other._control_block;
         other._control_block = temp_control_block;
     }
 
-    void swap(Shared_Ptr<Type>& other)
+    void swap(Shared_Ptr<Type, Count_Policy>& other)
     {
         Type* temp_ptr = _ptr;
         _ptr = other._ptr;
         other._ptr = temp_ptr;
 
-        Ptr_Control_Block* temp_control_block = _control_block;
+        Control_Block* temp_control_block = _control_block;
         _control_block = other._control_block;
         other._control_block = temp_control_block;
     }
 
     template<typename Other_Type>
-    void initialize(const Weak_Ptr<Other_Type>& other)
+    void initialize(const Weak_Ptr<Other_Type, Count_Policy>& other)
     {
         if (other._control_block != nullptr)
         {
-            other._control_block->weak_count += 1;
+            other._control_block->add_weak();
             _ptr = static_cast<Type*>(other._ptr);
             _control_block = other._control_block;
         }
     }
 
     template<typename Other_Type>
-    void initialize(const Shared_Ptr<Other_Type>& other)
+    void initialize(const Shared_Ptr<Other_Type, Count_Policy>& other)
     {
         if (other._control_block != nullptr)
         {
-            other._control_block->weak_count += 1;
+            other._control_block->add_weak();
             _ptr = static_cast<Type*>(other._ptr);
             _control_block = other._control_block;
         }
@@ -183,11 +189,11 @@ private:
 
 private:
     Type *_ptr;
-    Ptr_Control_Block *_control_block;
+    Control_Block *_control_block;
 
-    template <typename Other_Type>
+    template <typename Other_Type, typename Other_Count_Policy>
     friend class Weak_Ptr;
 
-    template <typename Other_Type>
+    template <typename Other_Type, typename Other_Count_Policy>
     friend class Shared_Ptr;
 };
@@ -2,3 +2,241 @@
 // Author: matija.martinec@protonmail.com
 
 #include "cs/name_id.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+namespace
+{
+    struct String_Entry
+    {
+        uint32 hash;
+        char string[1];
+    };
+
+    // Strings are bumped into chunks that are never freed, so entry pointers stay valid for the process
+    class String_Arena
+    {
+    public:
+        String_Entry* allocate(uint32 hash, const char* string)
+        {
+            const int64 length = static_cast<int64>(strlen(string));
+            const int64 size = (offsetof(String_Entry, string) + length + 1 + alignof(String_Entry) - 1) & ~static_cast<int64>(alignof(String_Entry) - 1);
+
+            String_Entry* entry = static_cast<String_Entry*>(_allocate(size));
+            entry->hash = hash;
+            memcpy(entry->string, string, length + 1);
+            return entry;
+        }
+
+    private:
+        static constexpr int64 _chunk_size = 64 * 1024;
+
+        struct Chunk
+        {
+            std::atomic<int64> used { 0 };
+            int64 capacity { 0 };
+            Chunk* previous { nullptr };
+
+            unsigned char* get_data() { return reinterpret_cast<unsigned char*>(this + 1); }
+        };
+
+        std::atomic<Chunk*> _current { nullptr };
+
+    private:
+        void* _allocate(int64 size)
+        {
+            while (true)
+            {
+                Chunk* chunk = _current.load(std::memory_order_acquire);
+                if (chunk)
+                {
+                    const int64 offset = chunk->used.fetch_add(size, std::memory_order_relaxed);
+                    if (offset + size <= chunk->capacity)
+                    {
+                        return chunk->get_data() + offset;
+                    }
+                }
+
+                // Full, whoever swaps in a new chunk first wins, the others retry on it
+                const int64 capacity = size > _chunk_size ? size : _chunk_size;
+                Chunk* new_chunk = new (::operator new(sizeof(Chunk) + capacity)) Chunk();
+                new_chunk->capacity = capacity;
+                new_chunk->previous = chunk;
+
+                if (!_current.compare_exchange_strong(chunk, new_chunk, std::memory_order_acq_rel))
+                {
+                    new_chunk->~Chunk();
+                    ::operator delete(new_chunk);
+                }
+            }
+        }
+    };
+
+    // Open addressing hash -> entry index, slots are claimed with a CAS and never change after,
+    // so lookups are a few atomic loads and never block.
+    // Past half full a table twice the size is pushed in front of it. Old tables are never moved
+    // or freed, new strings only go into the newest one and lookups walk the chain back.
+    class String_Table
+    {
+    public:
+        static String_Table& get()
+        {
+            // Never destroyed, ids can be resolved during static destruction
+            static String_Table* table = new String_Table();
+            return *table;
+        }
+
+        const char* find(uint32 hash) const
+        {
+            for (const Table* table = _current.load(std::memory_order_acquire); table; table = table->previous)
+            {
+                if (const String_Entry* entry = table->find(hash))
+                {
+                    return entry->string;
+                }
+            }
+
+            return nullptr;
+        }
+
+        const char* insert(uint32 hash, const char* string)
+        {
+            String_Entry* new_entry = nullptr;
+
+            while (true)
+            {
+                Table* table = _current.load(std::memory_order_acquire);
+
+                for (uint32 probe = 0; probe < table->capacity; ++probe)
+                {
+                    std::atomic<const String_Entry*>& slot = table->slots[(hash + probe) & (table->capacity - 1)];
+                    const String_Entry* entry = slot.load(std::memory_order_acquire);
+
+                    if (entry == nullptr)
+                    {
+                        // Not in the newest table, it can still be in an older one
+                        for (const Table* old_table = table->previous; old_table; old_table = old_table->previous)
+                        {
+                            if (const String_Entry* old_entry = old_table->find(hash))
+                            {
+                                return _check_collision(old_entry, string);
+                            }
+                        }
+
+                        if (table->count.load(std::memory_order_relaxed) >= table->capacity / 2)
+                        {
+                            break;
+                        }
+
+                        // Only copy the string once we know it's not in the table yet
+                        if (new_entry == nullptr)
+                        {
+                            new_entry = _arena.allocate(hash, string);
+                        }
+
+                        if (slot.compare_exchange_strong(entry, new_entry, std::memory_order_acq_rel))
+                        {
+                            table->count.fetch_add(1, std::memory_order_relaxed);
+                            return new_entry->string;
+                        }
+
+                        // Lost the race, entry now holds the winner, check it like any other
+                    }
+
+                    if (entry->hash == hash)
+                    {
+                        // A lost race leaves new_entry unused in the arena, it's only a few bytes
+                        return _check_collision(entry, string);
+                    }
+                }
+
+                _grow(table);
+            }
+        }
+
+    private:
+        struct Table
+        {
+            const Table* previous { nullptr };
+            uint32 capacity { 0 };
+            std::atomic<uint32> count { 0 };
+            std::atomic<const String_Entry*>* slots { nullptr };
+
+            const String_Entry* find(uint32 hash) const
+            {
+                for (uint32 probe = 0; probe < capacity; ++probe)
+                {
+                    const String_Entry* entry = slots[(hash + probe) & (capacity - 1)].load(std::memory_order_acquire);
+                    if (entry == nullptr || entry->hash == hash)
+                    {
+                        return entry;
+                    }
+                }
+
+                return nullptr;
+            }
+        };
+
+        std::atomic<Table*> _current { nullptr };
+        String_Arena _arena;
+
+    private:
+        String_Table()
+        {
+            static_assert((CS_NAME_ID_TABLE_CAPACITY & (CS_NAME_ID_TABLE_CAPACITY - 1)) == 0, "Name_Id table capacity has to be a power of two");
+            _current.store(_create_table(nullptr, CS_NAME_ID_TABLE_CAPACITY), std::memory_order_release);
+        }
+
+        static Table* _create_table(const Table* previous, uint32 capacity)
+        {
+            Table* table = new Table();
+            table->previous = previous;
+            table->capacity = capacity;
+            table->slots = new std::atomic<const String_Entry*>[capacity]();
+            return table;
+        }
+
+        // Whoever swaps in the bigger table first wins, the others retry on it
+        void _grow(Table* full_table)
+        {
+            Table* new_table = _create_table(full_table, full_table->capacity * 2);
+            if (!_current.compare_exchange_strong(full_table, new_table, std::memory_order_acq_rel))
+            {
+                delete[] new_table->slots;
+                delete new_table;
+            }
+        }
+
+        static const char* _check_collision(const String_Entry* entry, const char* string)
+        {
+#ifndef NDEBUG
+            if (strcmp(entry->string, string) != 0)
+            {
+                printf("Name_Id collision: '%s' and '%s' both hash to %08x\n", entry->string, string, entry->hash);
+                assert(false);
+            }
+#endif //NDEBUG
+            return entry->string;
+        }
+    };
+}
+
+const char* get_hashed_string(uint32 hash)
+{
+    return String_Table::get().find(hash);
+}
+
+const char* register_hashed_string(uint32 hash, const char* string)
+{
+    if (string == nullptr)
+    {
+        return nullptr;
+    }
+
+    // Most strings are registered over and over (profiler scopes, input names),
+    // those find their slot on the first probe and never touch the arena
+    return String_Table::get().insert(hash, string);
+}
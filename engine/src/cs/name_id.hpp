@@ -6,7 +6,7 @@
 #include "cs/cs.hpp"
 
 #include <string>
-#include <string_view>
+#include <type_traits>
 
 constexpr uint32 fnv1a_32_const = 0x811c9dc5ul;
 constexpr uint64 fnv1a_64_const = 0xcbf29ce484222325ull;
@@ -23,13 +23,17 @@ constexpr uint64 hash_64_fnv1a_const(const char* const str, const uint64 value =
     return (str[0] == '\0') ? value : hash_64_fnv1a_const(&str[1], (value ^ uint64_t((uint8_t)str[0])) * prime_64_const);
 }
 
+// Process wide table of every string a Name_Id was made from at runtime, so ids only
+// need to carry the hash. Strings are copied into an append only arena and never freed.
+// Returns nullptr if no string was registered for the hash.
 const char* get_hashed_string(uint32 hash);
+// Returns the table's copy of the string, safe to call from any thread
+const char* register_hashed_string(uint32 hash, const char* string);
 
 class Name_Id
 {
 public:
     uint32 id { 0 };
-    std::string_view str { "" };
 
 public:
     Name_Id() = default;
@@ -39,24 +43,42 @@ public:
     {
     }
 
+    // Ids made at compile time can't reach the table, declare those with CS_NAME_ID
     constexpr Name_Id(const char* string) noexcept
-    :id(hash_32_fnv1a_const(string)), str(string)
+    :id(hash_32_fnv1a_const(string))
     {
-
+        if (!std::is_constant_evaluated())
+        {
+            register_hashed_string(id, string);
+        }
     }
 
     inline constexpr operator uint32() const { return id; }
-    inline constexpr const char* c_str() const { return str.data(); }
-    inline constexpr operator const char*() const { return c_str(); }
+    // Empty if the string was never registered
+    inline const char* c_str() const
+    {
+        const char* string = get_hashed_string(id);
+        return string ? string : "";
+    }
+    inline operator const char*() const { return c_str(); }
     inline constexpr bool operator==(const Name_Id& other) const { return id == other.id; }
+};
 
-private:
-    constexpr Name_Id(uint32 id, const char* string) noexcept
-        :id(id), str(string)
+// For static constexpr ids, registers the string once during static initialization
+struct Name_Id_Registration
+{
+    Name_Id_Registration(const char* string)
     {
+        register_hashed_string(hash_32_fnv1a_const(string), string);
     }
 };
 
+// A static constexpr id plus the registration that puts its string in the table,
+// works at namespace and at class scope
+#define CS_NAME_ID(name, string) \
+    static constexpr Name_Id name = Name_Id(string); \
+    static inline const Name_Id_Registration name##_registration { string };
+
 static constexpr Name_Id empty_name_id;
 
 namespace std 